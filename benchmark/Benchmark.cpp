@@ -0,0 +1,294 @@
+// Benchmark driver for the performance claims made for the library.
+// Every section builds its own data with a fixed seed and prints one line
+// per measured configuration. Run without arguments for all sections or
+// name the sections to run, e.g. "spatialdb_benchmark threads".
+
+#include "spatialdb/RTree.h"
+#include "spatialdb/MemoryStorageManager.h"
+#include "spatialdb/DiskStorageManager.h"
+#include "spatialdb/Region.h"
+#include "spatialdb/Point.h"
+#include "spatialdb/IdSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace spatialdb;
+
+namespace
+{
+
+struct Box
+{
+	double low[DIMENSION];
+	double high[DIMENSION];
+	id_type id;
+};
+
+// n boxes in [0, 100)^DIMENSION with extents up to extent.
+std::vector<Box> RandomBoxes(size_t n, uint32_t seed, double extent)
+{
+	std::mt19937_64 rng(seed);
+	std::uniform_real_distribution<double> pos(0.0, 100.0), ext(0.0, extent);
+
+	std::vector<Box> boxes(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			boxes[i].low[d] = pos(rng);
+			boxes[i].high[d] = boxes[i].low[d] + ext(rng);
+		}
+		boxes[i].id = static_cast<id_type>(i);
+	}
+	return boxes;
+}
+
+std::vector<BulkLoadEntry> Entries(const std::vector<Box>& boxes)
+{
+	std::vector<BulkLoadEntry> entries(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i)
+	{
+		entries[i].mbr = Region(boxes[i].low, boxes[i].high);
+		entries[i].id = boxes[i].id;
+		entries[i].data_len = sizeof(id_type);
+		entries[i].data = reinterpret_cast<const uint8_t*>(&boxes[i].id);
+	}
+	return entries;
+}
+
+double Seconds(const std::function<void()>& f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// queries per second of concurrent range queries on one tree, for 1 up to
+// twice the hardware threads. The queries are split evenly over the threads.
+void ThreadSweep(const char* storage, RTree& tree, const std::vector<Box>& windows)
+{
+	const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned threads = 1; threads <= 2 * hardware; threads *= 2)
+	{
+		std::vector<uint64_t> found(threads, 0);
+		const double s = Seconds([&]() {
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; ++t)
+			{
+				workers.emplace_back([&, t]() {
+					for (size_t q = t; q < windows.size(); q += threads)
+					{
+						IdSink sink;
+						tree.IntersectsWithQuery(Region(windows[q].low, windows[q].high), sink);
+						found[t] += sink.GetResultCount();
+					}
+				});
+			}
+			for (auto& w : workers) {
+				w.join();
+			}
+		});
+
+		uint64_t total = 0;
+		for (uint64_t f : found) {
+			total += f;
+		}
+		std::printf("  %-6s %2u threads: %8.0f queries/s (%llu results)\n", storage, threads, windows.size() / s, static_cast<unsigned long long>(total));
+	}
+}
+
+// the sweep on a memory tree and on a disk tree, whose leaves do not fit
+// the page cache of the DiskStorageManager, so queries keep missing it.
+void Threads()
+{
+	const auto boxes = RandomBoxes(200000, 1, 1.0);
+	const auto entries = Entries(boxes);
+	const auto windows = RandomBoxes(20000, 2, 5.0);
+
+	std::printf("threads: %zu boxes, %zu queries, %u hardware threads\n", boxes.size(), windows.size(), std::max(1u, std::thread::hardware_concurrency()));
+
+	{
+		RTree tree(std::make_shared<MemoryStorageManager>(), true);
+		tree.BulkLoad(entries.data(), entries.size());
+		ThreadSweep("memory", tree, windows);
+	}
+
+	const std::string filename = (std::filesystem::temp_directory_path() / "spatialdb_benchmark_threads").string();
+	{
+		RTree tree(std::make_shared<DiskStorageManager>(filename, true), true);
+		tree.BulkLoad(entries.data(), entries.size());
+		ThreadSweep("disk", tree, windows);
+	}
+	for (const char* ext : { ".dat", ".idx" }) {
+		std::filesystem::remove(filename + ext);
+	}
+}
+
+// counts the page stores reaching the storage manager.
+class CountingStorageManager : public MemoryStorageManager
+{
+public:
+	virtual void StoreByteArray(id_type& id, const uint32_t len, const uint8_t* const data) override
+	{
+		++m_stores;
+		MemoryStorageManager::StoreByteArray(id, len, data);
+	}
+
+	uint64_t GetStores() const { return m_stores; }
+
+private:
+	uint64_t m_stores = 0;
+
+}; // CountingStorageManager
+
+// page stores per inserted entry for single inserts, batches of 1000 and
+// one batch of all entries.
+void Batch()
+{
+	const auto boxes = RandomBoxes(50000, 3, 1.0);
+	const auto entries = Entries(boxes);
+
+	std::printf("batch: %zu boxes\n", boxes.size());
+
+	for (size_t chunk : { size_t(1), size_t(1000), entries.size() })
+	{
+		auto sm = std::make_shared<CountingStorageManager>();
+		RTree tree(sm, true);
+		const uint64_t created = sm->GetStores();
+
+		const double s = Seconds([&]() {
+			for (size_t i = 0; i < entries.size(); i += chunk)
+			{
+				const size_t count = std::min(chunk, entries.size() - i);
+				if (chunk == 1) {
+					tree.InsertData(entries[i].data_len, entries[i].data, entries[i].mbr, entries[i].id);
+				} else {
+					tree.InsertBatch(&entries[i], count);
+				}
+			}
+		});
+
+		std::printf("  %s %6zu: %.2f stores/insert, %.3fs\n", chunk == 1 ? "InsertData " : "InsertBatch", chunk,
+			static_cast<double>(sm->GetStores() - created) / entries.size(), s);
+	}
+}
+
+// counts the nodes and the entries a query hands to the visitor.
+class CountingVisitor : public IVisitor
+{
+public:
+	virtual VisitorStatus VisitNode(const INode&) override
+	{
+		++m_nodes;
+		return VisitorStatus::Continue;
+	}
+
+	virtual void VisitData(const IData&) override { ++m_data; }
+	virtual void VisitData(std::vector<const IData*>&) override { ++m_data; }
+
+	uint64_t GetNodes() const { return m_nodes; }
+	uint64_t GetData() const { return m_data; }
+
+private:
+	uint64_t m_nodes = 0;
+	uint64_t m_data = 0;
+
+}; // CountingVisitor
+
+// 10-NN queries on a point cloud: latency and nodes visited per query.
+void Knn()
+{
+	auto points = RandomBoxes(200000, 4, 0.0);
+	const auto entries = Entries(points);
+	RTree tree(std::make_shared<MemoryStorageManager>(), true);
+	tree.BulkLoad(entries.data(), entries.size());
+
+	const auto queries = RandomBoxes(50000, 5, 0.0);
+
+	CountingVisitor v;
+	const double s = Seconds([&]() {
+		for (const auto& q : queries) {
+			tree.NearestNeighborQuery(10, Point(q.low), v);
+		}
+	});
+
+	std::printf("knn: %zu points, %zu 10-NN queries\n", points.size(), queries.size());
+	std::printf("  %.3fs, %.1f us/query, %.2f nodes/query, %.2f results/query\n", s, 1e6 * s / queries.size(),
+		static_cast<double>(v.GetNodes()) / queries.size(), static_cast<double>(v.GetData()) / queries.size());
+}
+
+// the synchronized traversal join against one IntersectsWithQuery per
+// entry of the smaller tree, both must find the same number of pairs.
+void Join()
+{
+	const auto left_boxes = RandomBoxes(200000, 6, 1.0);
+	const auto right_boxes = RandomBoxes(100000, 7, 1.0);
+	const auto left_entries = Entries(left_boxes);
+	const auto right_entries = Entries(right_boxes);
+
+	RTree left(std::make_shared<MemoryStorageManager>(), true);
+	RTree right(std::make_shared<MemoryStorageManager>(), true);
+	left.BulkLoad(left_entries.data(), left_entries.size());
+	right.BulkLoad(right_entries.data(), right_entries.size());
+
+	std::printf("join: %zu x %zu boxes\n", left_boxes.size(), right_boxes.size());
+
+	CountingVisitor naive;
+	const double naive_s = Seconds([&]() {
+		for (const auto& e : right_entries) {
+			left.IntersectsWithQuery(e.mbr, naive);
+		}
+	});
+	std::printf("  per-object queries: %.3fs, %llu pairs\n", naive_s, static_cast<unsigned long long>(naive.GetData()));
+
+	CountingVisitor joined;
+	const double join_s = Seconds([&]() {
+		left.JoinQuery(right, joined);
+	});
+	std::printf("  JoinQuery:          %.3fs, %llu pairs\n", join_s, static_cast<unsigned long long>(joined.GetData()));
+
+	if (joined.GetData() != naive.GetData()) {
+		std::printf("  the pair counts differ\n");
+	}
+}
+
+struct Section
+{
+	const char* name;
+	void (*run)();
+};
+
+const Section SECTIONS[] = {
+	{ "threads", Threads },
+	{ "batch", Batch },
+	{ "knn", Knn },
+	{ "join", Join },
+};
+
+}
+
+int main(int argc, char** argv)
+{
+	for (const auto& section : SECTIONS)
+	{
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; ++i) {
+			selected = selected || std::strcmp(argv[i], section.name) == 0;
+		}
+		if (selected) {
+			section.run();
+		}
+	}
+	return 0;
+}
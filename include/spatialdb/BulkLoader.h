@@ -0,0 +1,66 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+#include "spatialdb/Region.h"
+
+#include <vector>
+
+namespace spatialdb
+{
+
+class RTree;
+
+enum class BulkLoadMethod
+{
+	STR,
+	Hilbert
+};
+
+// one (MBR, id, payload) record of a contiguous bulk load input.
+// the payload is copied into the tree, the caller keeps ownership.
+struct BulkLoadEntry
+{
+	Region mbr;
+	id_type id = 0;
+	uint32_t data_len = 0;
+	const uint8_t* data = nullptr;
+};
+
+// Builds a packed tree bottom-up: the entries of every level are ordered
+// (Sort-Tile-Recursive or Hilbert curve), cut into nodes of
+// floor(capacity * fill_factor) entries and every node is written once.
+// The last two nodes of a level split the remainder evenly. The old root
+// is replaced only after the whole tree is written.
+class BulkLoader
+{
+public:
+	BulkLoader(RTree& tree, BulkLoadMethod method);
+
+	void Load(IDataStream& stream);
+	void Load(const BulkLoadEntry* entries, size_t count);
+
+private:
+	struct Item
+	{
+		Region mbr;
+		id_type id;
+		uint32_t data_len;
+		uint8_t* data;
+		uint64_t key;
+	};
+
+	void Build(std::vector<Item>& items);
+
+	void SortSTR(std::vector<Item>& items, size_t begin, size_t end, uint32_t dim, uint32_t node_size) const;
+	void SortHilbert(std::vector<Item>& items) const;
+
+	static double Center(const Item& item, uint32_t dim);
+
+private:
+	RTree& m_tree;
+
+	BulkLoadMethod m_method;
+
+}; // BulkLoader
+
+}
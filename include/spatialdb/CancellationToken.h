@@ -0,0 +1,23 @@
+#pragma once
+
+#include <atomic>
+
+namespace spatialdb
+{
+
+// set from any thread to make a running query stop at the next page.
+class CancellationToken
+{
+public:
+	CancellationToken() {}
+
+	void Cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+	void Reset() { m_cancelled.store(false, std::memory_order_relaxed); }
+	bool IsCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<bool> m_cancelled{ false };
+
+}; // CancellationToken
+
+}
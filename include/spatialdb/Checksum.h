@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace spatialdb
+{
+
+class Checksum
+{
+public:
+	// CRC-32 (IEEE 802.3), pass the previous result to continue a running checksum.
+	static uint32_t Crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+}; // Checksum
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+
+namespace spatialdb
+{
+
+// counts the results. The range queries take the counts of the subtrees
+// inside the query from their parent entries, see RTree::AggregateQuery.
+class CountSink : public IResultSink
+{
+public:
+	CountSink() {}
+
+	//
+	// IResultSink interface
+	//
+	virtual ResultDetail GetDetail() const override { return ResultDetail::Count; }
+	virtual void AddCount(uint64_t count) override { m_results += count; }
+
+	uint64_t GetResultCount() const { return m_results; }
+
+private:
+	uint64_t m_results = 0;
+
+}; // CountSink
+
+}
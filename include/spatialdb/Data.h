@@ -0,0 +1,50 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+#include "spatialdb/Region.h"
+
+namespace spatialdb
+{
+
+// An entry with its own copy of the MBR and payload, the independent copy
+// the Clone of an entry read in place returns.
+class Data : public IData, public ISerializable
+{
+public:
+	Data(uint32_t len, const uint8_t* data, const Region& r, id_type id);
+	Data(const Data&) = delete;
+	Data& operator = (const Data&) = delete;
+	virtual ~Data();
+
+	//
+	// IObject interface
+	//
+	virtual Data* Clone() override;
+
+	//
+	// IEntry interface
+	//
+	virtual id_type GetIdentifier() const override;
+	virtual void GetShape(IShape** out) const override;
+
+	//
+	// IData interface
+	//
+	virtual void GetData(uint32_t& len, uint8_t** data) const override;
+
+	//
+	// ISerializable interface
+	//
+	virtual uint32_t GetByteArraySize() const override;
+	virtual void LoadFromByteArray(const uint8_t* data) override;
+	virtual void StoreToByteArray(uint8_t** data, uint32_t& len) const override;
+
+private:
+	id_type m_id;
+	Region m_region;
+	uint8_t* m_data = nullptr;
+	uint32_t m_data_len = 0;
+
+}; // Data
+
+}
@@ -1,14 +1,33 @@
 #pragma once
 
 #include "spatialdb/SpatialIndex.h"
+#include "spatialdb/IoUring.h"
+#include "spatialdb/PageTable.h"
+#include "spatialdb/ThreadPool.h"
+#include "spatialdb/WriteAheadLog.h"
 
 #include <fstream>
+#include <cstring>
 #include <set>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 namespace spatialdb
 {
 
+// How LoadByteArrays reads the pages missing from the cache.
+enum class BatchReadMode
+{
+	// io_uring where available, the thread pool otherwise.
+	Auto,
+	IoUring,
+	ThreadPool,
+	Sequential
+};
+
 class DiskStorageManager : public IStorageManager
 {
 public:
@@ -20,27 +39,48 @@ public:
 	virtual void DeleteByteArray(const id_type id) override;
 	virtual void Flush() override;
 
+	virtual bool LoadByteArrayView(const id_type id, uint32_t& len, const uint8_t** data, std::shared_ptr<const void>& owner) override;
+	virtual void LoadByteArrays(const std::vector<id_type>& ids, const LoadCallback& done) override;
+
+	virtual bool HasWriteAheadLog() const override;
+	virtual void Commit() override;
+	virtual uint32_t GetPageSize() const override;
+
+	// threads is the size of the pread pool, 0 picks the core count.
+	void SetBatchReadMode(BatchReadMode mode, size_t threads = 0);
+
+	// Logs stores and deletes to <filename>.wal before the data file is
+	// touched. A Commit is made durable once group_commit_bytes of log are
+	// pending (0 syncs every commit), the data and index files are synced
+	// and the log truncated once it holds checkpoint_bytes. Committed groups
+	// are replayed when the files are opened after a crash.
+	void EnableWriteAheadLog(size_t group_commit_bytes = 1024 * 1024, uint64_t checkpoint_bytes = 64 * 1024 * 1024);
+
 private:
 	bool Initialize(const std::string& filename, bool overwrite, uint32_t page_size);
 
-private:
-	class Entry
-	{
-	public:
-		uint32_t length;
-		std::vector<id_type> pages;
-	};
+	void ReadPages(std::vector<IoRead>& reads);
+	void WritePages(const std::vector<id_type>& pages, uint32_t len, const uint8_t* data);
+
+	void ApplyPending();
+	void Checkpoint();
+	void Recover();
 
+private:
 	class LRUCollection;
 
 	class CachePage
 	{
 	public:
-		CachePage(id_type id, uint32_t len, const uint8_t* data) 
+		CachePage(id_type id, uint32_t len)
 			: m_id(id)
 			, m_len(len)
 		{
 			m_data = new uint8_t[len];
+		}
+		CachePage(id_type id, uint32_t len, const uint8_t* data) 
+			: CachePage(id, len)
+		{
 			memcpy(m_data, data, m_len);
 		}
 		~CachePage() {
@@ -49,6 +89,7 @@ private:
 
 		uint32_t GetLength() const { return m_len; }
 		const uint8_t* GetData() const { return m_data; }
+		uint8_t* GetBuffer() { return m_data; }
 
 	private:
 		id_type m_id = 0;
@@ -68,39 +109,89 @@ private:
 			: m_capacity(capacity) 
 		{
 		}
-		~LRUCollection();
+		~LRUCollection() = default;
 
-		bool AddFront(id_type id, uint32_t len, const uint8_t* data);
+		bool AddFront(const std::shared_ptr<CachePage>& page);
 		bool RemoveBack();
 
 		bool Remove(id_type id);
-		bool Modify(id_type id, uint32_t len, const uint8_t* data);
 
-		const CachePage* Find(id_type id) const;
+		std::shared_ptr<CachePage> Find(id_type id) const;
 		void Touch(CachePage* page);
 
 	private:
 		size_t m_capacity = 0;
 
-		std::map<id_type, CachePage*> m_map;
+		// pages are shared with the views handed out by LoadByteArrayView,
+		// an evicted or modified page stays alive until its last view is gone.
+		std::map<id_type, std::shared_ptr<CachePage>> m_map;
 		CachePage *m_list_begin = nullptr, *m_list_end = nullptr;
 
 	}; // LRUCollection
 
+	// a page read outside m_lock, misses on it wait for the first read.
+	struct Loading
+	{
+		std::shared_ptr<CachePage> page;
+		bool done = false;
+		std::exception_ptr error = nullptr;
+	};
+
+	// called with lock held, which is released while the page is read.
+	std::shared_ptr<CachePage> LoadPage(std::unique_lock<std::mutex>& lock, const id_type id);
+	// waits until a page read by another call is done.
+	std::shared_ptr<CachePage> WaitForPage(std::unique_lock<std::mutex>& lock, std::shared_ptr<Loading> loading);
+	// ends reads registered in m_loading, the pages read go to the cache.
+	void FinishReads(const std::vector<std::pair<id_type, std::shared_ptr<Loading>>>& loads, std::exception_ptr error);
+	// writers wait until no read is in flight, new reads wait for them.
+	void WaitForReads(std::unique_lock<std::mutex>& lock);
+	void WaitForWriters(std::unique_lock<std::mutex>& lock);
+	// the reads of the pages of an entry, into page.
+	void AddReads(const PageTable::Entry& e, CachePage& page, std::vector<IoRead>& reads) const;
+
 protected:
 	std::fstream m_data_file;
-	std::fstream m_index_file;
+
+	std::unique_ptr<PageTable> m_page_table = nullptr;
 
 	uint32_t m_page_size = 0;
-	id_type m_next_page = 0;
 
-	std::set<id_type> m_empty_pages;
-	std::map<id_type, Entry*> m_page_index;
+	std::string m_data_filename;
+	std::string m_wal_filename;
+
+	std::unique_ptr<WriteAheadLog> m_wal = nullptr;
+	size_t m_group_commit_bytes = 0;
+	uint64_t m_checkpoint_bytes = 0;
+
+	// stored entries whose log records are not synced yet.
+	std::map<id_type, std::shared_ptr<CachePage>> m_pending;
 
 	uint8_t* m_buffer = nullptr;
 
 	LRUCollection m_lru;
 
+	// second handle on the data file for positional batch reads.
+	int m_read_fd = -1;
+
+	BatchReadMode m_batch_mode = BatchReadMode::Auto;
+	size_t m_batch_threads = 0;
+
+	std::unique_ptr<IoUring> m_ring = nullptr;
+	std::unique_ptr<ThreadPool> m_pool = nullptr;
+
+	// the file streams, the page index and the cache are shared by all
+	// calls and guarded by m_lock. Cache misses are read with pread
+	// outside of it, registered in m_loading so concurrent misses on a
+	// page share one read. Calls that write wait for the reads in flight.
+	mutable std::mutex m_lock;
+	std::map<id_type, std::shared_ptr<Loading>> m_loading;
+	size_t m_reads = 0;
+	size_t m_writers = 0;
+	std::condition_variable m_reads_changed;
+
+	// the ring and the pool serve one LoadByteArrays batch at a time.
+	std::mutex m_batch_lock;
+
 }; // DiskStorageManager
 
 }
\ No newline at end of file
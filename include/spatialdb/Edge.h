@@ -46,9 +46,15 @@ public:
 	const double* GetStart() const { return m_start; }
 	const double* GetEnd() const { return m_end; }
 
+	// exact in 3D, see Math::SegmentsIntersect.
 	bool IntersectsEdge(const Edge& e) const;
 	bool IntersectsRegion(const Region& r) const;
+
+	bool ContainsPoint(const Point& p) const;
+
 	double GetMinimumDistance(const Point& p) const;
+	double GetMinimumDistance(const Region& r) const;
+	double GetMinimumDistance(const Edge& e) const;
 
 private:
 	void Initialize(const double* start, const double* end);
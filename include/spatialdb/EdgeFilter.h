@@ -0,0 +1,41 @@
+#pragma once
+
+#include "spatialdb/typedef.h"
+
+#include <cstdint>
+
+namespace spatialdb
+{
+
+// Segment tests over coordinate-major edge arrays, edge i running from
+// start[d][i] to end[d][i], for refining many candidate edges at once. Like
+// MBRFilter, every call covers up to 64 edges starting at begin and returns
+// a mask, bit i standing for edge begin + i; the distance kernels write one
+// value per edge to out[i] instead.
+class EdgeFilter
+{
+public:
+	static constexpr uint32_t BATCH = 64;
+
+	// edges meeting the closed box [low, high], the slab test of
+	// Math::SegmentIntersectsBox.
+	static uint64_t IntersectsBox(const double* const* start, const double* const* end,
+		uint32_t begin, uint32_t count, const double* low, const double* high);
+
+	// edges meeting the segment (p, q), exactly: the edges whose bounding
+	// box meets the one of (p, q) are passed to Math::SegmentsIntersect.
+	static uint64_t IntersectsSegment(const double* const* start, const double* const* end,
+		uint32_t begin, uint32_t count, const double* p, const double* q);
+
+	// squared distance of the point p to each edge.
+	static void PointDistanceSq(const double* const* start, const double* const* end,
+		uint32_t begin, uint32_t count, const double* p, double* out);
+
+	// squared distance of the segment (p, q) to each edge, see
+	// Math::SegmentsDistanceSq.
+	static void SegmentDistanceSq(const double* const* start, const double* const* end,
+		uint32_t begin, uint32_t count, const double* p, const double* q, double* out);
+
+}; // EdgeFilter
+
+}
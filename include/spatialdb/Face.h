@@ -6,6 +6,14 @@
 namespace spatialdb
 {
 
+class Point;
+class Region;
+class Edge;
+
+// Planar convex polygon, the vertices in order. The intersection tests
+// take the polygon as a whole, the distances the fan of triangles from the
+// first vertex. Faces with fewer than three vertices intersect nothing.
+// Containment is exact, see Math::PointInTriangle.
 class Face : public IShape
 {
 public:
@@ -41,9 +49,32 @@ public:
 	virtual double GetArea() const override;
 	virtual double GetMinimumDistance(const IShape& s) const override;
 
+	const double* GetVertices() const { return m_vertices; }
+	size_t GetVertexCount() const { return m_num; }
+
+	// with touch set, shapes that only meet count as disjoint, see
+	// Math::PolygonsIntersect.
+	bool IntersectsRegion(const Region& r, bool touch = false) const;
+	bool IntersectsEdge(const Edge& e, bool touch = false) const;
+	bool IntersectsFace(const Face& f, bool touch = false) const;
+
+	bool ContainsPoint(const Point& p) const;
+
+	double GetMinimumDistance(const Point& p) const;
+	double GetMinimumDistance(const Region& r) const;
+	double GetMinimumDistance(const Edge& e) const;
+	double GetMinimumDistance(const Face& f) const;
+
 private:
 	void Initialize(const double* verts, size_t num);
 
+	size_t GetTriangleCount() const { return m_num < 3 ? 0 : m_num - 2; }
+	// the corners of triangle i of the fan, in the vertices lifted to 3D
+	// (see Math::Lifted).
+	static const double* GetCorner(const double* verts, size_t i, int corner) { return verts + (corner == 0 ? 0 : (i + corner) * 3); }
+	// p lies on an edge of the polygon.
+	bool BoundaryContainsPoint(const Point& p) const;
+
 private:
 	double* m_vertices = nullptr;
 	size_t m_num = 0;
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+
+#include <vector>
+
+namespace spatialdb
+{
+
+// collects the identifiers of the results, the payload is never read.
+class IdSink : public IResultSink
+{
+public:
+	IdSink() {}
+
+	//
+	// IResultSink interface
+	//
+	virtual ResultDetail GetDetail() const override { return ResultDetail::Identifier; }
+	virtual void AddIdentifier(id_type id) override { m_ids.push_back(id); }
+
+	uint64_t GetResultCount() const { return m_ids.size(); }
+	std::vector<id_type>& GetResults() { return m_ids; }
+
+private:
+	std::vector<id_type> m_ids;
+
+}; // IdSink
+
+}
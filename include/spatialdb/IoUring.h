@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace spatialdb
+{
+
+// One positional read of a batch.
+struct IoRead
+{
+	int fd;
+	uint64_t offset;
+	uint8_t* buffer;
+	uint32_t length;
+};
+
+// Minimal io_uring submission/completion ring for batches of reads, set
+// up through the raw system calls. IsValid is false where io_uring is
+// not available (other platforms, old kernels, seccomp), callers fall
+// back to pread then.
+class IoUring
+{
+public:
+	IoUring(uint32_t entries = 64);
+	~IoUring();
+
+	bool IsValid() const { return m_fd >= 0; }
+
+	// keeps up to entries reads in flight, short reads are resubmitted.
+	// Returns false if any read failed or hit the end of the file.
+	bool Read(IoRead* reads, size_t count);
+
+private:
+	int m_fd = -1;
+
+	uint32_t m_sq_entries = 0, m_cq_entries = 0;
+
+	void*  m_sq_ring = nullptr;
+	size_t m_sq_ring_size = 0;
+	void*  m_cq_ring = nullptr;
+	size_t m_cq_ring_size = 0;
+	void*  m_sqes = nullptr;
+	size_t m_sqes_size = 0;
+
+	unsigned *m_sq_head = nullptr, *m_sq_tail = nullptr, *m_sq_mask = nullptr, *m_sq_array = nullptr;
+	unsigned *m_cq_head = nullptr, *m_cq_tail = nullptr, *m_cq_mask = nullptr;
+	void* m_cqes = nullptr;
+
+}; // IoUring
+
+}
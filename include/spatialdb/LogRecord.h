@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace spatialdb
+{
+
+// Framing shared by the on-disk logs: records of
+// { u32 type, u32 payload length, u32 crc32 of the payload, payload }.
+class LogWriter
+{
+public:
+	LogWriter(std::vector<uint8_t>& buf)
+		: m_buf(buf)
+	{
+	}
+
+	void Begin(uint32_t type);
+	void End();
+
+	void Append(const void* data, size_t len);
+	template <typename T>
+	void Append(const T& v) { Append(&v, sizeof(T)); }
+
+	// fsync of a file written through another handle, throws on failure.
+	static void SyncFile(const std::string& filename);
+
+	static const uint32_t HEADER_SIZE = 3 * sizeof(uint32_t);
+
+private:
+	std::vector<uint8_t>& m_buf;
+
+	size_t m_begin = 0;
+
+}; // LogWriter
+
+class LogReader
+{
+public:
+	LogReader(const uint8_t* data, size_t size)
+		: m_data(data)
+		, m_size(size)
+	{
+	}
+
+	// moves to the next record. False at the end of the log or at a torn
+	// or corrupted record, everything before it is valid.
+	bool Next(uint32_t& type);
+
+	void Read(void* dst, size_t len);
+	template <typename T>
+	T Read() { T v; Read(&v, sizeof(T)); return v; }
+
+	const uint8_t* GetPayload() const { return m_payload; }
+	uint32_t GetPayloadSize() const { return m_payload_size; }
+
+	// end of the last valid record.
+	size_t GetOffset() const { return m_offset; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_offset = 0;
+
+	const uint8_t* m_payload = nullptr;
+	uint32_t m_payload_size = 0;
+	uint32_t m_read = 0;
+
+}; // LogReader
+
+}
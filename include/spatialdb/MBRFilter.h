@@ -0,0 +1,59 @@
+#pragma once
+
+#include "spatialdb/typedef.h"
+
+#include <cstdint>
+
+namespace spatialdb
+{
+
+// Box tests over the coordinate-major child MBRs of a page, see
+// NodeView::GetChildLow. Every call covers up to 64 children starting at
+// begin and returns a mask, bit i standing for child begin + i. The
+// distance kernels write one value per child to out[i] instead. The
+// kernels are instantiated for double and float bounds; the query stays
+// double and is compared exactly against float bounds.
+class MBRFilter
+{
+public:
+	static constexpr uint32_t BATCH = 64;
+
+	// children whose MBR intersects [low, high].
+	template <class T>
+	static uint64_t Intersects(const T* const* child_low, const T* const* child_high,
+		uint32_t begin, uint32_t count, const double* low, const double* high);
+
+	// children whose MBR lies inside [low, high].
+	template <class T>
+	static uint64_t ContainedIn(const T* const* child_low, const T* const* child_high,
+		uint32_t begin, uint32_t count, const double* low, const double* high);
+
+	// the same tests on child MBRs quantized to the cells of a QuantizedGrid,
+	// for uint8_t or uint16_t cells. The query is given as the cells from
+	// QuantizedGrid::GetQueryCells.
+	template <class T>
+	static uint64_t IntersectsCells(const T* const* child_low, const T* const* child_high,
+		uint32_t begin, uint32_t count, const T* low, const T* high);
+	template <class T>
+	static uint64_t ContainedInCells(const T* const* child_low, const T* const* child_high,
+		uint32_t begin, uint32_t count, const T* low, const T* high);
+
+	// squared distance between each child MBR and [low, high], a point
+	// query passes its coordinates as both.
+	template <class T>
+	static void MinDistanceSq(const T* const* child_low, const T* const* child_high,
+		uint32_t begin, uint32_t count, const double* low, const double* high, double* out);
+
+	// squared MINMAXDIST of the point p to each child MBR: the distance
+	// within which an MBR with every face touched by its content holds
+	// at least one entry (Roussopoulos et al.).
+	template <class T>
+	static void MinMaxDistanceSq(const T* const* child_low, const T* const* child_high,
+		uint32_t begin, uint32_t count, const double* p, double* out);
+
+	// pops the lowest set bit of the mask.
+	static uint32_t NextBit(uint64_t& mask);
+
+}; // MBRFilter
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+#include "spatialdb/PageTable.h"
+
+#include <memory>
+#include <string>
+#include <shared_mutex>
+
+namespace spatialdb
+{
+
+// Access pattern hint passed to madvise for the data file mapping.
+enum class MappedAccess
+{
+	Normal,
+	Sequential,
+	Random
+};
+
+// Storage manager over the same .dat/.idx files as DiskStorageManager,
+// with the data file mapped into memory. Pages are read straight from the
+// mapping, entries that fit in one page (or span consecutive pages) are
+// handed out by LoadByteArrayView without a copy. The file grows by
+// doubling the mapped size and is trimmed to the used pages on close.
+// A write-ahead log left by a DiskStorageManager is replayed on open.
+// POSIX only.
+class MappedStorageManager : public IStorageManager
+{
+public:
+	MappedStorageManager(const std::string& filename, bool overwrite = true, uint32_t page_size = 4096);
+	virtual ~MappedStorageManager() override;
+
+	virtual void LoadByteArray(const id_type id, uint32_t& len, uint8_t** data) override;
+	virtual void StoreByteArray(id_type& id, const uint32_t len, const uint8_t* const data) override;
+	virtual void DeleteByteArray(const id_type id) override;
+	virtual void Flush() override;
+
+	virtual bool LoadByteArrayView(const id_type id, uint32_t& len, const uint8_t** data, std::shared_ptr<const void>& owner) override;
+	virtual uint32_t GetPageSize() const override;
+
+	// random is the default, sequential suits full scans and bulk loads.
+	void SetAccessPattern(MappedAccess access);
+
+private:
+	// one mmap of the data file. Views keep the mapping they were served
+	// from alive, also past the manager, growing the file maps a new
+	// region next to it.
+	class Mapping
+	{
+	public:
+		Mapping(int fd, size_t size);
+		~Mapping();
+
+		uint8_t* GetData() const { return m_data; }
+		size_t GetSize() const { return m_size; }
+
+	private:
+		uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+
+	}; // Mapping
+
+	id_type AllocatePage();
+	void Reserve(id_type pages);
+	void Advise() const;
+
+	void WritePages(const std::vector<id_type>& pages, uint32_t len, const uint8_t* data);
+	bool IsContiguous(const PageTable::Entry& e) const;
+
+	// applies the committed groups of a DiskStorageManager log.
+	void Recover(const std::string& wal_file);
+
+	void Release();
+
+private:
+	int m_data_fd = -1;
+
+	std::unique_ptr<PageTable> m_page_table = nullptr;
+
+	uint32_t m_page_size = 0;
+
+	std::shared_ptr<Mapping> m_mapping = nullptr;
+
+	MappedAccess m_access = MappedAccess::Random;
+
+	// loads share the lock, stores and deletes are exclusive.
+	mutable std::shared_mutex m_lock;
+
+}; // MappedStorageManager
+
+}
@@ -1,5 +1,10 @@
 #pragma once
 
+#include "spatialdb/typedef.h"
+
+#include <cstddef>
+#include <memory>
+
 namespace spatialdb
 {
 
@@ -16,6 +21,77 @@ public:
     static bool IntersectsProper(const Point& a, const Point& b, const Point& c, const Point& d);
     static bool Intersects(const Point& a, const Point& b, const Point& c, const Point& d);
 
+    // Orientation predicates with exact signs: the floating point value is
+    // returned when its error bound proves the sign, otherwise the
+    // determinant is summed exactly and only the sign of the result is to
+    // be relied on. Orient2D (xy) is positive if a, b, c turn
+    // counterclockwise, Orient3D is positive if d lies on the side of the
+    // plane through a, b, c from which they appear clockwise.
+    // Both are zero for collinear or coplanar points.
+    static double Orient2D(const double* a, const double* b, const double* c);
+    static double Orient3D(const double* a, const double* b, const double* c, const double* d);
+
+    // exact 3D segment predicates built on the orientation signs.
+    static bool PointOnSegment(const double* p, const double* a, const double* b);
+    // p lies in the closed triangle a, b, c.
+    static bool PointInTriangle(const double* p, const double* a, const double* b, const double* c);
+    static bool SegmentsIntersect(const double* p1, const double* q1, const double* p2, const double* q2);
+    // the segments meet, but only at an endpoint of one of them.
+    static bool SegmentsTouch(const double* p1, const double* q1, const double* p2, const double* q2);
+    // slab test, with touch set a segment crossing no point of the box
+    // interior counts as disjoint, like the tests below.
+    static bool SegmentIntersectsBox(const double* p, const double* q, const double* low, const double* high, bool touch = false);
+
+    // 3D primitives given as coordinate arrays: segments (p, q), boxes
+    // (low, high), triangles (a, b, c) and planar convex polygons of count
+    // vertices stored back to back. All sets are closed, the intersection
+    // tests are separating axis tests. With touch set, sets that only meet
+    // without crossing into each other count as disjoint. Polygons are
+    // expected to have a non-zero area.
+    static bool PolygonIntersectsBox(const double* verts, size_t count, const double* low, const double* high, bool touch = false);
+    static bool PolygonsIntersect(const double* verts1, size_t count1, const double* verts2, size_t count2, bool touch = false);
+    static bool SegmentIntersectsPolygon(const double* p, const double* q, const double* verts, size_t count, bool touch = false);
+
+    // squared euclidean distances, 0 for intersecting sets.
+    static double PointBoxDistanceSq(const double* p, const double* low, const double* high);
+    static double PointSegmentDistanceSq(const double* p, const double* a, const double* b);
+    static double PointTriangleDistanceSq(const double* p, const double* a, const double* b, const double* c);
+    static double SegmentsDistanceSq(const double* p1, const double* q1, const double* p2, const double* q2);
+    static double SegmentBoxDistanceSq(const double* p, const double* q, const double* low, const double* high);
+    static double SegmentTriangleDistanceSq(const double* p, const double* q, const double* a, const double* b, const double* c);
+    static double TrianglesDistanceSq(const double* a1, const double* b1, const double* c1, const double* a2, const double* b2, const double* c2);
+    static double TriangleBoxDistanceSq(const double* a, const double* b, const double* c, const double* low, const double* high);
+
+    // count points of DIMENSION coordinates as the 3D points taken above,
+    // in place for 3D data. 2D points get the third coordinate z; a box is
+    // passed as its low corner at z = -1 and its high corner at z = 1, so
+    // that 2D shapes touching it, or crossing its interior, do in 3D too.
+    class Lifted
+    {
+    public:
+        explicit Lifted(const double* coords, size_t count = 1, double z = 0.0)
+            : m_coords(coords)
+        {
+            if (DIMENSION != 3) {
+                Lift(coords, count, z);
+            }
+        }
+        Lifted(const Lifted&) = delete;
+        Lifted& operator=(const Lifted&) = delete;
+
+        operator const double*() const { return m_coords; }
+
+    private:
+        void Lift(const double* coords, size_t count, double z);
+
+    private:
+        const double* m_coords;
+        // points, segments and triangles are lifted without allocating.
+        double m_inline[9];
+        std::unique_ptr<double[]> m_heap;
+
+    }; // Lifted
+
 }; // Math
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "spatialdb/SpatialIndex.h"
 
 #include <stack>
+#include <cstring>
 
 namespace spatialdb
 {
@@ -18,6 +19,8 @@ public:
 	virtual void DeleteByteArray(const id_type id) override;
 	virtual void Flush() override;
 
+	virtual bool LoadByteArrayView(const id_type id, uint32_t& len, const uint8_t** data, std::shared_ptr<const void>& owner) override;
+
 private:
 	class Entry
 	{
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+#include "spatialdb/NodeView.h"
+
+#include <memory>
+#include <vector>
+#include <limits>
+#include <shared_mutex>
+
+namespace spatialdb
+{
+
+class RTree;
+
+// Best-first k-NN iterator. Every Next returns the next nearest entry, the
+// tree is only read as far as needed, so callers stop at any count or
+// distance. Queue entries are plain values in a reused heap, leaf entries
+// point into the pages they came from and the payload is copied only when
+// GetData is called on a result. Without a comparator, point and region
+// queries are ranked by squared distances computed straight from the page
+// arrays. The tree is read locked as long as the cursor lives, writers
+// wait until it is destroyed.
+class NearestNeighborCursor
+{
+public:
+	// a result, valid until the next call of Next. Clone copies it into a
+	// Data, which stays valid after the page changes.
+	class Entry : public IData
+	{
+	public:
+		Entry() {}
+		Entry(const std::shared_ptr<const NodeView>& node, uint32_t index);
+
+		//
+		// IObject interface
+		//
+		virtual IObject* Clone() override;
+
+		//
+		// IEntry interface
+		//
+		virtual id_type GetIdentifier() const override;
+		virtual void GetShape(IShape** out) const override;
+
+		//
+		// IData interface
+		//
+		virtual void GetData(uint32_t& len, uint8_t** data) const override;
+
+		// no allocation variants.
+		void GetMBR(Region& out) const;
+		const uint8_t* GetData(uint32_t& len) const;
+
+	private:
+		std::shared_ptr<const NodeView> m_node = nullptr;
+		uint32_t m_index = 0;
+
+	}; // Entry
+
+public:
+	// the query shape must outlive the cursor. Without a comparator the
+	// distance is IShape::GetMinimumDistance to the entry MBR.
+	NearestNeighborCursor(RTree& tree, const IShape& query);
+	NearestNeighborCursor(RTree& tree, const IShape& query, INearestNeighborComparator& nnc);
+
+	// the next nearest entry, nullptr once the tree is exhausted or the
+	// next entry is farther than max_distance (it is returned by a later
+	// call with a larger bound).
+	const Entry* Next(double max_distance = std::numeric_limits<double>::max());
+	double GetDistance() const { return m_distance; }
+
+	// promises that no more than the k nearest entries, plus those tied
+	// with the k-th, are asked for; entries that cannot be among them are
+	// not queued. 0 lifts the limit. Kept across Reset.
+	void SetLimit(uint32_t k);
+
+	// restarts from the root, the buffers are kept.
+	void Reset(const IShape& query);
+
+private:
+	NearestNeighborCursor(RTree& tree, const IShape& query, INearestNeighborComparator* nnc, IVisitor* v, bool lock);
+
+	struct Item
+	{
+		double dist;
+		id_type id;
+		// index in m_leaves of the page of a data entry, NODE for a node.
+		uint32_t leaf;
+		uint32_t child;
+	};
+	static const uint32_t NODE = 0xffffffff;
+
+	void Expand(id_type page);
+	void Push(double dist, id_type id, uint32_t leaf, uint32_t child);
+	// the k-th smallest of the distances known to be reached by distinct
+	// entries caps every later result.
+	void Tighten();
+
+	static bool Farther(const Item& a, const Item& b);
+
+private:
+	RTree& m_tree;
+	std::shared_lock<std::shared_mutex> m_lock;
+
+	const IShape* m_query = nullptr;
+	INearestNeighborComparator* m_nnc = nullptr;
+	// gets VisitNode for every page read, children of pages it does not
+	// continue on are skipped.
+	IVisitor* m_visitor = nullptr;
+
+	// point and region queries without a comparator, dist is squared.
+	bool m_squared = false;
+	double m_low[DIMENSION] = {};
+	double m_high[DIMENSION] = {};
+	// MINMAXDIST bounds the index entries of point queries on tight MBRs.
+	bool m_minmax = false;
+
+	uint32_t m_limit = 0;
+	// nothing farther than this is queued.
+	double m_prune = std::numeric_limits<double>::max();
+	// max-heap of the m_limit smallest data entry distances queued.
+	std::vector<double> m_best;
+	std::vector<double> m_bounds;
+	std::vector<double> m_dist;
+
+	// min-heap on dist.
+	std::vector<Item> m_heap;
+	std::vector<std::shared_ptr<const NodeView>> m_leaves;
+
+	Entry m_current;
+	double m_distance = 0.0;
+
+	friend class RTree;
+
+}; // NearestNeighborCursor
+
+}
@@ -2,6 +2,7 @@
 
 #include "spatialdb/SpatialIndex.h"
 #include "spatialdb/Region.h"
+#include "spatialdb/QuantizedGrid.h"
 
 #include <stack>
 #include <memory>
@@ -52,12 +53,33 @@ public:
 
 	auto& GetRegion() const { return m_node_mbr; }
 
+	// approximate heap footprint of the decoded node.
+	size_t GetMemorySize() const;
+
+	// the stored size of a node with the given children and payload bytes.
+	static uint32_t GetNodeSize(NodeEncoding encoding, uint32_t children, uint32_t data_len);
+
 protected:
 	Node(RTree* tree, id_type id, uint32_t level, uint32_t capacity);
 
+	// called by everything that modifies the node before the first change.
+	// ReadNode hands out the instances of the node cache, a node that is
+	// changed must not stay there in case its write fails.
+	void EvictFromCache();
+
 	void InsertEntry(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id);
 	void DeleteEntry(uint32_t index);
 
+	// index entries carry the number of data entries below them as their
+	// payload. False if an entry written before the counts were kept has none.
+	bool GetSubtreeCount(uint64_t& count) const;
+	// the payload of the parent entry pointing to this node, nullptr and 0
+	// if the count is not known. The caller owns the buffer.
+	uint8_t* NewEntryData(uint32_t& len) const;
+	// sets the MBR and the count of the entry pointing to n, the node MBR
+	// is left to the caller.
+	void UpdateEntry(uint32_t child, const Node& n);
+
 	bool InsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id, std::stack<id_type>& path_buf, uint8_t* overflow_tbl);
 	void ReinsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id, std::vector<uint32_t>& reinsert, std::vector<uint32_t>& keep);
 
@@ -68,6 +90,10 @@ protected:
 
 	void CondenseTree(std::stack<std::shared_ptr<Node>>& to_reinsert, std::stack<id_type>& path_buf, std::shared_ptr<Node>& ptr_this);
 
+	// the encoding of the child MBRs when the node is stored, see
+	// RTreeOptions::index_encoding.
+	NodeEncoding GetPageEncoding() const;
+
 protected:
 	RTree* m_tree = nullptr;
 
@@ -86,9 +112,14 @@ protected:
 
 	uint32_t m_total_data_len = 0;
 
+	// the encoding of the page the node was read from. Quantized child
+	// MBRs contain the node MBRs of their children instead of matching them.
+	NodeEncoding m_encoding = NodeEncoding::Plain;
+
 	friend class RTree;
 	friend class Index;
 	friend class Leaf;
+	friend class BulkLoader;
 
 }; // Node
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "spatialdb/typedef.h"
+
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+namespace spatialdb
+{
+
+class Node;
+
+// Decoded nodes keyed by page id. Unpinned entries are evicted in LRU
+// order once the byte budget is exceeded, pinned ones stay until they
+// are erased. All operations are serialized by an internal mutex, so
+// concurrent readers of the tree may share one cache.
+class NodeCache
+{
+public:
+	NodeCache(size_t budget, uint32_t pinned_levels);
+
+	std::shared_ptr<Node> Find(id_type page);
+	void Insert(id_type page, const std::shared_ptr<Node>& n, size_t size, bool pinned);
+	void Erase(id_type page);
+	void Clear();
+
+	void SetBudget(size_t budget);
+	size_t GetBudget() const { return m_budget; }
+	size_t GetSize() const;
+
+	void SetPinnedLevels(uint32_t levels) { m_pinned_levels = levels; }
+	uint32_t GetPinnedLevels() const { return m_pinned_levels; }
+
+private:
+	void Remove(id_type page);
+	void Evict();
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<Node> node;
+		size_t size;
+		bool pinned;
+		std::list<id_type>::iterator lru;
+	};
+
+	size_t m_budget = 0;
+	size_t m_size = 0;
+
+	uint32_t m_pinned_levels = 0;
+
+	std::unordered_map<id_type, Entry> m_map;
+
+	// unpinned pages, most recently used first.
+	std::list<id_type> m_lru;
+
+	mutable std::mutex m_lock;
+
+}; // NodeCache
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+#include "spatialdb/Region.h"
+#include "spatialdb/QuantizedGrid.h"
+
+#include <memory>
+
+namespace spatialdb
+{
+
+// Read-only node that interprets the serialized page layout in place
+// (see Node::StoreToByteArray), used by the query paths instead of
+// deserializing a Node for every visited page. Pages are expected to be
+// 8-byte aligned, the child bounds are read as coord_type arrays. The
+// bounds of a quantized page are filtered on its cells and decoded on
+// the first access to the arrays.
+class NodeView : public INode
+{
+public:
+	NodeView() {}
+	NodeView(id_type id, uint32_t len, const uint8_t* data, const std::shared_ptr<const void>& owner);
+
+	//
+	// IObject interface
+	//
+	virtual IObject* Clone() override;
+
+	//
+	// ISerializable interface
+	//
+	virtual uint32_t GetByteArraySize() const override;
+	virtual void LoadFromByteArray(const uint8_t* data) override;
+	virtual void StoreToByteArray(uint8_t** data, uint32_t& len) const override;
+
+	//
+	// IEntry interface
+	//
+	virtual id_type GetIdentifier() const override;
+	virtual void GetShape(IShape** s) const override;
+
+	//
+	// INode interface
+	//
+	virtual uint32_t GetChildrenCount() const override;
+	virtual id_type GetChildIdentifier(uint32_t index) const override;
+	virtual void GetChildShape(uint32_t index, IShape** out) const override;
+	virtual void GetChildData(uint32_t index, uint32_t& length, uint8_t** data) const override;
+	virtual uint32_t GetLevel() const override;
+	virtual bool IsIndex() const override;
+	virtual bool IsLeaf() const override;
+
+	// no allocation variants of the INode accessors.
+	void GetChildMBR(uint32_t index, Region& out) const;
+	const uint8_t* GetChildData(uint32_t index, uint32_t& length) const;
+
+	// coordinate-major child bounds, GetChildLow(d)[i] is the low
+	// coordinate of child i in dimension d.
+	const coord_type* GetChildLow(uint32_t dim) const { Decode(); return m_child_low[dim]; }
+	const coord_type* GetChildHigh(uint32_t dim) const { Decode(); return m_child_high[dim]; }
+	const coord_type* const* GetChildLow() const { Decode(); return m_child_low; }
+	const coord_type* const* GetChildHigh() const { Decode(); return m_child_high; }
+
+	// MBRFilter::Intersects and ContainedIn of the children [begin, begin
+	// + count), on the cells of a quantized page.
+	uint64_t FilterIntersects(uint32_t begin, uint32_t count, const double* low, const double* high) const;
+	uint64_t FilterContainedIn(uint32_t begin, uint32_t count, const double* low, const double* high) const;
+
+	// child MBRs of a quantized page contain the node MBRs of the children
+	// rather than matching them.
+	NodeEncoding GetEncoding() const { return m_encoding; }
+
+	auto& GetRegion() const { return m_node_mbr; }
+
+private:
+	void Reset(id_type id, uint32_t len, const uint8_t* data);
+
+	uint32_t Seek(uint32_t index) const;
+
+	void Decode() const
+	{
+		if (m_encoding != NodeEncoding::Plain && m_decoded == nullptr) {
+			DecodeCells();
+		}
+	}
+	void DecodeCells() const;
+	// the cell of a bound, b = 0 for low and 1 for high.
+	uint32_t GetCell(int b, int dim, uint32_t index) const;
+
+	template <bool Contained>
+	uint64_t Filter(uint32_t begin, uint32_t count, const double* low, const double* high) const;
+
+private:
+	id_type  m_identifier = -1;
+	uint32_t m_level = 0;
+	uint32_t m_children = 0;
+
+	Region m_node_mbr;
+
+	const uint8_t* m_data = nullptr;
+	uint32_t m_len = 0;
+
+	mutable const coord_type* m_child_low[DIMENSION] = {};
+	mutable const coord_type* m_child_high[DIMENSION] = {};
+	const id_type*  m_child_id = nullptr;
+	const uint32_t* m_child_len = nullptr;
+	const uint8_t*  m_payload = nullptr;
+
+	NodeEncoding m_encoding = NodeEncoding::Plain;
+	QuantizedGrid m_grid;
+	const uint8_t* m_cells = nullptr;
+	// the bounds decoded from the cells, shared by the copies of the view.
+	mutable std::shared_ptr<coord_type[]> m_decoded = nullptr;
+
+	// keeps the page alive, e.g. a storage manager cache entry.
+	std::shared_ptr<const void> m_owner = nullptr;
+
+	// payloads have variable length, sequential access is served
+	// from the offset of the last visited one.
+	mutable uint32_t m_cursor_index = 0;
+	mutable uint32_t m_cursor_offset = 0;
+
+}; // NodeView
+
+}
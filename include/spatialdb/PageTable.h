@@ -0,0 +1,77 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+
+#include <fstream>
+#include <set>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace spatialdb
+{
+
+// Maps the ids of the stored byte arrays to the data file pages holding
+// them, shared by the file backed storage managers. The table is kept in
+// the .idx file as a log: a flush appends the entries changed since the
+// last one and the file is compacted into a snapshot once superseded
+// records take more than half of it. Free pages are not persisted, they
+// are recomputed on open. Not thread safe, the owner serializes calls.
+class PageTable
+{
+public:
+	struct Entry
+	{
+		uint32_t length = 0;
+		std::vector<id_type> pages;
+	};
+
+	// reads the index file unless overwrite is set, the legacy index
+	// written before the log format is converted on the first flush.
+	PageTable(const std::string& filename, bool overwrite, uint32_t page_size);
+
+	// sync makes the appended records durable, snapshots always are.
+	void Flush(bool sync = false);
+
+	uint32_t GetPageSize() const { return m_page_size; }
+	id_type GetNextPage() const { return m_next_page; }
+
+	const Entry* Find(id_type id) const;
+	void Put(id_type id, Entry&& e);
+	void Erase(id_type id);
+
+	id_type AllocatePage();
+	void FreePage(id_type page);
+
+	// recomputes the free pages from the entries after a recovery.
+	void RebuildEmptyPages();
+
+private:
+	void LoadLog(const std::vector<uint8_t>& buf);
+	void LoadLegacy(const std::vector<uint8_t>& buf);
+
+	bool AppendRecords();
+	void WriteSnapshot();
+
+private:
+	std::string m_filename;
+	std::fstream m_file;
+
+	uint32_t m_page_size = 0;
+	id_type m_next_page = 0;
+
+	std::set<id_type> m_empty_pages;
+	std::map<id_type, Entry> m_entries;
+
+	// entries stored or deleted since the last flush.
+	std::set<id_type> m_dirty_entries;
+	id_type m_flushed_next_page = 0;
+
+	// valid bytes of the log and the size a snapshot would take.
+	uint64_t m_log_size = 0;
+	uint64_t m_snapshot_size = 0;
+	bool m_compact = false;
+
+}; // PageTable
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "spatialdb/typedef.h"
+
+#include <cstdint>
+
+namespace spatialdb
+{
+
+// how the child MBRs of a page are stored, kept in the reserved field of
+// the page header. Leaves are always Plain.
+enum class NodeEncoding : uint32_t
+{
+	Plain = 0,			// coord_type bounds
+	Quantized8 = 1,		// uint8_t cells of the node MBR
+	Quantized16 = 2,	// uint16_t cells of the node MBR
+};
+
+// the reserved header word holds the page format version in its upper
+// half and the NodeEncoding in the lower one. Pages of another version
+// are rejected on load.
+const uint32_t PAGE_FORMAT_VERSION = 1;
+
+inline uint32_t MakePageFormat(NodeEncoding encoding)
+{
+	return PAGE_FORMAT_VERSION << 16 | static_cast<uint32_t>(encoding);
+}
+
+inline bool IsPageFormat(uint32_t format)
+{
+	return format >> 16 == PAGE_FORMAT_VERSION && (format & 0xffff) <= static_cast<uint32_t>(NodeEncoding::Quantized16);
+}
+
+inline NodeEncoding GetFormatEncoding(uint32_t format)
+{
+	return static_cast<NodeEncoding>(format & 0xffff);
+}
+
+// The node MBR of a quantized page cut into a grid of cells. Cell boundary
+// q of a dimension is the coord_type Bound(dim, q), non-decreasing in q,
+// from the node low at q = 0 to the node high at q = steps. A child MBR is
+// stored as the last boundary at or below its low and the first at or
+// above its high, so the decoded MBR contains the child.
+class QuantizedGrid
+{
+public:
+	QuantizedGrid() {}
+	QuantizedGrid(const double* low, const double* high, NodeEncoding encoding);
+
+	// whether the node MBR [low, high] can be cut into cells.
+	static bool Fits(const double* low, const double* high);
+	// bytes of the child bounds of a page, padded to keep the ids aligned.
+	static uint32_t GetBoundsSize(NodeEncoding encoding, uint32_t children);
+
+	uint32_t GetSteps() const { return m_steps; }
+
+	double Bound(int dim, uint32_t q) const
+	{
+		return q >= m_steps ? m_high[dim] : RoundDown(m_low[dim] + q * m_step[dim]);
+	}
+
+	// the largest q with Bound(dim, q) <= x, -1 if there is none.
+	int64_t Below(int dim, double x) const;
+	// the smallest q with Bound(dim, q) >= x, steps + 1 if there is none.
+	int64_t Above(int dim, double x) const;
+
+	// the cells of a child MBR [low, high] inside the node MBR.
+	void GetCells(const double* low, const double* high, uint32_t* cell_low, uint32_t* cell_high) const;
+	// the cells a child has to reach to meet the query [low, high]: a
+	// decoded child intersects the query if and only if its low cell is at
+	// most cell_high and its high cell at least cell_low, and lies inside
+	// it if its low cell is at least cell_low and its high cell at most
+	// cell_high. False if no child can do either.
+	bool GetQueryCells(const double* low, const double* high, uint32_t* cell_low, uint32_t* cell_high) const;
+
+private:
+	// the last q below steps with Bound(dim, q) < x, or <= x with
+	// inclusive set, given that q = 0 passes and q = steps does not.
+	int64_t Split(int dim, double x, bool inclusive) const;
+
+private:
+	double m_low[DIMENSION] = {};
+	double m_high[DIMENSION] = {};
+	double m_step[DIMENSION] = {};
+	uint32_t m_steps = 0;
+
+}; // QuantizedGrid
+
+}
@@ -1,20 +1,74 @@
 #pragma once
 
 #include "spatialdb/SpatialIndex.h"
+#include "spatialdb/BulkLoader.h"
+#include "spatialdb/NodeCache.h"
+#include "spatialdb/QuantizedGrid.h"
 
 #include <memory>
 #include <map>
 #include <string>
+#include <atomic>
+#include <shared_mutex>
 
 namespace spatialdb
 {
 
 class Node;
+class NodeView;
 
+// The parameters a tree is created with, kept in its header. Nodes are
+// sized to fit in node_pages pages of the storage manager, so every node
+// is one read. The RTree constructor checks them and throws
+// IllegalArgumentException for values it can not build a tree with.
+struct RTreeOptions
+{
+	RTreeVariant variant = RV_RSTAR;
+	// the minimum load of a node after a split, and the load of the nodes
+	// of a bulk load, as a fraction of its capacity.
+	double fill_factor = 0.7;
+	bool tight_mbrs = true;
+
+	// entries per node, 0 derives the most that fit in the node pages.
+	// A capacity given must fit, and be at least 4.
+	uint32_t index_capacity = 0;
+	uint32_t leaf_capacity = 0;
+
+	// the payload bytes reserved per leaf entry. Index entries carry 8
+	// bytes.
+	uint32_t leaf_payload = 8;
+	// longer payloads than leaf_payload throw IllegalArgumentException.
+	// Otherwise they are stored, and a leaf holding them may span more
+	// than node_pages pages.
+	bool limit_payload = false;
+
+	// 0 takes the page size of the storage manager, or 4096 if it has
+	// none. A node spans node_pages pages at most.
+	uint32_t page_size = 0;
+	uint32_t node_pages = 1;
+
+	// see NodeEncoding, quantized index pages hold about three times the
+	// entries. The MBRs of index entries are then no longer tight: nearest
+	// neighbor queries go without MINMAXDIST and aggregate MBRs open the
+	// subtrees inside the query. Entries must have finite MBRs with
+	// coordinates below half the largest double, others throw
+	// IllegalArgumentException.
+	NodeEncoding index_encoding = NodeEncoding::Plain;
+};
+
+// Queries (and IsIndexValid, GetMetaPage, HasMetaPage) take a shared lock
+// and run in parallel with each other, everything that modifies the tree
+// takes an exclusive lock. Visitors, query strategies and read commands
+// are called from the querying threads. The node level accessors
+// (WriteNode, ReadNode, DeleteNode, ReadNodeView) are not synchronized.
 class RTree : public ISpatialIndex
 {
 public:
+	// opens the tree of the storage manager, or creates one with the
+	// default options if overwrite is set.
 	RTree(const std::shared_ptr<IStorageManager>& sm, bool overwrite);
+	// creates a tree.
+	RTree(const std::shared_ptr<IStorageManager>& sm, const RTreeOptions& options);
 	virtual ~RTree();
 
 	//
@@ -37,40 +91,121 @@ public:
 	//virtual void GetStatistics(IStatistics** out) const override;
 	virtual void Flush() override;
 
+	// the range queries with the results going to a sink, see IResultSink.
+	// Nothing is copied unless the sink does, Count and Identifier sinks
+	// never touch the payload.
+	void ContainsWhatQuery(const IShape& query, IResultSink& sink);
+	void IntersectsWithQuery(const IShape& query, IResultSink& sink);
+	void PointLocationQuery(const Point& query, IResultSink& sink);
+
+	// the number and the union MBR of the entries a range query finds.
+	// Index entries keep the number of data entries below them, subtrees
+	// inside the query are summed up from their parent entries without
+	// being read. The MBR of no entries is infinite. Count sinks given to
+	// the range queries above are answered the same way.
+	struct Aggregate
+	{
+		uint64_t count = 0;
+		Region mbr;
+	};
+	void AggregateQuery(RangeQueryType type, const IShape& query, Aggregate& out);
+
+	// Between BeginBatch and CommitBatch node writes stay in memory, a page
+	// written many times is stored once by the commit. Queries see the
+	// uncommitted nodes. With a write-ahead log the batch is one group.
+	void BeginBatch();
+	void CommitBatch();
+	// inserts the entries as one batch, or into the batch already open.
+	void InsertBatch(const BulkLoadEntry* entries, size_t count);
+
+	// the tree must be empty, i.e. freshly created with overwrite.
+	void BulkLoad(IDataStream& stream, BulkLoadMethod method = BulkLoadMethod::STR);
+	void BulkLoad(const BulkLoadEntry* entries, size_t count, BulkLoadMethod method = BulkLoadMethod::STR);
+
+	// decoded nodes read by the insert and delete paths are kept in memory,
+	// the top pinned_levels levels are never evicted.
+	void SetNodeCache(size_t budget, uint32_t pinned_levels);
+
 	id_type WriteNode(const Node& n);
 	std::shared_ptr<Node> ReadNode(id_type page);
 	void DeleteNode(const Node& n);
 
+	// read-only access for the query paths, the page is not deserialized.
+	NodeView ReadNodeView(id_type page);
+	// appends the nodes in the order of pages, the reads are issued as one batch.
+	void ReadNodeViews(const std::vector<id_type>& pages, std::vector<NodeView>& out);
+
+	// range queries walk the tree level by level and read all children of a
+	// level through one IStorageManager::LoadByteArrays call. Results come
+	// in a different order than the default depth first walk.
+	void SetBatchedReads(bool enable);
+
+	// intersection queries of many shapes in one walk: every node is read
+	// once per batch and its children are tested against the queries still
+	// active below it, 64 queries at a time. visitors[i] gets the nodes and
+	// results of queries[i], Skip or Stop drops the query below that node.
+	void IntersectsWithQueries(size_t count, const IShape* const* queries, IVisitor* const* visitors);
+
+	// pairs of intersecting entries of this tree and other, given to
+	// VisitData(std::vector<const IData*>&) as (entry of this, entry of
+	// other). The entries are read in place and only valid during the
+	// call, VisitNode is not called. Node pairs are matched by a sweep over
+	// their sorted children, trees of different height are supported.
+	void JoinQuery(RTree& other, IVisitor& v);
+
 	void SetMetaPage(const std::string& key, id_type page);
 	id_type GetMetaPage(const std::string& key) const;
 	bool HasMetaPage(const std::string& key) const;
 	void RemoveMetaPage(const std::string& key);
+	// stores data in the meta page named key, creating it if needed. The
+	// page and the header naming it are committed as one group.
+	void StoreMetaData(const std::string& key, uint32_t len, const uint8_t* data);
+	// reads the meta page named key into *data, which the caller deletes[].
+	// Throws IllegalArgumentException for an unknown key.
+	void LoadMetaData(const std::string& key, uint32_t& len, uint8_t** data) const;
 
 private:
-	void InitNew();
+	void InitNew(const RTreeOptions& options);
 	void InitOld();
 	void StoreHeader();
 	void LoadHeader();
+	// ends the current write operation for storage managers with a log.
+	void Commit();
+	void StoreDirtyPages();
 
+	// throws IllegalArgumentException if the payload exceeds the limit.
+	void CheckPayload(uint32_t data_len) const;
+	// throws IllegalArgumentException if quantized index nodes could not
+	// cut a node MBR containing mbr into cells.
+	void CheckMBR(const Region& mbr) const;
 	void InsertDataImpl(uint32_t data_len, uint8_t* data, Region& mbr, id_type id);
 	void InsertDataImpl(uint32_t data_len, uint8_t* data, Region& mbr, id_type id, uint32_t level, uint8_t* overflow_tbl);
 	bool DeleteDataImpl(const Region& mbr, id_type id);
 
-	void RangeQuery(RangeQueryType type, const IShape& query, IVisitor& v);
-	void SelfJoinQuery(id_type id1, id_type id2, const Region& r, IVisitor& vis);
-	void VisitSubTree(const std::shared_ptr<Node>& sub_tree, IVisitor& v);
+	NodeView CreateNodeView(id_type page, uint32_t len, const uint8_t* data, const std::shared_ptr<const void>& owner);
+
+	// the results go to the visitor, or to the sink if v is null.
+	void ContainsWhatQueryImpl(const IShape& query, IVisitor* v, IResultSink* sink);
+	void RangeQuery(RangeQueryType type, const IShape& query, IVisitor* v, IResultSink* sink);
+	void CountQuery(RangeQueryType type, const IShape& query, IResultSink& sink);
+	// the MBR is only computed if mbr is set.
+	void AggregateQueryImpl(RangeQueryType type, const IShape& query, uint64_t& count, Region* mbr);
+	void NearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator* nnc);
+	void VisitSubTree(const NodeView& sub_tree, IVisitor* v, IResultSink* sink);
 
 private:
 	struct Statistics
 	{
-		uint64_t reads = 0;
+		// updated by concurrent queries.
+		std::atomic<uint64_t> reads{ 0 };
+		std::atomic<uint64_t> hits{ 0 };
+		std::atomic<uint64_t> misses{ 0 };
+		std::atomic<uint64_t> query_results{ 0 };
+
 		uint64_t writes = 0;
 		uint64_t splits = 0;
-		uint64_t hits = 0;
-		uint64_t misses = 0;
 		uint32_t nodes = 0;
 		uint64_t adjustments = 0;
-		uint64_t query_results = 0;
 		uint64_t data = 0;
 		uint32_t tree_height = 0;
 		std::vector<uint32_t> nodes_in_level;
@@ -96,15 +231,47 @@ private:
 
 	bool m_tight_mbrs = true;
 
+	NodeEncoding m_index_encoding = NodeEncoding::Plain;
+
+	// the most bytes a node takes and the payload bytes reserved per leaf
+	// entry, 0 if the tree was created without a bound. Longer payloads
+	// throw with m_limit_payload set.
+	uint32_t m_node_size = 0;
+	uint32_t m_leaf_payload = 0;
+	bool m_limit_payload = false;
+
+	// node writes and deletes over the life of the index, stored with the
+	// header. Resumed range query cursors check that the pages of their
+	// path did not change, also across a reopen.
+	uint64_t m_generation = 0;
+
+	bool m_batched_reads = false;
+
+	// serialized nodes written while a batch is open.
+	struct DirtyPage
+	{
+		uint32_t len;
+		std::shared_ptr<uint8_t> data;
+	};
+	std::map<id_type, DirtyPage> m_dirty_pages;
+	bool m_batch = false;
+
 	std::vector<std::shared_ptr<ICommand>> m_write_node_cmds;
 	std::vector<std::shared_ptr<ICommand>> m_read_node_cmds;
 	std::vector<std::shared_ptr<ICommand>> m_delete_node_cmds;
 
 	std::map<std::string, id_type> m_meta_pages;
 
+	NodeCache m_node_cache = NodeCache(16 * 1024 * 1024, 2);
+
+	mutable std::shared_mutex m_lock;
+
 	friend class Node;
 	friend class Leaf;
 	friend class Index;
+	friend class BulkLoader;
+	friend class NearestNeighborCursor;
+	friend class RangeQueryCursor;
 
 }; // RTree
 
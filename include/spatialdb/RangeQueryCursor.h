@@ -0,0 +1,68 @@
+#pragma once
+
+#include "spatialdb/SpatialIndex.h"
+#include "spatialdb/NodeView.h"
+#include "spatialdb/CancellationToken.h"
+
+#include <vector>
+
+namespace spatialdb
+{
+
+class RTree;
+
+// Depth first range query handing out its results a page at a time. The
+// state is the path of pages being scanned and the next child of each, so
+// Fetch continues where the last call stopped and GetContinuation turns
+// it into bytes that resume the query in another cursor later on. The
+// tree is read locked during Fetch only; the tree must not be modified
+// between the calls, Fetch throws IllegalStateException if it was.
+class RangeQueryCursor
+{
+public:
+	// the query shape must outlive the cursor.
+	RangeQueryCursor(RTree& tree, RangeQueryType type, const IShape& query);
+	// resumes the query of a continuation, type and query must be the
+	// ones it was made with.
+	RangeQueryCursor(RTree& tree, RangeQueryType type, const IShape& query, const std::vector<uint8_t>& continuation);
+
+	// hands up to limit results to the sink and returns how many. Stops
+	// early once the query is done or the token is cancelled, the results
+	// left are returned by later calls.
+	size_t Fetch(IResultSink& sink, size_t limit, const CancellationToken* cancel = nullptr);
+	// no pages are left to scan. A Fetch may return no results before.
+	bool IsDone() const { return m_path.empty(); }
+
+	// the pages and child offsets of the path, together with the tree
+	// state they are valid for.
+	void GetContinuation(std::vector<uint8_t>& out) const;
+
+private:
+	struct Frame
+	{
+		id_type page;
+		// the first child not scanned yet.
+		uint32_t next;
+		// read on the first visit, or again after a resume.
+		bool loaded;
+		NodeView node;
+	};
+
+	// children [base, base + 64) of n matching the query.
+	uint64_t Filter(const NodeView& n, uint32_t base) const;
+
+private:
+	RTree& m_tree;
+	RangeQueryType m_type;
+	const IShape& m_query;
+	// region queries are decided by the MBR filter alone.
+	bool m_exact;
+	Region m_query_mbr;
+
+	// the tree generation the path is valid for.
+	uint64_t m_generation = 0;
+	std::vector<Frame> m_path;
+
+}; // RangeQueryCursor
+
+}
@@ -65,6 +65,9 @@ public:
 	void Combine(const Point& p);
 
 	void MakeInfinite();
+	// widens the bounds to the nearest coord_type values, as the node
+	// pages store them.
+	void RoundOutward();
 
 private:
 	void Initialize(const double* low, const double* high);
@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <memory>
+#include <functional>
 
 namespace spatialdb
 {
@@ -110,6 +111,42 @@ public:
 	virtual void DeleteByteArray(const id_type id) = 0;
 	virtual void Flush() = 0;
 	virtual ~IStorageManager() = default;
+
+	// Zero-copy variant of LoadByteArray. Returns false if the page can not be
+	// exposed in place, otherwise data stays valid as long as owner is held
+	// and the page is neither stored nor deleted.
+	virtual bool LoadByteArrayView(const id_type, uint32_t&, const uint8_t**, std::shared_ptr<const void>&) { return false; }
+
+	// Ends a group of stores and deletes that is recovered as a whole after a
+	// crash. Only managers with a write-ahead log act on it.
+	virtual bool HasWriteAheadLog() const { return false; }
+	virtual void Commit() {}
+
+	// The size of the pages entries are stored in, an entry longer than a
+	// page spans several. 0 for managers without pages.
+	virtual uint32_t GetPageSize() const { return 0; }
+
+	// Loads a batch of entries. done is called once per entry with its index in
+	// ids, on the calling thread, before LoadByteArrays returns; data stays valid
+	// as long as owner is held. File backed managers overlap the reads.
+	using LoadCallback = std::function<void(size_t index, uint32_t len, const uint8_t* data, const std::shared_ptr<const void>& owner)>;
+	virtual void LoadByteArrays(const std::vector<id_type>& ids, const LoadCallback& done)
+	{
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			uint32_t len;
+			const uint8_t* data;
+			std::shared_ptr<const void> owner;
+			if (!LoadByteArrayView(ids[i], len, &data, owner))
+			{
+				uint8_t* buffer;
+				LoadByteArray(ids[i], len, &buffer);
+				owner = std::shared_ptr<uint8_t>(buffer, std::default_delete<uint8_t[]>());
+				data = buffer;
+			}
+			done(i, len, data, owner);
+		}
+	}
 }; // IStorageManager
 
 class IVisitor
@@ -121,6 +158,28 @@ public:
 	virtual ~IVisitor() = default;
 }; // IVisitor
 
+enum class ResultDetail
+{
+	Count,
+	Identifier,
+	Entry
+};
+
+// Takes query results read in place from the pages, the MBR and payload of
+// AddEntry are only valid during the call. Only the calls for the detail
+// the sink asks for are made: Count sinks get AddCount (the counts of all
+// calls add up), Identifier sinks AddIdentifier and Entry sinks AddEntry
+// per result.
+class IResultSink
+{
+public:
+	virtual ResultDetail GetDetail() const = 0;
+	virtual void AddCount(uint64_t) {}
+	virtual void AddIdentifier(id_type) {}
+	virtual void AddEntry(id_type, const Region&, const uint8_t*, uint32_t) {}
+	virtual ~IResultSink() = default;
+}; // IResultSink
+
 class IQueryStrategy
 {
 public:
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <exception>
+#include <cstdint>
+
+namespace spatialdb
+{
+
+// Fixed set of worker threads running indexed tasks. Run hands out the
+// indices [0, count) to the workers and the calling thread and returns
+// once all of them are done. One Run executes at a time.
+class ThreadPool
+{
+public:
+	// 0 picks std::thread::hardware_concurrency.
+	ThreadPool(size_t threads = 0);
+	~ThreadPool();
+
+	void Run(size_t count, const std::function<void(size_t)>& task);
+
+	size_t GetThreadCount() const { return m_workers.size() + 1; }
+
+private:
+	void Work();
+
+	// pulls indices of the current job until it is exhausted.
+	void Drain();
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_run_lock;
+
+	std::mutex m_lock;
+	std::condition_variable m_wake, m_done;
+
+	const std::function<void(size_t)>* m_task = nullptr;
+	size_t m_count = 0, m_next = 0, m_finished = 0;
+	uint64_t m_generation = 0;
+
+	std::exception_ptr m_error = nullptr;
+
+	bool m_stop = false;
+
+}; // ThreadPool
+
+}
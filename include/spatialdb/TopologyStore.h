@@ -0,0 +1,105 @@
+#pragma once
+
+#include "spatialdb/typedef.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace spatialdb
+{
+
+class IShape;
+class RTree;
+
+// Face, edge and vertex adjacency of a B-rep, kept next to the RTree that
+// indexes its faces and edges. Every relation is a CSR array: sorted keys,
+// offsets and the concatenated targets, looked up by binary search or, for
+// keys without gaps, by position. Faces, edges and vertices share the id
+// space of the tree, so the hits of a query map straight to the topology
+// without reading the tree again. Faces and edges are added, then Build
+// makes them visible together with the inverse relations.
+class TopologyStore
+{
+public:
+	TopologyStore() {}
+
+	// the edges bounding a face, in order. Every face and edge is added once.
+	void AddFace(id_type face, const id_type* edges, size_t count);
+	void AddEdge(id_type edge, id_type start, id_type end);
+	// merges the faces and edges added since the last Build.
+	void Build();
+
+	// the targets of an id, count is 0 for an unknown one. The pointers
+	// are valid until the next Build or Load.
+	const id_type* GetFaceEdges(id_type face, size_t& count) const;
+	const id_type* GetEdgeVertices(id_type edge, size_t& count) const;
+	const id_type* GetEdgeFaces(id_type edge, size_t& count) const;
+	const id_type* GetVertexEdges(id_type vertex, size_t& count) const;
+
+	// the faces sharing an edge with face, without face itself.
+	void GetAdjacentFaces(id_type face, std::vector<id_type>& out) const;
+
+	// sorted ids, faces first: the seed faces of the hits and the faces up
+	// to rings shared edges away, with their edges and vertices.
+	struct Neighborhood
+	{
+		std::vector<id_type> faces;
+		std::vector<id_type> edges;
+		std::vector<id_type> vertices;
+	};
+	// A face hit seeds itself, an edge hit the faces it bounds and a vertex
+	// hit the faces of its edges. Edges and vertices hit are kept even if
+	// they bound no face.
+	void Expand(const id_type* hits, size_t count, uint32_t rings, Neighborhood& out) const;
+	// IntersectsWithQuery on the tree, then Expand of the results.
+	void IntersectsWithQuery(RTree& tree, const IShape& query, uint32_t rings, Neighborhood& out) const;
+
+	// the relations are stored as one entry of the tree's storage manager,
+	// registered as meta page key. Storing again overwrites the entry.
+	void Store(RTree& tree, const std::string& key) const;
+	// throws IllegalArgumentException if the key is unknown or its page is
+	// not a stored topology.
+	void Load(RTree& tree, const std::string& key);
+
+private:
+	class Relation
+	{
+	public:
+		const id_type* Find(id_type key, size_t& count) const;
+
+		// rebuilds from (key, target) pairs, the targets of a key keep their
+		// order. With unique set, repeated pairs are dropped.
+		void Assign(std::vector<std::pair<id_type, id_type>>& pairs, bool unique);
+		void AppendPairs(std::vector<std::pair<id_type, id_type>>& out) const;
+		// (target, key) pairs.
+		void AppendInverse(std::vector<std::pair<id_type, id_type>>& out) const;
+
+		size_t GetByteArraySize() const;
+		uint8_t* Store(uint8_t* ptr) const;
+		// nullptr if the data ends before the relation does.
+		const uint8_t* Load(const uint8_t* ptr, const uint8_t* end);
+
+	private:
+		// the targets of keys[i] are targets[offsets[i], offsets[i + 1]).
+		std::vector<id_type> m_keys;
+		std::vector<uint32_t> m_offsets;
+		std::vector<id_type> m_targets;
+		// the keys are m_keys[0], m_keys[0] + 1, ...
+		bool m_dense = false;
+
+	}; // Relation
+
+private:
+	Relation m_face_edges;
+	Relation m_edge_vertices;
+	Relation m_edge_faces;
+	Relation m_vertex_edges;
+
+	// added since the last Build.
+	std::vector<std::pair<id_type, id_type>> m_new_face_edges;
+	std::vector<std::pair<id_type, id_type>> m_new_edge_vertices;
+
+}; // TopologyStore
+
+}
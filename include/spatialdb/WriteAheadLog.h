@@ -0,0 +1,56 @@
+#pragma once
+
+#include "spatialdb/PageTable.h"
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace spatialdb
+{
+
+// Redo log of the stores and deletes of a DiskStorageManager. Records are
+// buffered in memory and Commit closes a group of them; the buffer is
+// written and synced once enough bytes are pending, so many commits share
+// one fsync. Replay applies the groups that reached their commit record.
+class WriteAheadLog
+{
+public:
+	using StoreCallback = std::function<void(id_type id, const PageTable::Entry& e, const uint8_t* data)>;
+	using DeleteCallback = std::function<void(id_type id)>;
+
+	WriteAheadLog(const std::string& filename, bool overwrite);
+
+	// returns the number of committed groups that were applied.
+	size_t Replay(const StoreCallback& store, const DeleteCallback& del) const;
+
+	void AppendStore(id_type id, const PageTable::Entry& e, const uint8_t* data);
+	void AppendDelete(id_type id);
+
+	// closes the current group. Returns true if the log was synced, i.e.
+	// group_commit_bytes or more were pending (0 syncs every commit).
+	bool Commit(size_t group_commit_bytes);
+	// writes and syncs the committed groups.
+	void Sync();
+	// drops the log once its changes reached the data and index files.
+	void Truncate();
+
+	// bytes written to the file since the last truncate.
+	uint64_t GetSize() const { return m_size; }
+	bool HasUncommitted() const { return m_buffer.size() > m_committed; }
+
+private:
+	std::string m_filename;
+	std::fstream m_file;
+
+	uint64_t m_size = 0;
+	uint64_t m_commits = 0;
+
+	std::vector<uint8_t> m_buffer;
+	// end of the last commit record in m_buffer.
+	size_t m_committed = 0;
+
+}; // WriteAheadLog
+
+}
@@ -1,12 +1,46 @@
 #pragma once
 
+#include <cmath>
 #include <cstdint>
+#include <limits>
+
+// the dimension and coordinate type of the index are chosen at build time,
+// see SPATIALDB_DIMENSION and SPATIALDB_FLOAT_COORDS in CMakeLists.txt.
+#ifndef SPATIALDB_DIMENSION
+#define SPATIALDB_DIMENSION 3
+#endif
 
 namespace spatialdb
 {
 
-static const int DIMENSION = 3;
+static const int DIMENSION = SPATIALDB_DIMENSION;
+static_assert(DIMENSION == 2 || DIMENSION == 3, "spatialdb indexes 2D or 3D data.");
 
 using id_type = int64_t;
 
+// the type of the MBR coordinates stored in the node pages. Shapes and
+// queries keep double coordinates, with float the MBRs entering the tree
+// are widened to the nearest floats around them.
+#ifdef SPATIALDB_FLOAT_COORDS
+using coord_type = float;
+#else
+using coord_type = double;
+#endif
+
+// the nearest T at or below x.
+template <class T = coord_type>
+inline T RoundDown(double x)
+{
+	const T c = static_cast<T>(x);
+	return c > x ? std::nextafter(c, -std::numeric_limits<T>::infinity()) : c;
+}
+
+// the nearest T at or above x.
+template <class T = coord_type>
+inline T RoundUp(double x)
+{
+	const T c = static_cast<T>(x);
+	return c < x ? std::nextafter(c, std::numeric_limits<T>::infinity()) : c;
+}
+
 }
@@ -0,0 +1,361 @@
+#include "spatialdb/BulkLoader.h"
+#include "spatialdb/RTree.h"
+#include "spatialdb/Node.h"
+#include "spatialdb/Index.h"
+#include "spatialdb/Leaf.h"
+#include "spatialdb/Exception.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+const uint32_t HILBERT_BITS = 64 / spatialdb::DIMENSION < 31 ? 64 / spatialdb::DIMENSION : 31;
+
+// Skilling, "Programming the Hilbert curve" (2004): transpose the axes
+// into Hilbert order and interleave the bits into a single key.
+uint64_t HilbertKey(uint32_t* x)
+{
+	const uint32_t n = spatialdb::DIMENSION;
+	const uint32_t m = 1u << (HILBERT_BITS - 1);
+
+	for (uint32_t q = m; q > 1; q >>= 1)
+	{
+		const uint32_t p = q - 1;
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			if (x[i] & q)
+			{
+				x[0] ^= p;
+			}
+			else
+			{
+				uint32_t t = (x[0] ^ x[i]) & p;
+				x[0] ^= t;
+				x[i] ^= t;
+			}
+		}
+	}
+
+	// gray encode.
+	for (uint32_t i = 1; i < n; ++i) {
+		x[i] ^= x[i - 1];
+	}
+	uint32_t t = 0;
+	for (uint32_t q = m; q > 1; q >>= 1) {
+		if (x[n - 1] & q) {
+			t ^= q - 1;
+		}
+	}
+	for (uint32_t i = 0; i < n; ++i) {
+		x[i] ^= t;
+	}
+
+	uint64_t key = 0;
+	for (int b = HILBERT_BITS - 1; b >= 0; --b) {
+		for (uint32_t i = 0; i < n; ++i) {
+			key = (key << 1) | ((x[i] >> b) & 1);
+		}
+	}
+	return key;
+}
+
+}
+
+namespace spatialdb
+{
+
+BulkLoader::BulkLoader(RTree& tree, BulkLoadMethod method)
+	: m_tree(tree)
+	, m_method(method)
+{
+}
+
+void BulkLoader::Load(IDataStream& stream)
+{
+	std::vector<Item> items;
+
+	try
+	{
+		while (stream.HasNext())
+		{
+			IData* d = stream.GetNext();
+			if (d == nullptr) {
+				throw IllegalArgumentException("BulkLoader: the stream returned a null entry.");
+			}
+
+			Item item;
+
+			IShape* s;
+			d->GetShape(&s);
+			s->GetMBR(item.mbr);
+			item.mbr.RoundOutward();
+			delete s;
+
+			// the buffer returned by GetData is handed over to the leaves as is.
+			item.id = d->GetIdentifier();
+			d->GetData(item.data_len, &item.data);
+			if (item.data_len == 0) {
+				item.data = nullptr;
+			}
+			item.key = 0;
+
+			delete d;
+
+			items.push_back(item);
+		}
+
+		Build(items);
+	}
+	catch (...)
+	{
+		for (auto& item : items) {
+			delete[] item.data;
+		}
+		throw;
+	}
+}
+
+void BulkLoader::Load(const BulkLoadEntry* entries, size_t count)
+{
+	std::vector<Item> items;
+	items.reserve(count);
+
+	try
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			Item item;
+			item.mbr = entries[i].mbr;
+			item.mbr.RoundOutward();
+			item.id = entries[i].id;
+			item.data_len = entries[i].data_len;
+			item.data = nullptr;
+			item.key = 0;
+
+			if (item.data_len > 0)
+			{
+				item.data = new uint8_t[item.data_len];
+				memcpy(item.data, entries[i].data, item.data_len);
+			}
+
+			items.push_back(item);
+		}
+
+		Build(items);
+	}
+	catch (...)
+	{
+		for (auto& item : items) {
+			delete[] item.data;
+		}
+		throw;
+	}
+}
+
+void BulkLoader::Build(std::vector<Item>& items)
+{
+	if (m_tree.m_stats.data != 0) {
+		throw IllegalStateException("BulkLoader: the tree is not empty.");
+	}
+
+	if (items.empty()) {
+		return;
+	}
+
+	for (const auto& item : items)
+	{
+		m_tree.CheckPayload(item.data_len);
+		m_tree.CheckMBR(item.mbr);
+	}
+
+	const uint64_t data_count = items.size();
+
+	// the empty root leaf stays in place until the packed tree is written,
+	// a failed build leaves the tree as it was.
+	std::shared_ptr<Node> root = m_tree.ReadNode(m_tree.m_root_id);
+
+	const std::vector<uint32_t> nodes_in_level = m_tree.m_stats.nodes_in_level;
+	const uint32_t tree_height = m_tree.m_stats.tree_height;
+	const uint32_t nodes = m_tree.m_stats.nodes;
+
+	std::vector<id_type> pages;
+	std::vector<Item> parents;
+
+	try
+	{
+		uint32_t level = 0;
+		while (true)
+		{
+			const uint32_t capacity = level == 0 ? m_tree.m_leaf_capacity : m_tree.m_index_capacity;
+			const uint32_t fill = static_cast<uint32_t>(std::floor(capacity * m_tree.m_fill_factor));
+			const uint32_t node_size = std::min(capacity, std::max(2u, fill));
+
+			switch (m_method)
+			{
+			case BulkLoadMethod::STR:
+				SortSTR(items, 0, items.size(), 0, node_size);
+				break;
+			case BulkLoadMethod::Hilbert:
+				SortHilbert(items);
+				break;
+			default:
+				throw NotSupportedException("BulkLoader: Bulk load method not supported.");
+			}
+
+			// level 0 still counts the old root until it is deleted.
+			if (level >= m_tree.m_stats.nodes_in_level.size()) {
+				m_tree.m_stats.nodes_in_level.push_back(0);
+			}
+
+			parents.clear();
+			parents.reserve((items.size() + node_size - 1) / node_size);
+
+			for (size_t i = 0; i < items.size(); )
+			{
+				const size_t rest = items.size() - i;
+
+				// the last two nodes share what is left, instead of the last
+				// one ending up with a handful of entries.
+				size_t len = std::min<size_t>(node_size, rest);
+				if (rest > node_size && rest < 2 * static_cast<size_t>(node_size)) {
+					len = (rest + 1) / 2;
+				}
+
+				std::shared_ptr<Node> n;
+				if (level == 0) {
+					n = std::make_shared<Leaf>(&m_tree, -1);
+				} else {
+					n = std::make_shared<Index>(&m_tree, -1, level);
+				}
+
+				for (size_t j = i; j < i + len; ++j)
+				{
+					n->InsertEntry(items[j].data_len, items[j].data, items[j].mbr, items[j].id);
+					// the node owns the buffer from now on.
+					items[j].data = nullptr;
+				}
+
+				Item parent;
+				parent.mbr = n->m_node_mbr;
+				parent.id = m_tree.WriteNode(*n);
+				pages.push_back(parent.id);
+				parent.data = n->NewEntryData(parent.data_len);
+				parent.key = 0;
+				parents.push_back(parent);
+
+				i += len;
+			}
+
+			items.swap(parents);
+			parents.clear();
+
+			if (items.size() == 1) {
+				break;
+			}
+
+			++level;
+		}
+
+		m_tree.DeleteNode(*root);
+		root.reset();
+
+		m_tree.m_root_id = items[0].id;
+		m_tree.m_stats.tree_height = level + 1;
+		// the root has no parent entry to take its count.
+		delete[] items[0].data;
+		items[0].data = nullptr;
+	}
+	catch (...)
+	{
+		for (auto& parent : parents) {
+			delete[] parent.data;
+		}
+
+		for (id_type page : pages)
+		{
+			try
+			{
+				m_tree.m_storage_mgr->DeleteByteArray(page);
+			}
+			catch (...)
+			{
+			}
+		}
+
+		m_tree.m_stats.nodes_in_level = nodes_in_level;
+		m_tree.m_stats.tree_height = tree_height;
+		m_tree.m_stats.nodes = nodes;
+		throw;
+	}
+
+	m_tree.m_stats.data = data_count;
+	m_tree.StoreHeader();
+}
+
+void BulkLoader::SortSTR(std::vector<Item>& items, size_t begin, size_t end, uint32_t dim, uint32_t node_size) const
+{
+	std::sort(items.begin() + begin, items.begin() + end, [dim](const Item& a, const Item& b) {
+		return Center(a, dim) < Center(b, dim);
+	});
+
+	if (dim + 1 == DIMENSION) {
+		return;
+	}
+
+	// cut the run into ceil(P^(1/k)) slabs, P being the number of nodes
+	// and k the number of dimensions still to be tiled.
+	const double pages = std::ceil(static_cast<double>(end - begin) / node_size);
+	const double slabs = std::ceil(std::pow(pages, 1.0 / (DIMENSION - dim)));
+	const size_t slab_size = node_size * static_cast<size_t>(std::ceil(pages / slabs));
+
+	for (size_t i = begin; i < end; i += slab_size) {
+		SortSTR(items, i, std::min(end, i + slab_size), dim + 1, node_size);
+	}
+}
+
+void BulkLoader::SortHilbert(std::vector<Item>& items) const
+{
+	double low[DIMENSION], high[DIMENSION];
+	for (int i = 0; i < DIMENSION; ++i)
+	{
+		low[i] = std::numeric_limits<double>::max();
+		high[i] = -std::numeric_limits<double>::max();
+	}
+
+	for (auto& item : items)
+	{
+		for (int i = 0; i < DIMENSION; ++i)
+		{
+			const double c = Center(item, i);
+			low[i] = std::min(low[i], c);
+			high[i] = std::max(high[i], c);
+		}
+	}
+
+	const double grid = static_cast<double>((1u << HILBERT_BITS) - 1);
+	for (auto& item : items)
+	{
+		uint32_t x[DIMENSION];
+		for (int i = 0; i < DIMENSION; ++i)
+		{
+			const double ext = high[i] - low[i];
+			x[i] = ext > 0.0 ? static_cast<uint32_t>((Center(item, i) - low[i]) / ext * grid) : 0;
+		}
+		item.key = HilbertKey(x);
+	}
+
+	std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+		return a.key < b.key;
+	});
+}
+
+double BulkLoader::Center(const Item& item, uint32_t dim)
+{
+	return (item.mbr.GetLow()[dim] + item.mbr.GetHigh()[dim]) / 2.0;
+}
+
+}
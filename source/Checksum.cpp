@@ -0,0 +1,39 @@
+#include "spatialdb/Checksum.h"
+
+namespace
+{
+
+struct Crc32Table
+{
+	uint32_t values[256];
+
+	Crc32Table()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			values[i] = c;
+		}
+	}
+};
+
+const Crc32Table CRC32_TABLE;
+
+}
+
+namespace spatialdb
+{
+
+uint32_t Checksum::Crc32(const uint8_t* data, size_t len, uint32_t crc)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < len; ++i) {
+		crc = CRC32_TABLE.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+}
@@ -0,0 +1,113 @@
+#include "spatialdb/Data.h"
+
+#include <cstring>
+
+namespace spatialdb
+{
+
+Data::Data(uint32_t len, const uint8_t* data, const Region& r, id_type id)
+	: m_id(id)
+	, m_region(r)
+	, m_data(nullptr)
+	, m_data_len(len)
+{
+	if (m_data_len > 0)
+	{
+		m_data = new uint8_t[m_data_len];
+		memcpy(m_data, data, m_data_len);
+	}
+}
+
+Data::~Data()
+{
+	delete[] m_data;
+}
+
+Data* Data::Clone()
+{
+	return new Data(m_data_len, m_data, m_region, m_id);
+}
+
+id_type Data::GetIdentifier() const
+{
+	return m_id;
+}
+
+void Data::GetShape(IShape** out) const
+{
+	*out = new Region(m_region);
+}
+
+void Data::GetData(uint32_t& len, uint8_t** data) const
+{
+	len = m_data_len;
+	*data = nullptr;
+
+	if (m_data_len > 0)
+	{
+		*data = new uint8_t[m_data_len];
+		memcpy(*data, m_data, m_data_len);
+	}
+}
+
+uint32_t Data::GetByteArraySize() const
+{
+	return
+		sizeof(id_type) +
+		sizeof(uint32_t) +
+		m_data_len +
+		m_region.GetByteArraySize();
+}
+
+void Data::LoadFromByteArray(const uint8_t* data)
+{
+	auto ptr = data;
+
+	memcpy(&m_id, ptr, sizeof(id_type));
+	ptr += sizeof(id_type);
+
+	delete[] m_data;
+	m_data = nullptr;
+
+	memcpy(&m_data_len, ptr, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+
+	if (m_data_len > 0)
+	{
+		m_data = new uint8_t[m_data_len];
+		memcpy(m_data, ptr, m_data_len);
+		ptr += m_data_len;
+	}
+
+	m_region.LoadFromByteArray(ptr);
+}
+
+void Data::StoreToByteArray(uint8_t** data, uint32_t& len) const
+{
+	// it is thread safe this way.
+	uint32_t regionsize;
+	uint8_t* regiondata = nullptr;
+	m_region.StoreToByteArray(&regiondata, regionsize);
+
+	len = sizeof(id_type) + sizeof(uint32_t) + m_data_len + regionsize;
+
+	*data = new uint8_t[len];
+	uint8_t* ptr = *data;
+
+	memcpy(ptr, &m_id, sizeof(id_type));
+	ptr += sizeof(id_type);
+	memcpy(ptr, &m_data_len, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+
+	if (m_data_len > 0)
+	{
+		memcpy(ptr, m_data, m_data_len);
+		ptr += m_data_len;
+	}
+
+	memcpy(ptr, regiondata, regionsize);
+	delete[] regiondata;
+	// ptr += regionsize;
+}
+
+}
@@ -1,16 +1,45 @@
 #include "spatialdb/DiskStorageManager.h"
 #include "spatialdb/Exception.h"
+#include "spatialdb/LogRecord.h"
 
 #include <filesystem>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include <assert.h>
 
+namespace
+{
+
+#ifndef _WIN32
+void PRead(const spatialdb::IoRead& r)
+{
+	uint32_t done = 0;
+	while (done < r.length)
+	{
+		const ssize_t ret = pread(r.fd, r.buffer + done, r.length - done, static_cast<off_t>(r.offset + done));
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			throw spatialdb::IllegalStateException("DiskStorageManager: Corrupted data file.");
+		}
+		done += static_cast<uint32_t>(ret);
+	}
+}
+#endif
+
+}
+
 namespace spatialdb
 {
 
 DiskStorageManager::DiskStorageManager(const std::string& filename, bool overwrite, uint32_t page_size)
 	: m_page_size(0)
-	, m_next_page(-1)
 	, m_buffer(nullptr)
 	, m_lru(4096)
 {
@@ -19,47 +48,71 @@ DiskStorageManager::DiskStorageManager(const std::string& filename, bool overwri
 
 DiskStorageManager::~DiskStorageManager()
 {
-	Flush();
-	m_index_file.close();
+	if (m_page_table) {
+		Flush();
+	}
 	m_data_file.close();
+#ifndef _WIN32
+	if (m_read_fd >= 0) {
+		close(m_read_fd);
+	}
+#endif
 	if (m_buffer != nullptr) {
 		delete[] m_buffer;
 	}
-
-	for (auto& v : m_page_index) {
-		delete v.second;
-	}
 }
 
 void DiskStorageManager::LoadByteArray(const id_type page, uint32_t& len, uint8_t** data)
 {
-	const CachePage* cp = m_lru.Find(page);
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	std::shared_ptr<CachePage> cp = LoadPage(lock, page);
+	lock.unlock();
+
+	len = cp->GetLength();
+	*data = new uint8_t[len];
+	assert(*data);
+	memcpy(*data, cp->GetData(), len);
+}
+
+std::shared_ptr<DiskStorageManager::CachePage> 
+DiskStorageManager::LoadPage(std::unique_lock<std::mutex>& lock, const id_type page)
+{
+	WaitForWriters(lock);
+
+	std::shared_ptr<CachePage> cp = m_lru.Find(page);
 	if (cp)
 	{
-		m_lru.Touch(const_cast<CachePage*>(cp));
+		m_lru.Touch(cp.get());
+		return cp;
+	}
 
-		len = cp->GetLength();
-		*data = new uint8_t[len];
-		assert(*data);
-		memcpy(*data, cp->GetData(), len);
+	auto pending = m_pending.find(page);
+	if (pending != m_pending.end())
+	{
+		m_lru.AddFront(pending->second);
+		return pending->second;
+	}
 
-		return;
+	auto in_flight = m_loading.find(page);
+	if (in_flight != m_loading.end()) {
+		return WaitForPage(lock, in_flight->second);
 	}
 
-	auto it = m_page_index.find(page);
-	if (it == m_page_index.end()) {
+	const PageTable::Entry* e = m_page_table->Find(page);
+	if (e == nullptr) {
 		throw InvalidPageException(page);
 	}
 
-	std::vector<id_type>& pages = (*it).second->pages;
+#ifdef _WIN32
+	const std::vector<id_type>& pages = e->pages;
 	uint32_t c_next = 0;
 	uint32_t c_total = static_cast<uint32_t>(pages.size());
 
-	len = (*it).second->length;
-	*data = new uint8_t[len];
-	assert(*data);
+	const uint32_t len = e->length;
+	cp = std::make_shared<CachePage>(page, len);
 
-	uint8_t* ptr = *data;
+	uint8_t* ptr = cp->GetBuffer();
 	uint32_t c_len = 0;
 	uint32_t c_rem = len;
 
@@ -84,208 +137,489 @@ void DiskStorageManager::LoadByteArray(const id_type page, uint32_t& len, uint8_
 	}
 	while (c_next < c_total);
 
-	m_lru.AddFront(page, len, *data);
+	m_lru.AddFront(cp);
+
+	return cp;
+#else
+	auto loading = std::make_shared<Loading>();
+	loading->page = std::make_shared<CachePage>(page, e->length);
+
+	std::vector<IoRead> reads;
+	AddReads(*e, *loading->page, reads);
+
+	m_loading.insert({ page, loading });
+	++m_reads;
+
+	// pages written through the stream may still be buffered.
+	m_data_file.flush();
+	lock.unlock();
+
+	std::exception_ptr error = nullptr;
+	try
+	{
+		for (auto& r : reads) {
+			PRead(r);
+		}
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	lock.lock();
+	FinishReads({ { page, loading } }, error);
+	if (error) {
+		std::rethrow_exception(error);
+	}
+
+	return loading->page;
+#endif
 }
 
-void DiskStorageManager::StoreByteArray(id_type& page, const uint32_t len, const uint8_t* const data)
+std::shared_ptr<DiskStorageManager::CachePage>
+DiskStorageManager::WaitForPage(std::unique_lock<std::mutex>& lock, std::shared_ptr<Loading> loading)
 {
-	if (page == NewPage)
+	m_reads_changed.wait(lock, [&loading]() { return loading->done; });
+	if (loading->error) {
+		std::rethrow_exception(loading->error);
+	}
+	return loading->page;
+}
+
+void DiskStorageManager::FinishReads(const std::vector<std::pair<id_type, std::shared_ptr<Loading>>>& loads, std::exception_ptr error)
+{
+	for (const auto& l : loads)
 	{
-		Entry* e = new Entry();
-		e->length = len;
+		l.second->done = true;
+		l.second->error = error;
+		m_loading.erase(l.first);
 
-		const uint8_t* ptr = data;
-		id_type c_page = 0;
-		uint32_t c_rem = len;
-		uint32_t c_len;
+		if (!error) {
+			m_lru.AddFront(l.second->page);
+		}
+	}
 
-		while (c_rem > 0)
-		{
-			if (!m_empty_pages.empty())
-			{
-				c_page = *m_empty_pages.begin();
-				m_empty_pages.erase(m_empty_pages.begin());
-			}
-			else
-			{
-				c_page = m_next_page;
-				++m_next_page;
-			}
+	--m_reads;
+	m_reads_changed.notify_all();
+}
 
-			c_len = (c_rem > m_page_size) ? m_page_size : c_rem;
-			memcpy(m_buffer, ptr, c_len);
+void DiskStorageManager::WaitForReads(std::unique_lock<std::mutex>& lock)
+{
+	++m_writers;
+	m_reads_changed.wait(lock, [this]() { return m_reads == 0; });
+	--m_writers;
+	m_reads_changed.notify_all();
+}
 
-			m_data_file.seekp(c_page * m_page_size, std::ios_base::beg);
-			if (m_data_file.fail()) {
-				throw IllegalStateException("DiskStorageManager: Corrupted data file.");
-			}
+void DiskStorageManager::WaitForWriters(std::unique_lock<std::mutex>& lock)
+{
+	m_reads_changed.wait(lock, [this]() { return m_writers == 0; });
+}
 
-			m_data_file.write(reinterpret_cast<const char*>(m_buffer), m_page_size);
-			if (m_data_file.fail()) {
-				throw IllegalStateException("DiskStorageManager: Corrupted data file.");
-			}
+void DiskStorageManager::AddReads(const PageTable::Entry& e, CachePage& page, std::vector<IoRead>& reads) const
+{
+	uint8_t* ptr = page.GetBuffer();
+	uint32_t c_rem = e.length;
+	for (auto c_page : e.pages)
+	{
+		const uint32_t c_len = (c_rem > m_page_size) ? m_page_size : c_rem;
+		reads.push_back({ m_read_fd, static_cast<uint64_t>(c_page) * m_page_size, ptr, c_len });
+		ptr += c_len;
+		c_rem -= c_len;
+	}
+}
 
-			ptr += c_len;
-			c_rem -= c_len;
-			e->pages.push_back(c_page);
+void DiskStorageManager::StoreByteArray(id_type& page, const uint32_t len, const uint8_t* const data)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	WaitForReads(lock);
+
+	const PageTable::Entry* old_entry = nullptr;
+	if (page != NewPage)
+	{
+		old_entry = m_page_table->Find(page);
+		if (old_entry == nullptr) {
+			throw InvalidPageException(page);
 		}
+	}
+
+	PageTable::Entry e;
+	e.length = len;
+
+	uint32_t c_rem = len;
+	uint32_t c_next = 0;
 
-		page = e->pages[0];
-		m_page_index.insert(std::pair<id_type, Entry*>(page, e));
+	while (c_rem > 0)
+	{
+		// an update overwrites the pages of the old entry first.
+		if (old_entry && c_next < old_entry->pages.size())
+		{
+			e.pages.push_back(old_entry->pages[c_next]);
+			++c_next;
+		}
+		else
+		{
+			e.pages.push_back(m_page_table->AllocatePage());
+		}
 
-		m_lru.AddFront(page, len, data);
+		c_rem -= (c_rem > m_page_size) ? m_page_size : c_rem;
+	}
+
+	if (old_entry)
+	{
+		while (c_next < old_entry->pages.size())
+		{
+			m_page_table->FreePage(old_entry->pages[c_next]);
+			++c_next;
+		}
 	}
 	else
 	{
-		auto it = m_page_index.find(page);
-		if (it == m_page_index.end()) {
-			throw InvalidPageException(page);
+		page = e.pages[0];
+	}
+
+	std::shared_ptr<CachePage> cp = std::make_shared<CachePage>(page, len, data);
+
+	// with a log the data file is only written once the record is durable.
+	if (m_wal)
+	{
+		m_wal->AppendStore(page, e, data);
+		m_pending[page] = cp;
+	}
+	else
+	{
+		WritePages(e.pages, len, data);
+	}
+
+	m_page_table->Put(page, std::move(e));
+
+	m_lru.Remove(page);
+	m_lru.AddFront(cp);
+}
+
+void DiskStorageManager::WritePages(const std::vector<id_type>& pages, uint32_t len, const uint8_t* data)
+{
+	const uint8_t* ptr = data;
+	uint32_t c_rem = len;
+
+	for (auto c_page : pages)
+	{
+		const uint32_t c_len = (c_rem > m_page_size) ? m_page_size : c_rem;
+		memcpy(m_buffer, ptr, c_len);
+
+		m_data_file.seekp(c_page * m_page_size, std::ios_base::beg);
+		if (m_data_file.fail()) {
+			throw IllegalStateException("DiskStorageManager: Corrupted data file.");
 		}
 
-		Entry* old_entry = (*it).second;
+		m_data_file.write(reinterpret_cast<const char*>(m_buffer), m_page_size);
+		if (m_data_file.fail()) {
+			throw IllegalStateException("DiskStorageManager: Corrupted data file.");
+		}
+
+		ptr += c_len;
+		c_rem -= c_len;
+	}
+}
+
+void DiskStorageManager::DeleteByteArray(const id_type page)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	WaitForReads(lock);
+
+	const PageTable::Entry* e = m_page_table->Find(page);
+	if (e == nullptr) {
+		throw InvalidPageException(page);
+	}
+
+	m_lru.Remove(page);
+
+	for (auto c_page : e->pages) {
+		m_page_table->FreePage(c_page);
+	}
+
+	m_page_table->Erase(page);
+
+	if (m_wal)
+	{
+		m_wal->AppendDelete(page);
+		m_pending.erase(page);
+	}
+}
+
+bool DiskStorageManager::LoadByteArrayView(const id_type page, uint32_t& len, const uint8_t** data, std::shared_ptr<const void>& owner)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	std::shared_ptr<CachePage> cp = LoadPage(lock, page);
 
-		m_page_index.erase(it);
+	len = cp->GetLength();
+	*data = cp->GetData();
+	owner = cp;
 
-		Entry* e = new Entry();
-		e->length = len;
+	return true;
+}
+
+void DiskStorageManager::LoadByteArrays(const std::vector<id_type>& ids, const LoadCallback& done)
+{
+#ifdef _WIN32
+	IStorageManager::LoadByteArrays(ids, done);
+#else
+	std::vector<std::shared_ptr<CachePage>> pages(ids.size());
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	WaitForWriters(lock);
 
-		const uint8_t* ptr = data;
-		id_type c_page = 0;
-		uint32_t c_rem = len;
-		uint32_t c_len, c_next = 0;
+	std::vector<IoRead> reads;
+	std::vector<std::pair<id_type, std::shared_ptr<Loading>>> loads;
+	// requests of pages read in flight, by this batch or another call.
+	std::vector<std::pair<size_t, std::shared_ptr<Loading>>> waits;
 
-		while (c_rem > 0)
+	++m_reads;
+	try
+	{
+		for (size_t i = 0; i < ids.size(); ++i)
 		{
-			if (c_next < old_entry->pages.size())
+			std::shared_ptr<CachePage> cp = m_lru.Find(ids[i]);
+			if (cp)
 			{
-				c_page = old_entry->pages[c_next];
-				++c_next;
+				m_lru.Touch(cp.get());
+				pages[i] = cp;
+				continue;
 			}
-			else if (! m_empty_pages.empty())
+
+			auto pending = m_pending.find(ids[i]);
+			if (pending != m_pending.end())
 			{
-				c_page = *m_empty_pages.begin();
-				m_empty_pages.erase(m_empty_pages.begin());
+				m_lru.AddFront(pending->second);
+				pages[i] = pending->second;
+				continue;
 			}
-			else
+
+			auto in_flight = m_loading.find(ids[i]);
+			if (in_flight != m_loading.end())
 			{
-				c_page = m_next_page;
-				++m_next_page;
+				waits.push_back({ i, in_flight->second });
+				continue;
 			}
 
-			c_len = (c_rem > m_page_size) ? m_page_size : c_rem;
-			memcpy(m_buffer, ptr, c_len);
-
-			m_data_file.seekp(c_page * m_page_size, std::ios_base::beg);
-			if (m_data_file.fail()) {
-				throw IllegalStateException("DiskStorageManager: Corrupted data file.");
+			const PageTable::Entry* entry = m_page_table->Find(ids[i]);
+			if (entry == nullptr) {
+				throw InvalidPageException(ids[i]);
 			}
 
-			m_data_file.write(reinterpret_cast<const char*>(m_buffer), m_page_size);
-			if (m_data_file.fail()) {
-				throw IllegalStateException("DiskStorageManager: Corrupted data file.");
-			}
+			auto loading = std::make_shared<Loading>();
+			loading->page = std::make_shared<CachePage>(ids[i], entry->length);
+			AddReads(*entry, *loading->page, reads);
 
-			ptr += c_len;
-			c_rem -= c_len;
-			e->pages.push_back(c_page);
+			m_loading.insert({ ids[i], loading });
+			loads.push_back({ ids[i], loading });
+			pages[i] = loading->page;
 		}
+	}
+	catch (...)
+	{
+		FinishReads(loads, std::current_exception());
+		throw;
+	}
 
-		while (c_next < old_entry->pages.size())
+	std::exception_ptr error = nullptr;
+	if (!reads.empty())
+	{
+		// pages written through the stream may still be buffered.
+		m_data_file.flush();
+		lock.unlock();
+
+		try
 		{
-			m_empty_pages.insert(old_entry->pages[c_next]);
-			++c_next;
+			std::lock_guard<std::mutex> batch_lock(m_batch_lock);
+			ReadPages(reads);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
 		}
 
-		m_page_index.insert(std::pair<id_type, Entry*>(page, e));
-		delete old_entry;
+		lock.lock();
+	}
 
-		m_lru.Modify(page, len, data);
-	}	
+	FinishReads(loads, error);
+	if (error) {
+		std::rethrow_exception(error);
+	}
+
+	for (auto& w : waits) {
+		pages[w.first] = WaitForPage(lock, w.second);
+	}
+	lock.unlock();
+
+	for (size_t i = 0; i < ids.size(); ++i) {
+		done(i, pages[i]->GetLength(), pages[i]->GetData(), pages[i]);
+	}
+#endif
 }
 
-void DiskStorageManager::DeleteByteArray(const id_type page)
+void DiskStorageManager::SetBatchReadMode(BatchReadMode mode, size_t threads)
 {
-	auto it = m_page_index.find(page);
-	if (it == m_page_index.end()) {
-		throw InvalidPageException(page);
+	std::unique_lock<std::mutex> lock(m_lock);
+	WaitForReads(lock);
+
+	m_batch_mode = mode;
+	if (m_batch_threads != threads)
+	{
+		m_batch_threads = threads;
+		m_pool.reset();
 	}
+}
 
-	m_lru.Remove(page);
+void DiskStorageManager::ReadPages(std::vector<IoRead>& reads)
+{
+#ifndef _WIN32
+	if (m_batch_mode == BatchReadMode::Auto || m_batch_mode == BatchReadMode::IoUring)
+	{
+		if (!m_ring) {
+			m_ring = std::make_unique<IoUring>();
+		}
 
-	for (uint32_t i = 0; i < (*it).second->pages.size(); ++i) {
-		m_empty_pages.insert((*it).second->pages[i]);
+		if (m_ring->IsValid())
+		{
+			if (m_ring->Read(reads.data(), reads.size())) {
+				return;
+			}
+			if (m_ring->IsValid()) {
+				throw IllegalStateException("DiskStorageManager: Corrupted data file.");
+			}
+		}
+	}
+
+	if (m_batch_mode == BatchReadMode::Sequential)
+	{
+		for (auto& r : reads) {
+			PRead(r);
+		}
+		return;
 	}
 
-	delete (*it).second;
-	m_page_index.erase(it);
+	if (!m_pool) {
+		m_pool = std::make_unique<ThreadPool>(m_batch_threads);
+	}
+	m_pool->Run(reads.size(), [&reads](size_t i) {
+		PRead(reads[i]);
+	});
+#endif
 }
 
 void DiskStorageManager::Flush()
 {
-	m_index_file.seekp(0, std::ios_base::beg);
-	if (m_index_file.fail()) {
-		throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
+	std::unique_lock<std::mutex> lock(m_lock);
+	WaitForReads(lock);
+
+	if (m_wal)
+	{
+		m_wal->Commit(0);
+		ApplyPending();
+		Checkpoint();
+		return;
 	}
 
-	m_index_file.write(reinterpret_cast<const char*>(&m_page_size), sizeof(uint32_t));
-	if (m_index_file.fail()) {
-		throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
+	m_page_table->Flush();
+	m_data_file.flush();
+}
+
+uint32_t DiskStorageManager::GetPageSize() const
+{
+	return m_page_size;
+}
+
+bool DiskStorageManager::HasWriteAheadLog() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	return m_wal != nullptr;
+}
+
+void DiskStorageManager::Commit()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	if (!m_wal) {
+		return;
 	}
+	WaitForReads(lock);
 
-	m_index_file.write(reinterpret_cast<const char*>(&m_next_page), sizeof(id_type));
-	if (m_index_file.fail()) {
-		throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
+	if (m_wal->Commit(m_group_commit_bytes)) {
+		ApplyPending();
 	}
+	if (m_wal->GetSize() >= m_checkpoint_bytes) {
+		Checkpoint();
+	}
+}
+
+void DiskStorageManager::EnableWriteAheadLog(size_t group_commit_bytes, uint64_t checkpoint_bytes)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	WaitForReads(lock);
 
-	uint32_t count = static_cast<uint32_t>(m_empty_pages.size());
-	m_index_file.write(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
-	if (m_index_file.fail()) {
-		throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
+	m_group_commit_bytes = group_commit_bytes;
+	m_checkpoint_bytes = checkpoint_bytes;
+
+	if (m_wal) {
+		return;
 	}
 
-	for (auto page : m_empty_pages)
+	// the log is replayed on top of durable data and index files.
+	m_data_file.flush();
+	LogWriter::SyncFile(m_data_filename);
+	m_page_table->Flush(true);
+
+	m_wal = std::make_unique<WriteAheadLog>(m_wal_filename, true);
+}
+
+void DiskStorageManager::ApplyPending()
+{
+	for (auto& pair : m_pending)
 	{
-		m_index_file.write(reinterpret_cast<const char*>(&page), sizeof(id_type));
-		if (m_index_file.fail()) {
-			throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
-		}
+		const PageTable::Entry* e = m_page_table->Find(pair.first);
+		assert(e);
+		WritePages(e->pages, pair.second->GetLength(), pair.second->GetData());
 	}
+	m_pending.clear();
+}
 
-	count = static_cast<uint32_t>(m_page_index.size());
-	m_index_file.write(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
-	if (m_index_file.fail()) {
-		throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
-	}
+void DiskStorageManager::Checkpoint()
+{
+	// only synced groups were applied, whatever is still pending stays in the log.
+	m_data_file.flush();
+	LogWriter::SyncFile(m_data_filename);
+	m_page_table->Flush(true);
 
-	for (auto& pair : m_page_index)
-	{
-		m_index_file.write(reinterpret_cast<const char*>(&(pair.first)), sizeof(id_type));
-		if (m_index_file.fail()) {
-			throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
-		}
+	if (m_pending.empty()) {
+		m_wal->Truncate();
+	}
+}
 
-		m_index_file.write(reinterpret_cast<const char*>(&(pair.second->length)), sizeof(uint32_t));
-		if (m_index_file.fail()) {
-			throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
+void DiskStorageManager::Recover()
+{
+	WriteAheadLog wal(m_wal_filename, false);
+
+	const size_t groups = wal.Replay(
+		[this](id_type id, const PageTable::Entry& e, const uint8_t* data) {
+			WritePages(e.pages, e.length, data);
+			m_page_table->Put(id, PageTable::Entry(e));
+		},
+		[this](id_type id) {
+			m_page_table->Erase(id);
 		}
+	);
 
-		count = static_cast<uint32_t>(pair.second->pages.size());
-		m_index_file.write(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
-		if (m_index_file.fail()) {
-			throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
-		}
+	if (groups > 0)
+	{
+		m_page_table->RebuildEmptyPages();
 
-		for (auto page : pair.second->pages)
-		{
-			m_index_file.write(reinterpret_cast<const char*>(&page), sizeof(id_type));
-			if (m_index_file.fail()) {
-				throw IllegalStateException("DiskStorageManager: Corrupted storage manager index file.");
-			}
-		}
+		m_data_file.flush();
+		LogWriter::SyncFile(m_data_filename);
+		m_page_table->Flush(true);
 	}
-
-	m_index_file.flush();
-	m_data_file.flush();
 }
 
 bool DiskStorageManager::Initialize(const std::string& filename, bool overwrite, uint32_t page_size)
@@ -293,6 +627,9 @@ bool DiskStorageManager::Initialize(const std::string& filename, bool overwrite,
 	const std::string index_file = filename + ".idx";
 	const std::string data_file = filename + ".dat";
 
+	m_data_filename = data_file;
+	m_wal_filename = filename + ".wal";
+
 	std::ios_base::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
 	const bool files_exists = std::filesystem::exists(index_file) && 
 		std::filesystem::exists(data_file);
@@ -300,92 +637,32 @@ bool DiskStorageManager::Initialize(const std::string& filename, bool overwrite,
 		mode |= std::ios::trunc;
 	}
 
-	m_index_file.open(index_file.c_str(), mode);
 	m_data_file.open(data_file.c_str(), mode);
-	if (m_index_file.fail() || m_data_file.fail()) {
+	if (m_data_file.fail()) {
 		return false;
 	}
 
-	m_index_file.seekg(0, m_index_file.end);
-	std::streamoff length = m_index_file.tellg();
-	m_index_file.seekg(0, m_index_file.beg);
-
-	if (overwrite || length == 0 || !files_exists)
-	{
-		m_page_size = page_size;
-		m_next_page = 0;
+#ifndef _WIN32
+	m_read_fd = open(data_file.c_str(), O_RDONLY);
+	if (m_read_fd < 0) {
+		return false;
 	}
-	else
-	{
-		m_index_file.read(reinterpret_cast<char*>(&m_page_size), sizeof(uint32_t));
-		if (m_index_file.fail()) {
-			return false;
-		}
+#endif
 
-		m_index_file.read(reinterpret_cast<char*>(&m_next_page), sizeof(id_type));
-		if (m_index_file.fail()) {
-			return false;
-		}
-	}
+	m_page_table = std::make_unique<PageTable>(index_file, overwrite || !files_exists, page_size);
+	m_page_size = m_page_table->GetPageSize();
 
 	m_buffer = new uint8_t[m_page_size];
 	assert(m_buffer);
 	memset(m_buffer, 0, m_page_size);
 
-	if (!overwrite && length > 0)
+	// a log left behind by a crash is replayed, a stale one must not be.
+	if (std::filesystem::exists(m_wal_filename))
 	{
-		uint32_t count;
-		id_type page, id;
-
-		m_index_file.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
-		if (m_index_file.fail()) {
-			return false;
-		}
-
-		for (uint32_t i = 0; i < count; ++i)
-		{
-			m_index_file.read(reinterpret_cast<char*>(&page), sizeof(id_type));
-			if (m_index_file.fail()) {
-				return false;
-			}
-			m_empty_pages.insert(page);
-		}
-
-		m_index_file.read(reinterpret_cast<char*>(&count), sizeof(uint32_t));
-		if (m_index_file.fail()) {
-			return false;
-		}
-
-		for (uint32_t i = 0; i < count; ++i)
-		{
-			Entry* e = new Entry();
-
-			m_index_file.read(reinterpret_cast<char*>(&id), sizeof(id_type));
-			if (m_index_file.fail()) {
-				return false;
-			}
-
-			m_index_file.read(reinterpret_cast<char*>(&(e->length)), sizeof(uint32_t));
-			if (m_index_file.fail()) {
-				return false;
-			}
-
-			uint32_t count2;
-			m_index_file.read(reinterpret_cast<char*>(&count2), sizeof(uint32_t));
-			if (m_index_file.fail()) {
-				return false;
-			}
-
-			for (uint32_t j = 0; j < count2; ++j)
-			{
-				m_index_file.read(reinterpret_cast<char*>(&page), sizeof(id_type));
-				if (m_index_file.fail()) {
-					return false;
-				}
-				e->pages.push_back(page);
-			}
-			m_page_index.insert(std::pair<id_type, Entry*>(id, e));
+		if (!overwrite && files_exists) {
+			Recover();
 		}
+		std::filesystem::remove(m_wal_filename);
 	}
 
 	return true;
@@ -395,21 +672,14 @@ bool DiskStorageManager::Initialize(const std::string& filename, bool overwrite,
 // class DiskStorageManager::LRUCollection
 //
 
-DiskStorageManager::LRUCollection::~LRUCollection()
-{
-	for (auto itr : m_map) {
-		delete itr.second;
-	}
-}
-
-bool DiskStorageManager::LRUCollection::AddFront(id_type id, uint32_t len, const uint8_t* data)
+bool DiskStorageManager::LRUCollection::AddFront(const std::shared_ptr<CachePage>& page)
 {
 	while (m_map.size() >= m_capacity) {
 		RemoveBack();
 	}
 
-	CachePage* front = new CachePage(id, len, data);
-	m_map.insert({ id, front });
+	CachePage* front = page.get();
+	m_map.insert({ front->m_id, page });
 
 	front->m_prev = nullptr;
 	front->m_next = m_list_begin;
@@ -437,8 +707,6 @@ bool DiskStorageManager::LRUCollection::RemoveBack()
 	assert(m_list_end);
 	CachePage* back = m_list_end;
 
-	m_map.erase(back->m_id);
-
 	if (m_list_begin == m_list_end)
 	{
 		m_list_begin = nullptr;
@@ -453,7 +721,8 @@ bool DiskStorageManager::LRUCollection::RemoveBack()
 		m_list_end->m_next = nullptr;
 	}
 
-	delete back;
+	// may release the page.
+	m_map.erase(back->m_id);
 
 	return true;
 }
@@ -465,9 +734,7 @@ bool DiskStorageManager::LRUCollection::Remove(id_type id)
 		return false;
 	}
 
-	auto page = itr->second;
-
-	m_map.erase(itr);
+	auto page = itr->second.get();
 
 	if (m_list_begin == m_list_end)
 	{
@@ -491,32 +758,13 @@ bool DiskStorageManager::LRUCollection::Remove(id_type id)
 		}
 	}
 
-	delete page;
-
-	return true;
-}
-
-bool DiskStorageManager::LRUCollection::Modify(id_type id, uint32_t len, const uint8_t* data)
-{
-	auto itr = m_map.find(id);
-	if (itr == m_map.end()) {
-		return false;
-	}
-
-	auto page = itr->second;
-
-	page->m_len = len;
-	delete[] page->m_data;
-	page->m_data = new uint8_t[len];
-	assert(page->m_data);
-	memcpy(page->m_data, data, len);
-
-	Touch(page);
+	// may release the page.
+	m_map.erase(itr);
 
 	return true;
 }
 
-const DiskStorageManager::CachePage* 
+std::shared_ptr<DiskStorageManager::CachePage> 
 DiskStorageManager::LRUCollection::Find(id_type id) const
 {
 	auto itr = m_map.find(id);
@@ -1,6 +1,7 @@
 #include "spatialdb/Edge.h"
 #include "spatialdb/Point.h"
 #include "spatialdb/Region.h"
+#include "spatialdb/Face.h"
 #include "spatialdb/ShapeType.h"
 #include "spatialdb/Math.h"
 
@@ -107,6 +108,12 @@ bool Edge::IntersectsShape(const IShape& s) const
 		ret = IntersectsEdge(e);
 	}
 		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.IntersectsEdge(*this);
+	}
+		break;
 	case ST_REGION:
 	{
 		const Region& r = static_cast<const Region&>(s);
@@ -120,12 +127,88 @@ bool Edge::IntersectsShape(const IShape& s) const
 
 bool Edge::ContainsShape(const IShape& s) const
 {
-	return false;
+	bool ret = false;
+
+	// the edge contains a shape if it contains its corners.
+	switch (s.ShapeType())
+	{
+	case ST_POINT:
+	{
+		const Point& p = static_cast<const Point&>(s);
+		ret = ContainsPoint(p);
+	}
+		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = ContainsPoint(Point(e.m_start)) && ContainsPoint(Point(e.m_end));
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.GetVertexCount() > 0;
+		for (size_t i = 0; i < f.GetVertexCount() && ret; ++i) {
+			ret = ContainsPoint(Point(f.GetVertices() + i * DIMENSION));
+		}
+	}
+		break;
+	case ST_REGION:
+	{
+		const Region& r = static_cast<const Region&>(s);
+		ret = true;
+		for (int k = 0; k < (1 << DIMENSION) && ret; ++k)
+		{
+			double corner[DIMENSION];
+			for (int i = 0; i < DIMENSION; ++i) {
+				corner[i] = (k & (1 << i)) ? r.GetHigh()[i] : r.GetLow()[i];
+			}
+			ret = ContainsPoint(Point(corner));
+		}
+	}
+		break;
+	}
+
+	return ret;
 }
 
 bool Edge::TouchesShape(const IShape& s) const
 {
-	return false;
+	bool ret = false;
+
+	// the shapes meet, but do not cross into each other. A point on the
+	// edge touches it.
+	switch (s.ShapeType())
+	{
+	case ST_POINT:
+	{
+		const Point& p = static_cast<const Point&>(s);
+		ret = ContainsPoint(p);
+	}
+		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		const Math::Lifted p1(m_start), q1(m_end), p2(e.m_start), q2(e.m_end);
+		ret = Math::SegmentsTouch(p1, q1, p2, q2);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.TouchesShape(*this);
+	}
+		break;
+	case ST_REGION:
+	{
+		const Region& r = static_cast<const Region&>(s);
+		const Math::Lifted p(m_start), q(m_end), low(r.GetLow(), 1, -1.0), high(r.GetHigh(), 1, 1.0);
+		ret = IntersectsRegion(r) && !Math::SegmentIntersectsBox(p, q, low, high, true);
+	}
+		break;
+	}
+
+	return ret;
 }
 
 void Edge::GetCenter(Point& p) const
@@ -166,6 +249,24 @@ double Edge::GetMinimumDistance(const IShape& s) const
 		ret = GetMinimumDistance(p);
 	}
 		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = GetMinimumDistance(e);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.GetMinimumDistance(*this);
+	}
+		break;
+	case ST_REGION:
+	{
+		const Region& r = static_cast<const Region&>(s);
+		ret = GetMinimumDistance(r);
+	}
+		break;
 	}
 
 	return ret;
@@ -173,7 +274,8 @@ double Edge::GetMinimumDistance(const IShape& s) const
 
 bool Edge::IntersectsEdge(const Edge& e) const
 {
-	return Math::Intersects(Point(m_start), Point(m_end), Point(e.m_start), Point(e.m_end));
+	const Math::Lifted p1(m_start), q1(m_end), p2(e.m_start), q2(e.m_end);
+	return Math::SegmentsIntersect(p1, q1, p2, q2);
 }
 
 bool Edge::IntersectsRegion(const Region& r) const
@@ -181,28 +283,31 @@ bool Edge::IntersectsRegion(const Region& r) const
 	return r.IntersectsEdge(*this);
 }
 
+bool Edge::ContainsPoint(const Point& p) const
+{
+	const Math::Lifted c(p.GetCoords()), a(m_start), b(m_end);
+	return Math::PointOnSegment(c, a, b);
+}
+
 double Edge::GetMinimumDistance(const Point& p) const
 {
-	auto p_coords = p.GetCoords();
+	const Math::Lifted c(p.GetCoords()), a(m_start), b(m_end);
+	return std::sqrt(Math::PointSegmentDistanceSq(c, a, b));
+}
 
-	if (m_end[0] >= m_start[0] - std::numeric_limits<double>::epsilon() &&
-		m_end[0] <= m_start[0] + std::numeric_limits<double>::epsilon()) {
-		return std::abs(p_coords[0] - m_start[0]);
-	}
+double Edge::GetMinimumDistance(const Region& r) const
+{
+	const Math::Lifted p(m_start), q(m_end), low(r.GetLow(), 1, -1.0), high(r.GetHigh(), 1, 1.0);
+	return std::sqrt(Math::SegmentBoxDistanceSq(p, q, low, high));
+}
 
-	if (m_end[1] >= m_start[1] - std::numeric_limits<double>::epsilon() &&
-		m_end[1] <= m_start[1] + std::numeric_limits<double>::epsilon()) {
-		return std::abs(p_coords[1] - m_start[1]);
+double Edge::GetMinimumDistance(const Edge& e) const
+{
+	if (IntersectsEdge(e)) {
+		return 0.0;
 	}
-
-	double x1 = m_start[0];
-	double x2 = m_end[0];
-	double x0 = p_coords[0];
-	double y1 = m_start[1];
-	double y2 = m_end[1];
-	double y0 = p_coords[1];
-
-	return std::abs((x2 - x1) * (y1 - y0) - (x1 - x0) * (y2 - y1)) / (std::sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1)));
+	const Math::Lifted p1(m_start), q1(m_end), p2(e.m_start), q2(e.m_end);
+	return std::sqrt(Math::SegmentsDistanceSq(p1, q1, p2, q2));
 }
 
 void Edge::Initialize(const double* start, const double* end)
@@ -0,0 +1,315 @@
+#include "spatialdb/EdgeFilter.h"
+#include "spatialdb/MBRFilter.h"
+#include "spatialdb/Math.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SPATIALDB_SSE2
+#endif
+
+#include <assert.h>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+using namespace spatialdb;
+
+inline double Clamp(double x, double low, double high)
+{
+	return x < low ? low : (x > high ? high : x);
+}
+
+// Edges whose bounding box meets [low, high], and with Slab set, that
+// meet the box themselves: the part [t0, t1] of the edge within the slabs
+// of the box is not empty. An edge parallel to a slab is within it
+// everywhere or nowhere.
+template <bool Slab>
+uint64_t ScalarMask(const double* const* start, const double* const* end,
+	uint32_t begin, uint32_t stop, uint32_t shift, const double* low, const double* high)
+{
+	uint64_t mask = 0;
+	for (uint32_t i = begin; i < stop; ++i)
+	{
+		// 2D edges lie at z = 0, see Math::Lifted.
+		double s[3] = {}, e[3] = {};
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			s[d] = start[d][i];
+			e[d] = end[d][i];
+		}
+
+		bool hit = true;
+		if (Slab)
+		{
+			hit = Math::SegmentIntersectsBox(s, e, low, high);
+		}
+		else
+		{
+			for (int d = 0; d < DIMENSION && hit; ++d) {
+				hit = std::min(s[d], e[d]) <= high[d] && std::max(s[d], e[d]) >= low[d];
+			}
+		}
+		if (hit) {
+			mask |= uint64_t(1) << (i - shift);
+		}
+	}
+	return mask;
+}
+
+template <bool Slab>
+uint64_t Mask(const double* const* start, const double* const* end,
+	uint32_t begin, uint32_t count, const double* low, const double* high)
+{
+	assert(count <= EdgeFilter::BATCH);
+
+	const uint32_t stop = begin + count;
+	uint64_t mask = 0;
+	uint32_t i = begin;
+
+	// the slab quotients of a zero direction are replaced by -through and
+	// through, inf if the edge lies within the slab and -inf if not.
+#if defined(__AVX__)
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+	__m256d q_low[DIMENSION], q_high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		q_low[d] = _mm256_set1_pd(low[d]);
+		q_high[d] = _mm256_set1_pd(high[d]);
+	}
+
+	for (; i + 4 <= stop; i += 4)
+	{
+		__m256d hit = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			const __m256d s = _mm256_loadu_pd(start[d] + i);
+			const __m256d e = _mm256_loadu_pd(end[d] + i);
+			hit = _mm256_and_pd(hit, _mm256_and_pd(_mm256_cmp_pd(_mm256_min_pd(s, e), q_high[d], _CMP_LE_OQ), _mm256_cmp_pd(_mm256_max_pd(s, e), q_low[d], _CMP_GE_OQ)));
+		}
+
+		if (Slab && _mm256_movemask_pd(hit) != 0)
+		{
+			__m256d t0 = zero, t1 = _mm256_set1_pd(1.0);
+			for (int d = 0; d < DIMENSION; ++d)
+			{
+				const __m256d s = _mm256_loadu_pd(start[d] + i);
+				const __m256d dir = _mm256_sub_pd(_mm256_loadu_pd(end[d] + i), s);
+				const __m256d ta = _mm256_div_pd(_mm256_sub_pd(q_low[d], s), dir);
+				const __m256d tb = _mm256_div_pd(_mm256_sub_pd(q_high[d], s), dir);
+
+				const __m256d parallel = _mm256_cmp_pd(dir, zero, _CMP_EQ_OQ);
+				const __m256d inside = _mm256_and_pd(_mm256_cmp_pd(s, q_low[d], _CMP_GE_OQ), _mm256_cmp_pd(s, q_high[d], _CMP_LE_OQ));
+				const __m256d through = _mm256_blendv_pd(_mm256_sub_pd(zero, inf), inf, inside);
+
+				t0 = _mm256_max_pd(t0, _mm256_blendv_pd(_mm256_min_pd(ta, tb), _mm256_sub_pd(zero, through), parallel));
+				t1 = _mm256_min_pd(t1, _mm256_blendv_pd(_mm256_max_pd(ta, tb), through, parallel));
+			}
+			hit = _mm256_and_pd(hit, _mm256_cmp_pd(t0, t1, _CMP_LE_OQ));
+		}
+		mask |= uint64_t(_mm256_movemask_pd(hit)) << (i - begin);
+	}
+#elif defined(SPATIALDB_SSE2)
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+	__m128d q_low[DIMENSION], q_high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		q_low[d] = _mm_set1_pd(low[d]);
+		q_high[d] = _mm_set1_pd(high[d]);
+	}
+
+	for (; i + 2 <= stop; i += 2)
+	{
+		__m128d hit = _mm_castsi128_pd(_mm_set1_epi32(-1));
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			const __m128d s = _mm_loadu_pd(start[d] + i);
+			const __m128d e = _mm_loadu_pd(end[d] + i);
+			hit = _mm_and_pd(hit, _mm_and_pd(_mm_cmple_pd(_mm_min_pd(s, e), q_high[d]), _mm_cmpge_pd(_mm_max_pd(s, e), q_low[d])));
+		}
+
+		if (Slab && _mm_movemask_pd(hit) != 0)
+		{
+			__m128d t0 = zero, t1 = _mm_set1_pd(1.0);
+			for (int d = 0; d < DIMENSION; ++d)
+			{
+				const __m128d s = _mm_loadu_pd(start[d] + i);
+				const __m128d dir = _mm_sub_pd(_mm_loadu_pd(end[d] + i), s);
+				const __m128d ta = _mm_div_pd(_mm_sub_pd(q_low[d], s), dir);
+				const __m128d tb = _mm_div_pd(_mm_sub_pd(q_high[d], s), dir);
+
+				// no blend in SSE2, selects are and / andnot / or.
+				const __m128d parallel = _mm_cmpeq_pd(dir, zero);
+				const __m128d inside = _mm_and_pd(_mm_cmpge_pd(s, q_low[d]), _mm_cmple_pd(s, q_high[d]));
+				const __m128d through = _mm_or_pd(_mm_and_pd(inside, inf), _mm_andnot_pd(inside, _mm_sub_pd(zero, inf)));
+
+				const __m128d enter = _mm_or_pd(_mm_and_pd(parallel, _mm_sub_pd(zero, through)), _mm_andnot_pd(parallel, _mm_min_pd(ta, tb)));
+				const __m128d leave = _mm_or_pd(_mm_and_pd(parallel, through), _mm_andnot_pd(parallel, _mm_max_pd(ta, tb)));
+				t0 = _mm_max_pd(t0, enter);
+				t1 = _mm_min_pd(t1, leave);
+			}
+			hit = _mm_and_pd(hit, _mm_cmple_pd(t0, t1));
+		}
+		mask |= uint64_t(_mm_movemask_pd(hit)) << (i - begin);
+	}
+#endif
+
+	return mask | ScalarMask<Slab>(start, end, i, stop, begin, low, high);
+}
+
+}
+
+namespace spatialdb
+{
+
+uint64_t EdgeFilter::IntersectsBox(const double* const* start, const double* const* end,
+	uint32_t begin, uint32_t count, const double* low, const double* high)
+{
+	// the slab test takes the box lifted to 3D, the first DIMENSION
+	// coordinates are unchanged.
+	const Math::Lifted box_low(low, 1, -1.0), box_high(high, 1, 1.0);
+	return Mask<true>(start, end, begin, count, box_low, box_high);
+}
+
+uint64_t EdgeFilter::IntersectsSegment(const double* const* start, const double* const* end,
+	uint32_t begin, uint32_t count, const double* p, const double* q)
+{
+	double low[DIMENSION], high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		low[d] = std::min(p[d], q[d]);
+		high[d] = std::max(p[d], q[d]);
+	}
+
+	// only edges whose bounding box meets the one of (p, q) get the exact
+	// test, most of them are told apart by its floating point filter.
+	uint64_t mask = Mask<false>(start, end, begin, count, low, high);
+	const Math::Lifted p3(p), q3(q);
+	for (uint64_t m = mask; m != 0; )
+	{
+		const uint32_t bit = MBRFilter::NextBit(m);
+		double s[3] = {}, e[3] = {};
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			s[d] = start[d][begin + bit];
+			e[d] = end[d][begin + bit];
+		}
+		if (!Math::SegmentsIntersect(p3, q3, s, e)) {
+			mask &= ~(uint64_t(1) << bit);
+		}
+	}
+	return mask;
+}
+
+void EdgeFilter::PointDistanceSq(const double* const* start, const double* const* end,
+	uint32_t begin, uint32_t count, const double* p, double* out)
+{
+	assert(count <= EdgeFilter::BATCH);
+
+	// dimension outer, the inner loops run over contiguous edges. The
+	// closest point is start + t (end - start), t clamped to [0, 1].
+	double len[EdgeFilter::BATCH], dot[EdgeFilter::BATCH], t[EdgeFilter::BATCH];
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		len[i] = 0.0;
+		dot[i] = 0.0;
+		out[i] = 0.0;
+	}
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const double* s = start[d] + begin;
+		const double* e = end[d] + begin;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const double dir = e[i] - s[i];
+			len[i] += dir * dir;
+			dot[i] += (p[d] - s[i]) * dir;
+		}
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		t[i] = len[i] > 0.0 ? Clamp(dot[i] / len[i], 0.0, 1.0) : 0.0;
+	}
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const double* s = start[d] + begin;
+		const double* e = end[d] + begin;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const double x = p[d] - s[i] - t[i] * (e[i] - s[i]);
+			out[i] += x * x;
+		}
+	}
+}
+
+void EdgeFilter::SegmentDistanceSq(const double* const* start, const double* const* end,
+	uint32_t begin, uint32_t count, const double* p, const double* q, double* out)
+{
+	assert(count <= EdgeFilter::BATCH);
+
+	// Math::SegmentsDistanceSq with the edge first, its cases turned into
+	// selects: s on the edge and t on (p, q) are the parameters of the
+	// closest points.
+	double a[EdgeFilter::BATCH], b[EdgeFilter::BATCH], c[EdgeFilter::BATCH], f[EdgeFilter::BATCH];
+	double s[EdgeFilter::BATCH], t[EdgeFilter::BATCH];
+	double e = 0.0;
+	for (int d = 0; d < DIMENSION; ++d) {
+		e += (q[d] - p[d]) * (q[d] - p[d]);
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		a[i] = 0.0;
+		b[i] = 0.0;
+		c[i] = 0.0;
+		f[i] = 0.0;
+		out[i] = 0.0;
+	}
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const double* st = start[d] + begin;
+		const double* en = end[d] + begin;
+		const double d2 = q[d] - p[d];
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const double d1 = en[i] - st[i];
+			const double r = st[i] - p[d];
+			a[i] += d1 * d1;
+			b[i] += d1 * d2;
+			c[i] += d1 * r;
+			f[i] += d2 * r;
+		}
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const double denom = a[i] * e - b[i] * b[i];
+		const double s_line = denom > 0.0 ? Clamp((b[i] * f[i] - c[i] * e) / denom, 0.0, 1.0) : 0.0;
+		const double s_start = a[i] > 0.0 ? Clamp(-c[i] / a[i], 0.0, 1.0) : 0.0;
+		const double s_end = a[i] > 0.0 ? Clamp((b[i] - c[i]) / a[i], 0.0, 1.0) : 0.0;
+
+		const double s0 = e > 0.0 ? (a[i] > 0.0 ? s_line : 0.0) : s_start;
+		const double t0 = e > 0.0 ? (b[i] * s0 + f[i]) / e : 0.0;
+
+		s[i] = t0 < 0.0 ? s_start : (t0 > 1.0 ? s_end : s0);
+		t[i] = t0 < 0.0 ? 0.0 : (t0 > 1.0 ? 1.0 : t0);
+	}
+
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const double* st = start[d] + begin;
+		const double* en = end[d] + begin;
+		const double d2 = q[d] - p[d];
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const double x = st[i] - p[d] + s[i] * (en[i] - st[i]) - t[i] * d2;
+			out[i] += x * x;
+		}
+	}
+}
+
+}
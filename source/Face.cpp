@@ -1,8 +1,11 @@
 #include "spatialdb/Face.h"
 #include "spatialdb/Point.h"
 #include "spatialdb/Region.h"
+#include "spatialdb/Edge.h"
 #include "spatialdb/ShapeType.h"
+#include "spatialdb/Math.h"
 
+#include <cmath>
 #include <cstring>
 #include <limits>
 #include <algorithm>
@@ -93,6 +96,7 @@ void Face::Initialize(const double* verts, size_t num)
 	if (m_vertices) {
 		memcpy(m_vertices, verts, num * DIMENSION * sizeof(double));
 	}
+	m_num = num;
 }
 
 uint32_t Face::ShapeType() const
@@ -102,17 +106,121 @@ uint32_t Face::ShapeType() const
 
 bool Face::IntersectsShape(const IShape& s) const
 {
-	return false;
+	bool ret = false;
+
+	switch (s.ShapeType())
+	{
+	case ST_POINT:
+	{
+		const Point& p = static_cast<const Point&>(s);
+		ret = ContainsPoint(p);
+	}
+		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = IntersectsEdge(e);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = IntersectsFace(f);
+	}
+		break;
+	case ST_REGION:
+	{
+		const Region& r = static_cast<const Region&>(s);
+		ret = IntersectsRegion(r);
+	}
+		break;
+	}
+
+	return ret;
 }
 
 bool Face::ContainsShape(const IShape& s) const
 {
-	return false;
+	bool ret = false;
+
+	// the face is convex, it contains a shape if it contains its corners.
+	switch (s.ShapeType())
+	{
+	case ST_POINT:
+	{
+		const Point& p = static_cast<const Point&>(s);
+		ret = ContainsPoint(p);
+	}
+		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = ContainsPoint(Point(e.GetStart())) && ContainsPoint(Point(e.GetEnd()));
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.m_num > 0;
+		for (size_t i = 0; i < f.m_num && ret; ++i) {
+			ret = ContainsPoint(Point(f.m_vertices + i * DIMENSION));
+		}
+	}
+		break;
+	case ST_REGION:
+	{
+		const Region& r = static_cast<const Region&>(s);
+		ret = true;
+		for (int k = 0; k < (1 << DIMENSION) && ret; ++k)
+		{
+			double corner[DIMENSION];
+			for (int i = 0; i < DIMENSION; ++i) {
+				corner[i] = (k & (1 << i)) ? r.GetHigh()[i] : r.GetLow()[i];
+			}
+			ret = ContainsPoint(Point(corner));
+		}
+	}
+		break;
+	}
+
+	return ret;
 }
 
 bool Face::TouchesShape(const IShape& s) const
 {
-	return false;
+	bool ret = false;
+
+	// the shapes meet, but do not cross into each other. A point touches
+	// the face on its boundary.
+	switch (s.ShapeType())
+	{
+	case ST_POINT:
+	{
+		const Point& p = static_cast<const Point&>(s);
+		ret = BoundaryContainsPoint(p);
+	}
+		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = IntersectsEdge(e) && !IntersectsEdge(e, true);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = IntersectsFace(f) && !IntersectsFace(f, true);
+	}
+		break;
+	case ST_REGION:
+	{
+		const Region& r = static_cast<const Region&>(s);
+		ret = IntersectsRegion(r) && !IntersectsRegion(r, true);
+	}
+		break;
+	}
+
+	return ret;
 }
 
 void Face::GetCenter(Point& p) const
@@ -159,12 +267,152 @@ void Face::GetMBR(Region& r) const
 
 double Face::GetArea() const
 {
-	return 0;
+	const Math::Lifted verts(m_vertices, m_num);
+	double area = 0.0;
+	for (size_t i = 0; i < GetTriangleCount(); ++i)
+	{
+		const double* a = GetCorner(verts, i, 0);
+		const double* b = GetCorner(verts, i, 1);
+		const double* c = GetCorner(verts, i, 2);
+
+		const double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		const double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		area += 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	}
+	return area;
 }
 
 double Face::GetMinimumDistance(const IShape& s) const
 {
-	return std::numeric_limits<double>::max();
+	double ret = std::numeric_limits<double>::max();
+
+	switch (s.ShapeType())
+	{
+	case ST_POINT:
+	{
+		const Point& p = static_cast<const Point&>(s);
+		ret = GetMinimumDistance(p);
+	}
+		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = GetMinimumDistance(e);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = GetMinimumDistance(f);
+	}
+		break;
+	case ST_REGION:
+	{
+		const Region& r = static_cast<const Region&>(s);
+		ret = GetMinimumDistance(r);
+	}
+		break;
+	}
+
+	return ret;
+}
+
+bool Face::IntersectsRegion(const Region& r, bool touch) const
+{
+	if (m_num < 3) {
+		return false;
+	}
+	const Math::Lifted verts(m_vertices, m_num), low(r.GetLow(), 1, -1.0), high(r.GetHigh(), 1, 1.0);
+	return Math::PolygonIntersectsBox(verts, m_num, low, high, touch);
+}
+
+bool Face::IntersectsEdge(const Edge& e, bool touch) const
+{
+	if (m_num < 3) {
+		return false;
+	}
+	const Math::Lifted p(e.GetStart()), q(e.GetEnd()), verts(m_vertices, m_num);
+	return Math::SegmentIntersectsPolygon(p, q, verts, m_num, touch);
+}
+
+bool Face::IntersectsFace(const Face& f, bool touch) const
+{
+	if (m_num < 3 || f.m_num < 3) {
+		return false;
+	}
+	const Math::Lifted verts1(m_vertices, m_num), verts2(f.m_vertices, f.m_num);
+	return Math::PolygonsIntersect(verts1, m_num, verts2, f.m_num, touch);
+}
+
+bool Face::ContainsPoint(const Point& p) const
+{
+	const Math::Lifted c(p.GetCoords()), verts(m_vertices, m_num);
+	for (size_t i = 0; i < GetTriangleCount(); ++i)
+	{
+		if (Math::PointInTriangle(c, GetCorner(verts, i, 0), GetCorner(verts, i, 1), GetCorner(verts, i, 2))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Face::BoundaryContainsPoint(const Point& p) const
+{
+	if (m_num < 3) {
+		return false;
+	}
+	const Math::Lifted c(p.GetCoords()), verts(m_vertices, m_num);
+	for (size_t i = 0; i < m_num; ++i)
+	{
+		if (Math::PointOnSegment(c, verts + i * 3, verts + ((i + 1) % m_num) * 3)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+double Face::GetMinimumDistance(const Point& p) const
+{
+	const Math::Lifted c(p.GetCoords()), verts(m_vertices, m_num);
+	double ret = std::numeric_limits<double>::max();
+	for (size_t i = 0; i < GetTriangleCount(); ++i) {
+		ret = std::min(ret, Math::PointTriangleDistanceSq(c, GetCorner(verts, i, 0), GetCorner(verts, i, 1), GetCorner(verts, i, 2)));
+	}
+	return GetTriangleCount() > 0 ? std::sqrt(ret) : ret;
+}
+
+double Face::GetMinimumDistance(const Region& r) const
+{
+	const Math::Lifted verts(m_vertices, m_num), low(r.GetLow(), 1, -1.0), high(r.GetHigh(), 1, 1.0);
+	double ret = std::numeric_limits<double>::max();
+	for (size_t i = 0; i < GetTriangleCount() && ret > 0.0; ++i) {
+		ret = std::min(ret, Math::TriangleBoxDistanceSq(GetCorner(verts, i, 0), GetCorner(verts, i, 1), GetCorner(verts, i, 2), low, high));
+	}
+	return GetTriangleCount() > 0 ? std::sqrt(ret) : ret;
+}
+
+double Face::GetMinimumDistance(const Edge& e) const
+{
+	const Math::Lifted p(e.GetStart()), q(e.GetEnd()), verts(m_vertices, m_num);
+	double ret = std::numeric_limits<double>::max();
+	for (size_t i = 0; i < GetTriangleCount() && ret > 0.0; ++i) {
+		ret = std::min(ret, Math::SegmentTriangleDistanceSq(p, q, GetCorner(verts, i, 0), GetCorner(verts, i, 1), GetCorner(verts, i, 2)));
+	}
+	return GetTriangleCount() > 0 ? std::sqrt(ret) : ret;
+}
+
+double Face::GetMinimumDistance(const Face& f) const
+{
+	const Math::Lifted verts1(m_vertices, m_num), verts2(f.m_vertices, f.m_num);
+	double ret = std::numeric_limits<double>::max();
+	for (size_t i = 0; i < GetTriangleCount() && ret > 0.0; ++i)
+	{
+		for (size_t j = 0; j < f.GetTriangleCount() && ret > 0.0; ++j) {
+			ret = std::min(ret, Math::TrianglesDistanceSq(GetCorner(verts1, i, 0), GetCorner(verts1, i, 1), GetCorner(verts1, i, 2), GetCorner(verts2, j, 0), GetCorner(verts2, j, 1), GetCorner(verts2, j, 2)));
+		}
+	}
+	return GetTriangleCount() > 0 && f.GetTriangleCount() > 0 ? std::sqrt(ret) : ret;
 }
 
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "spatialdb/RTree.h"
 #include "spatialdb/Exception.h"
 
+#include <limits>
+
 #include <assert.h>
 
 namespace spatialdb
@@ -91,12 +93,17 @@ void Index::Split(uint32_t data_len, uint8_t* data, const Region& mbr, id_type i
 	auto l = std::make_shared<Index>(m_tree, m_identifier, m_level);
 	auto r = std::make_shared<Index>(m_tree, -1, m_level);
 
+	// the subtree counts move with the entries.
 	uint32_t c_idx;
-	for (c_idx = 0; c_idx < g1.size(); ++c_idx) {
-		l->InsertEntry(0, nullptr, m_children_mbr[g1[c_idx]], m_children_id[g1[c_idx]]);
+	for (c_idx = 0; c_idx < g1.size(); ++c_idx)
+	{
+		l->InsertEntry(m_children_data_len[g1[c_idx]], m_children_data[g1[c_idx]], m_children_mbr[g1[c_idx]], m_children_id[g1[c_idx]]);
+		m_children_data[g1[c_idx]] = nullptr;
 	}
-	for (c_idx = 0; c_idx < g2.size(); ++c_idx) {
-		r->InsertEntry(0, nullptr, m_children_mbr[g2[c_idx]], m_children_id[g2[c_idx]]);
+	for (c_idx = 0; c_idx < g2.size(); ++c_idx)
+	{
+		r->InsertEntry(m_children_data_len[g2[c_idx]], m_children_data[g2[c_idx]], m_children_mbr[g2[c_idx]], m_children_id[g2[c_idx]]);
+		m_children_data[g2[c_idx]] = nullptr;
 	}
 
 	left = l;
@@ -123,7 +130,7 @@ void Index::AdjustTree(const Node* n, std::stack<id_type>& path_buf, bool force)
 	bool bTouches = m_node_mbr.TouchesRegion(m_children_mbr[child]);
 	bool bRecompute = !bContained || (bTouches && m_tree->m_tight_mbrs);
 
-	m_children_mbr[child] = n->m_node_mbr;
+	UpdateEntry(child, *n);
 
 	if (bRecompute || force)
 	{
@@ -135,7 +142,8 @@ void Index::AdjustTree(const Node* n, std::stack<id_type>& path_buf, bool force)
 
 	m_tree->WriteNode(*this);
 
-	if ((bRecompute || force) && (!path_buf.empty()))
+	// the counts change all the way up, even where the MBRs do not.
+	if (!path_buf.empty())
 	{
 		id_type parent = path_buf.top(); path_buf.pop();
 		std::shared_ptr<Node> n = m_tree->ReadNode(parent);
@@ -164,7 +172,7 @@ void Index::AdjustTree(const Node* n1, const Node* n2, std::stack<id_type>& path
 	bool touches = m_node_mbr.TouchesRegion(m_children_mbr[child]);
 	bool recompute = !contained || (touches && m_tree->m_tight_mbrs);
 
-	m_children_mbr[child] = n1->m_node_mbr;
+	UpdateEntry(child, *n1);
 
 	if (recompute)
 	{
@@ -177,12 +185,12 @@ void Index::AdjustTree(const Node* n1, const Node* n2, std::stack<id_type>& path
 	// No write necessary here. insertData will write the node if needed.
 	//m_tree->writeNode(this);
 
-	bool adjusted = InsertData(0, nullptr, n2->m_node_mbr, n2->m_identifier, path_buf, overflow_tbl);
+	uint32_t len;
+	uint8_t* count = n2->NewEntryData(len);
+	bool adjusted = InsertData(len, count, n2->m_node_mbr, n2->m_identifier, path_buf, overflow_tbl);
 
-	// if n2 is contained in the node and there was no split or reinsert,
-	// we need to adjust only if recalculation took place.
-	// In all other cases insertData above took care of adjustment.
-	if (!adjusted && recompute && !path_buf.empty())
+	// insertData above took care of adjustment unless this is the root.
+	if (!adjusted && !path_buf.empty())
 	{
 		id_type parent = path_buf.top(); path_buf.pop();
 		std::shared_ptr<Node> n = m_tree->ReadNode(parent);
@@ -0,0 +1,260 @@
+#include "spatialdb/IoUring.h"
+
+#if defined(__linux__) && !defined(SPATIALDB_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+#define SPATIALDB_IO_URING
+#endif
+
+#ifdef SPATIALDB_IO_URING
+
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+
+int Setup(uint32_t entries, io_uring_params* p)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int Enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+template <typename T>
+T* Offset(void* base, uint32_t off)
+{
+	return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + off);
+}
+
+}
+
+namespace spatialdb
+{
+
+IoUring::IoUring(uint32_t entries)
+{
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	const int fd = Setup(entries, &p);
+	if (fd < 0) {
+		return;
+	}
+
+	m_sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	m_cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+	const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap) {
+		m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+	}
+
+	m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (m_sq_ring == MAP_FAILED)
+	{
+		m_sq_ring = nullptr;
+		close(fd);
+		return;
+	}
+
+	if (single_mmap)
+	{
+		m_cq_ring = m_sq_ring;
+	}
+	else
+	{
+		m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (m_cq_ring == MAP_FAILED)
+		{
+			m_cq_ring = nullptr;
+			munmap(m_sq_ring, m_sq_ring_size);
+			m_sq_ring = nullptr;
+			close(fd);
+			return;
+		}
+	}
+
+	m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+	m_sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (m_sqes == MAP_FAILED)
+	{
+		m_sqes = nullptr;
+		if (m_cq_ring != m_sq_ring) {
+			munmap(m_cq_ring, m_cq_ring_size);
+		}
+		munmap(m_sq_ring, m_sq_ring_size);
+		m_sq_ring = m_cq_ring = nullptr;
+		close(fd);
+		return;
+	}
+
+	m_sq_head  = Offset<unsigned>(m_sq_ring, p.sq_off.head);
+	m_sq_tail  = Offset<unsigned>(m_sq_ring, p.sq_off.tail);
+	m_sq_mask  = Offset<unsigned>(m_sq_ring, p.sq_off.ring_mask);
+	m_sq_array = Offset<unsigned>(m_sq_ring, p.sq_off.array);
+	m_cq_head  = Offset<unsigned>(m_cq_ring, p.cq_off.head);
+	m_cq_tail  = Offset<unsigned>(m_cq_ring, p.cq_off.tail);
+	m_cq_mask  = Offset<unsigned>(m_cq_ring, p.cq_off.ring_mask);
+	m_cqes     = Offset<void>(m_cq_ring, p.cq_off.cqes);
+
+	m_sq_entries = p.sq_entries;
+	m_cq_entries = p.cq_entries;
+	m_fd = fd;
+}
+
+IoUring::~IoUring()
+{
+	if (m_sqes == nullptr) {
+		return;
+	}
+
+	munmap(m_sqes, m_sqes_size);
+	if (m_cq_ring != m_sq_ring) {
+		munmap(m_cq_ring, m_cq_ring_size);
+	}
+	munmap(m_sq_ring, m_sq_ring_size);
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+}
+
+bool IoUring::Read(IoRead* reads, size_t count)
+{
+	if (m_fd < 0) {
+		return false;
+	}
+
+	// bytes read so far per request, short reads go back to the queue.
+	std::vector<uint32_t> done(count, 0);
+	std::vector<size_t> pending;
+	pending.reserve(count);
+	for (size_t i = count; i > 0; --i) {
+		pending.push_back(i - 1);
+	}
+
+	auto sqes = static_cast<io_uring_sqe*>(m_sqes);
+	auto cqes = static_cast<io_uring_cqe*>(m_cqes);
+
+	bool ok = true;
+	// set once io_uring_enter failed, the reads in flight are drained then.
+	bool broken = false;
+	uint32_t inflight = 0;
+	while (inflight > 0 || (ok && !pending.empty()))
+	{
+		if (broken)
+		{
+			// completions are posted without the call as well, it only waits.
+			if (__atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE) == *m_cq_head &&
+				Enter(m_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+				sched_yield();
+			}
+		}
+		else
+		{
+			unsigned tail = *m_sq_tail;
+			const unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			while (ok && !pending.empty() && tail - head < m_sq_entries && inflight < m_cq_entries)
+			{
+				const size_t i = pending.back();
+				pending.pop_back();
+
+				const unsigned index = tail & *m_sq_mask;
+				io_uring_sqe* sqe = &sqes[index];
+				memset(sqe, 0, sizeof(*sqe));
+				sqe->opcode = IORING_OP_READ;
+				sqe->fd = reads[i].fd;
+				sqe->off = reads[i].offset + done[i];
+				sqe->addr = reinterpret_cast<uint64_t>(reads[i].buffer + done[i]);
+				sqe->len = reads[i].length - done[i];
+				sqe->user_data = i;
+				m_sq_array[index] = index;
+
+				++tail;
+				++inflight;
+			}
+			__atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+			// entries left over by an interrupted call are submitted again.
+			const unsigned to_submit = tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			const int ret = Enter(m_fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+			if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			{
+				// the ring is unusable. The entries the kernel has not taken
+				// are withdrawn, the reads it has still write to the buffers
+				// and are waited for before the ring is closed.
+				const unsigned taken = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+				inflight -= tail - taken;
+				__atomic_store_n(m_sq_tail, taken, __ATOMIC_RELEASE);
+				broken = true;
+				ok = false;
+			}
+		}
+
+		unsigned c_head = *m_cq_head;
+		const unsigned c_tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+		while (c_head != c_tail)
+		{
+			const io_uring_cqe& cqe = cqes[c_head & *m_cq_mask];
+			const size_t i = static_cast<size_t>(cqe.user_data);
+			if (cqe.res <= 0)
+			{
+				ok = false;
+			}
+			else
+			{
+				done[i] += static_cast<uint32_t>(cqe.res);
+				if (done[i] < reads[i].length) {
+					pending.push_back(i);
+				}
+			}
+
+			++c_head;
+			--inflight;
+		}
+		__atomic_store_n(m_cq_head, c_head, __ATOMIC_RELEASE);
+	}
+
+	if (broken)
+	{
+		// later batches take the pread path.
+		close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+
+	return ok && pending.empty();
+}
+
+}
+
+#else
+
+namespace spatialdb
+{
+
+IoUring::IoUring(uint32_t)
+{
+}
+
+IoUring::~IoUring()
+{
+}
+
+bool IoUring::Read(IoRead*, size_t)
+{
+	return false;
+}
+
+}
+
+#endif
@@ -2,6 +2,8 @@
 #include "spatialdb/RTree.h"
 #include "spatialdb/Exception.h"
 
+#include <cstring>
+
 namespace spatialdb
 {
 
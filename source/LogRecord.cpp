@@ -0,0 +1,109 @@
+#include "spatialdb/LogRecord.h"
+#include "spatialdb/Checksum.h"
+#include "spatialdb/Exception.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace spatialdb
+{
+
+//
+// class LogWriter
+//
+
+void LogWriter::Begin(uint32_t type)
+{
+	m_begin = m_buf.size();
+	m_buf.resize(m_begin + HEADER_SIZE, 0);
+	memcpy(m_buf.data() + m_begin, &type, sizeof(uint32_t));
+}
+
+void LogWriter::End()
+{
+	const uint32_t len = static_cast<uint32_t>(m_buf.size() - m_begin - HEADER_SIZE);
+	const uint32_t crc = Checksum::Crc32(m_buf.data() + m_begin + HEADER_SIZE, len);
+	memcpy(m_buf.data() + m_begin + sizeof(uint32_t), &len, sizeof(uint32_t));
+	memcpy(m_buf.data() + m_begin + 2 * sizeof(uint32_t), &crc, sizeof(uint32_t));
+}
+
+void LogWriter::Append(const void* data, size_t len)
+{
+	const size_t pos = m_buf.size();
+	m_buf.resize(pos + len);
+	if (len > 0) {
+		memcpy(m_buf.data() + pos, data, len);
+	}
+}
+
+void LogWriter::SyncFile(const std::string& filename)
+{
+#ifdef _WIN32
+	const int fd = _open(filename.c_str(), _O_RDWR | _O_BINARY);
+	const bool ok = fd >= 0 && _commit(fd) == 0;
+	if (fd >= 0) {
+		_close(fd);
+	}
+#else
+	const int fd = open(filename.c_str(), O_RDONLY);
+	const bool ok = fd >= 0 && fsync(fd) == 0;
+	if (fd >= 0) {
+		close(fd);
+	}
+#endif
+	if (!ok) {
+		throw IllegalStateException("LogWriter: Could not sync " + filename + ".");
+	}
+}
+
+//
+// class LogReader
+//
+
+bool LogReader::Next(uint32_t& type)
+{
+	if (m_payload) {
+		m_offset = m_payload - m_data + m_payload_size;
+	}
+	m_payload = nullptr;
+
+	if (m_size - m_offset < LogWriter::HEADER_SIZE) {
+		return false;
+	}
+
+	const uint8_t* ptr = m_data + m_offset;
+	uint32_t len, crc;
+	memcpy(&type, ptr, sizeof(uint32_t));
+	memcpy(&len, ptr + sizeof(uint32_t), sizeof(uint32_t));
+	memcpy(&crc, ptr + 2 * sizeof(uint32_t), sizeof(uint32_t));
+	ptr += LogWriter::HEADER_SIZE;
+
+	if (m_size - m_offset - LogWriter::HEADER_SIZE < len || Checksum::Crc32(ptr, len) != crc) {
+		return false;
+	}
+
+	m_payload = ptr;
+	m_payload_size = len;
+	m_read = 0;
+
+	return true;
+}
+
+void LogReader::Read(void* dst, size_t len)
+{
+	if (m_payload == nullptr || m_payload_size - m_read < len) {
+		throw IllegalStateException("LogReader: Corrupted log record.");
+	}
+
+	memcpy(dst, m_payload + m_read, len);
+	m_read += static_cast<uint32_t>(len);
+}
+
+}
@@ -0,0 +1,326 @@
+#include "spatialdb/MBRFilter.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SPATIALDB_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <assert.h>
+#include <limits>
+
+namespace
+{
+
+using namespace spatialdb;
+
+// the vector operations of the mask kernels for double and float bounds.
+template <class T>
+struct Lanes;
+
+#if defined(__AVX__)
+template <>
+struct Lanes<double>
+{
+	using Vec = __m256d;
+	static constexpr uint32_t COUNT = 4;
+
+	static Vec Load(const double* p) { return _mm256_loadu_pd(p); }
+	static Vec Set(double x) { return _mm256_set1_pd(x); }
+	static Vec All() { return _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); }
+	static Vec And(Vec a, Vec b) { return _mm256_and_pd(a, b); }
+	static Vec Le(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+	static Vec Ge(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+	static uint64_t Bits(Vec a) { return static_cast<uint64_t>(_mm256_movemask_pd(a)); }
+};
+
+template <>
+struct Lanes<float>
+{
+	using Vec = __m256;
+	static constexpr uint32_t COUNT = 8;
+
+	static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+	static Vec Set(float x) { return _mm256_set1_ps(x); }
+	static Vec All() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+	static Vec And(Vec a, Vec b) { return _mm256_and_ps(a, b); }
+	static Vec Le(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static Vec Ge(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static uint64_t Bits(Vec a) { return static_cast<uint64_t>(_mm256_movemask_ps(a)); }
+};
+#elif defined(SPATIALDB_SSE2)
+template <>
+struct Lanes<double>
+{
+	using Vec = __m128d;
+	static constexpr uint32_t COUNT = 2;
+
+	static Vec Load(const double* p) { return _mm_loadu_pd(p); }
+	static Vec Set(double x) { return _mm_set1_pd(x); }
+	static Vec All() { return _mm_castsi128_pd(_mm_set1_epi32(-1)); }
+	static Vec And(Vec a, Vec b) { return _mm_and_pd(a, b); }
+	static Vec Le(Vec a, Vec b) { return _mm_cmple_pd(a, b); }
+	static Vec Ge(Vec a, Vec b) { return _mm_cmpge_pd(a, b); }
+	static uint64_t Bits(Vec a) { return static_cast<uint64_t>(_mm_movemask_pd(a)); }
+};
+
+template <>
+struct Lanes<float>
+{
+	using Vec = __m128;
+	static constexpr uint32_t COUNT = 4;
+
+	static Vec Load(const float* p) { return _mm_loadu_ps(p); }
+	static Vec Set(float x) { return _mm_set1_ps(x); }
+	static Vec All() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+	static Vec And(Vec a, Vec b) { return _mm_and_ps(a, b); }
+	static Vec Le(Vec a, Vec b) { return _mm_cmple_ps(a, b); }
+	static Vec Ge(Vec a, Vec b) { return _mm_cmpge_ps(a, b); }
+	static uint64_t Bits(Vec a) { return static_cast<uint64_t>(_mm_movemask_ps(a)); }
+};
+#endif
+
+#if defined(__AVX__) || defined(SPATIALDB_SSE2)
+// quantized cells, compared as signed values with the top bit flipped.
+template <>
+struct Lanes<uint8_t>
+{
+	using Vec = __m128i;
+	static constexpr uint32_t COUNT = 16;
+
+	static Vec Load(const uint8_t* p) { return _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi8(-128)); }
+	static Vec Set(uint8_t x) { return _mm_set1_epi8(static_cast<char>(x ^ 0x80)); }
+	static Vec All() { return _mm_set1_epi32(-1); }
+	static Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+	static Vec Le(Vec a, Vec b) { return _mm_andnot_si128(_mm_cmpgt_epi8(a, b), All()); }
+	static Vec Ge(Vec a, Vec b) { return _mm_andnot_si128(_mm_cmpgt_epi8(b, a), All()); }
+	static uint64_t Bits(Vec a) { return static_cast<uint64_t>(_mm_movemask_epi8(a)); }
+};
+
+template <>
+struct Lanes<uint16_t>
+{
+	using Vec = __m128i;
+	static constexpr uint32_t COUNT = 8;
+
+	static Vec Load(const uint16_t* p) { return _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi16(-32768)); }
+	static Vec Set(uint16_t x) { return _mm_set1_epi16(static_cast<short>(x ^ 0x8000)); }
+	static Vec All() { return _mm_set1_epi32(-1); }
+	static Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+	static Vec Le(Vec a, Vec b) { return _mm_andnot_si128(_mm_cmpgt_epi16(a, b), All()); }
+	static Vec Ge(Vec a, Vec b) { return _mm_andnot_si128(_mm_cmpgt_epi16(b, a), All()); }
+	// one bit per lane out of the byte mask.
+	static uint64_t Bits(Vec a) { return static_cast<uint64_t>(_mm_movemask_epi8(_mm_packs_epi16(a, _mm_setzero_si128()))); }
+};
+#endif
+
+// bound >= value, per dimension: child low against the query high (flipped)
+// and child high against the query low. The query is given in T, see Mask.
+template <bool Contained, class T>
+uint64_t ScalarMask(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t end, uint32_t shift, const T* low, const T* high)
+{
+	uint64_t mask = 0;
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		bool hit = true;
+		for (int d = 0; d < DIMENSION && hit; ++d)
+		{
+			if (Contained) {
+				hit = child_low[d][i] >= low[d] && child_high[d][i] <= high[d];
+			} else {
+				hit = child_low[d][i] <= high[d] && child_high[d][i] >= low[d];
+			}
+		}
+		if (hit) {
+			mask |= uint64_t(1) << (i - shift);
+		}
+	}
+	return mask;
+}
+
+template <bool Contained, class T>
+uint64_t Mask(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const T* q_low, const T* q_high)
+{
+	assert(count <= MBRFilter::BATCH);
+
+	const uint32_t end = begin + count;
+	uint64_t mask = 0;
+	uint32_t i = begin;
+
+#if defined(__AVX__) || defined(SPATIALDB_SSE2)
+	using L = Lanes<T>;
+
+	typename L::Vec v_low[DIMENSION], v_high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		v_low[d] = L::Set(q_low[d]);
+		v_high[d] = L::Set(q_high[d]);
+	}
+
+	for (; i + L::COUNT <= end; i += L::COUNT)
+	{
+		typename L::Vec hit = L::All();
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			const typename L::Vec l = L::Load(child_low[d] + i);
+			const typename L::Vec h = L::Load(child_high[d] + i);
+			if (Contained) {
+				hit = L::And(hit, L::And(L::Ge(l, v_low[d]), L::Le(h, v_high[d])));
+			} else {
+				hit = L::And(hit, L::And(L::Le(l, v_high[d]), L::Ge(h, v_low[d])));
+			}
+		}
+		mask |= L::Bits(hit) << (i - begin);
+	}
+#endif
+
+	return mask | ScalarMask<Contained>(child_low, child_high, i, end, begin, q_low, q_high);
+}
+
+// a double query against T bounds is rounded to T, its low up and its high
+// down, which keeps the comparisons exact.
+template <bool Contained, class T>
+uint64_t RoundedMask(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const double* low, const double* high)
+{
+	T q_low[DIMENSION], q_high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		q_low[d] = RoundUp<T>(low[d]);
+		q_high[d] = RoundDown<T>(high[d]);
+	}
+	return Mask<Contained>(child_low, child_high, begin, count, q_low, q_high);
+}
+
+}
+
+namespace spatialdb
+{
+
+template <class T>
+uint64_t MBRFilter::Intersects(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const double* low, const double* high)
+{
+	return RoundedMask<false>(child_low, child_high, begin, count, low, high);
+}
+
+template <class T>
+uint64_t MBRFilter::ContainedIn(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const double* low, const double* high)
+{
+	return RoundedMask<true>(child_low, child_high, begin, count, low, high);
+}
+
+template <class T>
+uint64_t MBRFilter::IntersectsCells(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const T* low, const T* high)
+{
+	return Mask<false>(child_low, child_high, begin, count, low, high);
+}
+
+template <class T>
+uint64_t MBRFilter::ContainedInCells(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const T* low, const T* high)
+{
+	return Mask<true>(child_low, child_high, begin, count, low, high);
+}
+
+template <class T>
+void MBRFilter::MinDistanceSq(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const double* low, const double* high, double* out)
+{
+	assert(count <= MBRFilter::BATCH);
+
+	// dimension outer, the inner loop runs over contiguous children.
+	for (uint32_t i = 0; i < count; ++i) {
+		out[i] = 0.0;
+	}
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const T* c_low = child_low[d] + begin;
+		const T* c_high = child_high[d] + begin;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const double below = c_low[i] - high[d];
+			const double above = low[d] - c_high[i];
+			const double x = below > 0.0 ? below : (above > 0.0 ? above : 0.0);
+			out[i] += x * x;
+		}
+	}
+}
+
+template <class T>
+void MBRFilter::MinMaxDistanceSq(const T* const* child_low, const T* const* child_high,
+	uint32_t begin, uint32_t count, const double* p, double* out)
+{
+	assert(count <= MBRFilter::BATCH);
+
+	// per dimension, the squared distance to the nearer and to the farther
+	// face; the sums are formed in dimension order for every candidate so
+	// the result is never below the distance of the entry it stands for.
+	double near_sq[DIMENSION][MBRFilter::BATCH];
+	double far_sq[DIMENSION][MBRFilter::BATCH];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const T* c_low = child_low[d] + begin;
+		const T* c_high = child_high[d] + begin;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const double to_low = p[d] - c_low[i];
+			const double to_high = p[d] - c_high[i];
+			const bool low_nearer = 2.0 * p[d] <= static_cast<double>(c_low[i]) + c_high[i];
+			near_sq[d][i] = low_nearer ? to_low * to_low : to_high * to_high;
+			far_sq[d][i] = low_nearer ? to_high * to_high : to_low * to_low;
+		}
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		double best = std::numeric_limits<double>::max();
+		for (int k = 0; k < DIMENSION; ++k)
+		{
+			double sum = 0.0;
+			for (int d = 0; d < DIMENSION; ++d) {
+				sum += d == k ? near_sq[d][i] : far_sq[d][i];
+			}
+			best = sum < best ? sum : best;
+		}
+		out[i] = best;
+	}
+}
+
+template uint64_t MBRFilter::Intersects(const double* const*, const double* const*, uint32_t, uint32_t, const double*, const double*);
+template uint64_t MBRFilter::Intersects(const float* const*, const float* const*, uint32_t, uint32_t, const double*, const double*);
+template uint64_t MBRFilter::ContainedIn(const double* const*, const double* const*, uint32_t, uint32_t, const double*, const double*);
+template uint64_t MBRFilter::ContainedIn(const float* const*, const float* const*, uint32_t, uint32_t, const double*, const double*);
+template uint64_t MBRFilter::IntersectsCells(const uint8_t* const*, const uint8_t* const*, uint32_t, uint32_t, const uint8_t*, const uint8_t*);
+template uint64_t MBRFilter::IntersectsCells(const uint16_t* const*, const uint16_t* const*, uint32_t, uint32_t, const uint16_t*, const uint16_t*);
+template uint64_t MBRFilter::ContainedInCells(const uint8_t* const*, const uint8_t* const*, uint32_t, uint32_t, const uint8_t*, const uint8_t*);
+template uint64_t MBRFilter::ContainedInCells(const uint16_t* const*, const uint16_t* const*, uint32_t, uint32_t, const uint16_t*, const uint16_t*);
+template void MBRFilter::MinDistanceSq(const double* const*, const double* const*, uint32_t, uint32_t, const double*, const double*, double*);
+template void MBRFilter::MinDistanceSq(const float* const*, const float* const*, uint32_t, uint32_t, const double*, const double*, double*);
+template void MBRFilter::MinMaxDistanceSq(const double* const*, const double* const*, uint32_t, uint32_t, const double*, double*);
+template void MBRFilter::MinMaxDistanceSq(const float* const*, const float* const*, uint32_t, uint32_t, const double*, double*);
+
+uint32_t MBRFilter::NextBit(uint64_t& mask)
+{
+	assert(mask != 0);
+
+#ifdef _MSC_VER
+	unsigned long bit;
+	_BitScanForward64(&bit, mask);
+#else
+	const uint32_t bit = __builtin_ctzll(mask);
+#endif
+	mask &= mask - 1;
+	return static_cast<uint32_t>(bit);
+}
+
+}
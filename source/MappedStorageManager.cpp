@@ -0,0 +1,356 @@
+#include "spatialdb/MappedStorageManager.h"
+#include "spatialdb/Exception.h"
+#include "spatialdb/WriteAheadLog.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <assert.h>
+
+namespace
+{
+
+const uint32_t MIN_GROWTH_PAGES = 16;
+
+}
+
+namespace spatialdb
+{
+
+MappedStorageManager::Mapping::Mapping(int fd, size_t size)
+	: m_size(size)
+{
+	void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		throw IllegalStateException("MappedStorageManager: Could not map the data file.");
+	}
+	m_data = static_cast<uint8_t*>(addr);
+}
+
+MappedStorageManager::Mapping::~Mapping()
+{
+	munmap(m_data, m_size);
+}
+
+MappedStorageManager::MappedStorageManager(const std::string& filename, bool overwrite, uint32_t page_size)
+{
+	const std::string index_file = filename + ".idx";
+	const std::string data_file = filename + ".dat";
+	const bool files_exists = std::filesystem::exists(index_file) &&
+		std::filesystem::exists(data_file);
+	if (!files_exists) {
+		overwrite = true;
+	}
+
+	m_page_table = std::make_unique<PageTable>(index_file, overwrite, page_size);
+	m_page_size = m_page_table->GetPageSize();
+
+	int flags = O_RDWR | O_CREAT;
+	if (overwrite) {
+		flags |= O_TRUNC;
+	}
+	m_data_fd = open(data_file.c_str(), flags, 0644);
+	if (m_data_fd < 0)
+	{
+		Release();
+		throw IllegalStateException("MappedStorageManager: Could not open the data file.");
+	}
+
+	try
+	{
+		struct stat st;
+		if (fstat(m_data_fd, &st) != 0) {
+			throw IllegalStateException("MappedStorageManager: Could not stat the data file.");
+		}
+
+		const id_type file_pages = static_cast<id_type>(st.st_size / m_page_size);
+		Reserve(std::max(m_page_table->GetNextPage(), file_pages));
+
+		// a log left behind by a crashed DiskStorageManager is replayed, a
+		// stale one must not be.
+		const std::string wal_file = filename + ".wal";
+		if (std::filesystem::exists(wal_file))
+		{
+			if (!overwrite) {
+				Recover(wal_file);
+			}
+			std::filesystem::remove(wal_file);
+		}
+	}
+	catch (...)
+	{
+		Release();
+		throw;
+	}
+}
+
+MappedStorageManager::~MappedStorageManager()
+{
+	try
+	{
+		Flush();
+	}
+	catch (...)
+	{
+	}
+
+	// give back the space reserved for growth, the file keeps the
+	// DiskStorageManager layout. The tail only holds unused pages, so a
+	// failure here is harmless. Views still holding the mapping would
+	// fault (SIGBUS) on a cut tail, the file then keeps its size until
+	// the next close.
+	if (m_mapping.use_count() <= 1)
+	{
+		const int ret = ftruncate(m_data_fd, static_cast<off_t>(m_page_table->GetNextPage()) * m_page_size);
+		(void)ret;
+	}
+
+	Release();
+}
+
+void MappedStorageManager::LoadByteArray(const id_type page, uint32_t& len, uint8_t** data)
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	const PageTable::Entry* entry = m_page_table->Find(page);
+	if (entry == nullptr) {
+		throw InvalidPageException(page);
+	}
+
+	const PageTable::Entry& e = *entry;
+	len = e.length;
+	*data = new uint8_t[len];
+
+	uint8_t* ptr = *data;
+	uint32_t c_rem = len;
+	for (auto c_page : e.pages)
+	{
+		const uint32_t c_len = std::min(c_rem, m_page_size);
+		memcpy(ptr, m_mapping->GetData() + c_page * m_page_size, c_len);
+		ptr += c_len;
+		c_rem -= c_len;
+	}
+}
+
+void MappedStorageManager::StoreByteArray(id_type& page, const uint32_t len, const uint8_t* const data)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	const uint32_t c_total = std::max(1u, (len + m_page_size - 1) / m_page_size);
+
+	PageTable::Entry e;
+	if (page != NewPage)
+	{
+		const PageTable::Entry* old_entry = m_page_table->Find(page);
+		if (old_entry == nullptr) {
+			throw InvalidPageException(page);
+		}
+		e.pages = old_entry->pages;
+	}
+
+	e.length = len;
+
+	// reuse the pages of the old entry first, release the rest.
+	while (e.pages.size() > c_total)
+	{
+		m_page_table->FreePage(e.pages.back());
+		e.pages.pop_back();
+	}
+	while (e.pages.size() < c_total) {
+		e.pages.push_back(AllocatePage());
+	}
+
+	WritePages(e.pages, len, data);
+
+	if (page == NewPage) {
+		page = e.pages[0];
+	}
+	m_page_table->Put(page, std::move(e));
+}
+
+void MappedStorageManager::DeleteByteArray(const id_type page)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	const PageTable::Entry* e = m_page_table->Find(page);
+	if (e == nullptr) {
+		throw InvalidPageException(page);
+	}
+
+	for (auto c_page : e->pages) {
+		m_page_table->FreePage(c_page);
+	}
+
+	m_page_table->Erase(page);
+}
+
+void MappedStorageManager::Flush()
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	if (m_mapping && msync(m_mapping->GetData(), m_mapping->GetSize(), MS_SYNC) != 0) {
+		throw IllegalStateException("MappedStorageManager: Could not sync the data file.");
+	}
+
+	// the index only points at pages that are on disk.
+	m_page_table->Flush();
+}
+
+bool MappedStorageManager::LoadByteArrayView(const id_type page, uint32_t& len, const uint8_t** data, std::shared_ptr<const void>& owner)
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	const PageTable::Entry* entry = m_page_table->Find(page);
+	if (entry == nullptr) {
+		throw InvalidPageException(page);
+	}
+
+	const PageTable::Entry& e = *entry;
+	if (!IsContiguous(e)) {
+		return false;
+	}
+
+	len = e.length;
+	*data = m_mapping->GetData() + e.pages[0] * m_page_size;
+	owner = m_mapping;
+
+	return true;
+}
+
+uint32_t MappedStorageManager::GetPageSize() const
+{
+	return m_page_size;
+}
+
+void MappedStorageManager::SetAccessPattern(MappedAccess access)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	m_access = access;
+	Advise();
+}
+
+id_type MappedStorageManager::AllocatePage()
+{
+	const id_type page = m_page_table->AllocatePage();
+	Reserve(m_page_table->GetNextPage());
+	return page;
+}
+
+void MappedStorageManager::Reserve(id_type pages)
+{
+	const size_t needed = static_cast<size_t>(std::max(pages, static_cast<id_type>(MIN_GROWTH_PAGES))) * m_page_size;
+	if (m_mapping && m_mapping->GetSize() >= needed) {
+		return;
+	}
+
+	// double the mapped size to keep appends amortized O(1).
+	size_t size = needed;
+	if (m_mapping) {
+		size = std::max(size, 2 * m_mapping->GetSize());
+	}
+
+	if (ftruncate(m_data_fd, static_cast<off_t>(size)) != 0) {
+		throw IllegalStateException("MappedStorageManager: Could not grow the data file.");
+	}
+
+	m_mapping = std::make_shared<Mapping>(m_data_fd, size);
+	Advise();
+}
+
+void MappedStorageManager::Advise() const
+{
+	if (!m_mapping) {
+		return;
+	}
+
+	int advice = MADV_NORMAL;
+	switch (m_access)
+	{
+	case MappedAccess::Sequential:
+		advice = MADV_SEQUENTIAL;
+		break;
+	case MappedAccess::Random:
+		advice = MADV_RANDOM;
+		break;
+	default:
+		break;
+	}
+
+	// only a hint, failures are ignored.
+	madvise(m_mapping->GetData(), m_mapping->GetSize(), advice);
+}
+
+void MappedStorageManager::WritePages(const std::vector<id_type>& pages, uint32_t len, const uint8_t* data)
+{
+	const uint8_t* ptr = data;
+	uint32_t c_rem = len;
+	for (auto c_page : pages)
+	{
+		uint8_t* dst = m_mapping->GetData() + c_page * m_page_size;
+		const uint32_t c_len = std::min(c_rem, m_page_size);
+		memcpy(dst, ptr, c_len);
+		memset(dst + c_len, 0, m_page_size - c_len);
+
+		ptr += c_len;
+		c_rem -= c_len;
+	}
+}
+
+void MappedStorageManager::Recover(const std::string& wal_file)
+{
+	WriteAheadLog wal(wal_file, false);
+
+	const size_t groups = wal.Replay(
+		[this](id_type id, const PageTable::Entry& e, const uint8_t* data) {
+			for (auto c_page : e.pages) {
+				Reserve(std::max(m_page_table->GetNextPage(), c_page + 1));
+			}
+			WritePages(e.pages, e.length, data);
+			m_page_table->Put(id, PageTable::Entry(e));
+		},
+		[this](id_type id) {
+			m_page_table->Erase(id);
+		}
+	);
+
+	if (groups > 0)
+	{
+		m_page_table->RebuildEmptyPages();
+
+		if (msync(m_mapping->GetData(), m_mapping->GetSize(), MS_SYNC) != 0) {
+			throw IllegalStateException("MappedStorageManager: Could not sync the data file.");
+		}
+		m_page_table->Flush(true);
+	}
+}
+
+void MappedStorageManager::Release()
+{
+	m_mapping.reset();
+
+	if (m_data_fd >= 0)
+	{
+		close(m_data_fd);
+		m_data_fd = -1;
+	}
+}
+
+bool MappedStorageManager::IsContiguous(const PageTable::Entry& e) const
+{
+	for (size_t i = 1; i < e.pages.size(); ++i) {
+		if (e.pages[i] != e.pages[0] + static_cast<id_type>(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+}
@@ -1,6 +1,10 @@
 #include "spatialdb/Math.h"
 #include "spatialdb/Point.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace spatialdb
 {
 
@@ -14,12 +18,12 @@ double Math::DoubleAreaTriangle(const Point& a, const Point& b, const Point& c)
 
 bool Math::LeftOf(const Point& a, const Point& b, const Point& c) 
 {
-    return DoubleAreaTriangle(a, b, c) > 0;
+    return Orient2D(a.GetCoords(), b.GetCoords(), c.GetCoords()) > 0;
 }
 
 bool Math::Collinear(const Point& a, const Point& b, const Point& c) 
 {
-    return DoubleAreaTriangle(a, b, c) == 0;
+    return Orient2D(a.GetCoords(), b.GetCoords(), c.GetCoords()) == 0;
 }
 
 bool Math::IntersectsProper(const Point& a, const Point& b, const Point& c, const Point& d) 
@@ -64,4 +68,781 @@ bool Math::Intersects(const Point& a, const Point& b, const Point& c, const Poin
     }
 }
 
-}
\ No newline at end of file
+}
+namespace
+{
+
+// half an ulp of 1, the unit roundoff.
+const double EPSILON = std::numeric_limits<double>::epsilon() / 2.0;
+// Shewchuk's bounds on the error of the floating point determinants,
+// relative to the sum of the absolute values of their terms.
+const double ORIENT2D_BOUND = (3.0 + 16.0 * EPSILON) * EPSILON;
+const double ORIENT3D_BOUND = (7.0 + 56.0 * EPSILON) * EPSILON;
+
+// x + y == a + b exactly, x the rounded sum.
+inline void TwoSum(double a, double b, double& x, double& y)
+{
+    x = a + b;
+    const double bv = x - a;
+    const double av = x - bv;
+    y = (a - av) + (b - bv);
+}
+
+// x + y == a * b exactly, x the rounded product.
+inline void TwoProduct(double a, double b, double& x, double& y)
+{
+    x = a * b;
+    y = std::fma(a, b, -x);
+}
+
+// An exact sum of products, kept as non-overlapping doubles of increasing
+// magnitude (Shewchuk's expansions). The last one has the sign of the sum
+// and approximates it.
+class Expansion
+{
+public:
+    void Add(double b)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            double h;
+            TwoSum(b, m_terms[i], b, h);
+            if (h != 0.0) {
+                m_terms[n++] = h;
+            }
+        }
+        if (b != 0.0) {
+            m_terms[n++] = b;
+        }
+        m_size = n;
+    }
+
+    void AddProduct(double a, double b)
+    {
+        double x, y;
+        TwoProduct(a, b, x, y);
+        Add(y);
+        Add(x);
+    }
+
+    void AddProduct(double a, double b, double c)
+    {
+        double x, y, s, t;
+        TwoProduct(a, b, x, y);
+        TwoProduct(y, c, s, t);
+        Add(t);
+        Add(s);
+        TwoProduct(x, c, s, t);
+        Add(t);
+        Add(s);
+    }
+
+    double Estimate() const { return m_size > 0 ? m_terms[m_size - 1] : 0.0; }
+
+private:
+    // one term per Add, the 24 triple products of Orient3D take 96.
+    double m_terms[96];
+    size_t m_size = 0;
+};
+
+// sign * det(p, q, r), each of the six terms exactly.
+void AddDeterminant(Expansion& e, const double* p, const double* q, const double* r, double sign)
+{
+    static const int perms[6][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 2, 1 }, { 2, 1, 0 }, { 1, 0, 2 } };
+    for (int k = 0; k < 6; ++k)
+    {
+        const double s = k < 3 ? sign : -sign;
+        e.AddProduct(s * p[perms[k][0]], q[perms[k][1]], r[perms[k][2]]);
+    }
+}
+
+inline int Sign(double x)
+{
+    return (x > 0.0) - (x < 0.0);
+}
+
+// Orient2D of the points dropped onto the coordinate plane normal to axis.
+double OrientProjected(const double* a, const double* b, const double* c, int axis)
+{
+    const int i = (axis + 1) % 3, j = (axis + 2) % 3;
+    const double pa[2] = { a[i], a[j] };
+    const double pb[2] = { b[i], b[j] };
+    const double pc[2] = { c[i], c[j] };
+    return spatialdb::Math::Orient2D(pa, pb, pc);
+}
+
+// c lies in the bounding box of a and b, in the coordinates other than axis.
+inline bool InBox(const double* a, const double* b, const double* c, int axis)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (i != axis && (c[i] < std::min(a[i], b[i]) || c[i] > std::max(a[i], b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the segments dropped onto the coordinate plane normal to axis meet.
+bool ProjectedSegmentsIntersect(const double* p1, const double* q1, const double* p2, const double* q2, int axis)
+{
+    const int o1 = Sign(OrientProjected(p1, q1, p2, axis));
+    const int o2 = Sign(OrientProjected(p1, q1, q2, axis));
+    const int o3 = Sign(OrientProjected(p2, q2, p1, axis));
+    const int o4 = Sign(OrientProjected(p2, q2, q1, axis));
+
+    if (o1 * o2 < 0 && o3 * o4 < 0) {
+        return true;
+    }
+    return (o1 == 0 && InBox(p1, q1, p2, axis)) || (o2 == 0 && InBox(p1, q1, q2, axis)) ||
+           (o3 == 0 && InBox(p2, q2, p1, axis)) || (o4 == 0 && InBox(p2, q2, q1, axis));
+}
+
+inline void Sub(const double* a, const double* b, double* out)
+{
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+inline double Dot(const double* a, const double* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+inline void Cross(const double* a, const double* b, double* out)
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline double Clamp(double x, double low, double high)
+{
+    return x < low ? low : (x > high ? high : x);
+}
+
+// a convex hull given by its vertices, xyz back to back.
+struct Hull
+{
+    const double* pts;
+    size_t count;
+};
+
+// the range of the hull on axis, relative to origin to keep the products small.
+void Project(const Hull& h, const double* origin, const double* axis, double& low, double& high)
+{
+    low = std::numeric_limits<double>::max();
+    high = -std::numeric_limits<double>::max();
+    for (size_t i = 0; i < h.count; ++i)
+    {
+        double d[3];
+        Sub(h.pts + 3 * i, origin, d);
+        const double x = Dot(d, axis);
+        low = std::min(low, x);
+        high = std::max(high, x);
+    }
+}
+
+// With touch set, hulls that only meet on the axis are separated by it,
+// unless both lie flat on it (coplanar faces).
+bool Separates(const Hull& h1, const Hull& h2, const double* axis, bool touch)
+{
+    double low1, high1, low2, high2;
+    Project(h1, h1.pts, axis, low1, high1);
+    Project(h2, h1.pts, axis, low2, high2);
+
+    if (high1 < low2 || high2 < low1) {
+        return true;
+    }
+    return touch && (high1 <= low2 || high2 <= low1) && !(low1 == high1 && low2 == high2);
+}
+
+// the normal of a planar convex polygon, Newell's method.
+void PolygonNormal(const double* verts, size_t count, double* n)
+{
+    n[0] = n[1] = n[2] = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double* u = verts + 3 * i;
+        const double* v = verts + 3 * ((i + 1) % count);
+        n[0] += (u[1] - v[1]) * (u[2] + v[2]);
+        n[1] += (u[2] - v[2]) * (u[0] + v[0]);
+        n[2] += (u[0] - v[0]) * (u[1] + v[1]);
+    }
+}
+
+inline void PolygonEdge(const double* verts, size_t count, size_t i, double* e)
+{
+    Sub(verts + 3 * ((i + 1) % count), verts + 3 * i, e);
+}
+
+}
+
+namespace spatialdb
+{
+
+double Math::Orient2D(const double* a, const double* b, const double* c)
+{
+    const double left = (a[0] - c[0]) * (b[1] - c[1]);
+    const double right = (a[1] - c[1]) * (b[0] - c[0]);
+    const double det = left - right;
+
+    const double bound = ORIENT2D_BOUND * (std::abs(left) + std::abs(right));
+    if (det > bound || -det > bound) {
+        return det;
+    }
+
+    // det(a - c, b - c) expanded into products of the input coordinates.
+    Expansion e;
+    e.AddProduct(a[0], b[1]);
+    e.AddProduct(-a[0], c[1]);
+    e.AddProduct(-a[1], b[0]);
+    e.AddProduct(a[1], c[0]);
+    e.AddProduct(b[0], c[1]);
+    e.AddProduct(-b[1], c[0]);
+    return e.Estimate();
+}
+
+double Math::Orient3D(const double* a, const double* b, const double* c, const double* d)
+{
+    double ad[3], bd[3], cd[3];
+    Sub(a, d, ad);
+    Sub(b, d, bd);
+    Sub(c, d, cd);
+
+    const double bc = bd[1] * cd[2] - bd[2] * cd[1];
+    const double ca = cd[1] * ad[2] - cd[2] * ad[1];
+    const double ab = ad[1] * bd[2] - ad[2] * bd[1];
+    const double det = ad[0] * bc + bd[0] * ca + cd[0] * ab;
+
+    const double permanent =
+        (std::abs(bd[1] * cd[2]) + std::abs(bd[2] * cd[1])) * std::abs(ad[0]) +
+        (std::abs(cd[1] * ad[2]) + std::abs(cd[2] * ad[1])) * std::abs(bd[0]) +
+        (std::abs(ad[1] * bd[2]) + std::abs(ad[2] * bd[1])) * std::abs(cd[0]);
+    const double bound = ORIENT3D_BOUND * permanent;
+    if (det > bound || -det > bound) {
+        return det;
+    }
+
+    // det(a - d, b - d, c - d) is the 4x4 determinant of the points with a
+    // column of ones, expanded along that column.
+    Expansion e;
+    AddDeterminant(e, b, c, d, -1.0);
+    AddDeterminant(e, a, c, d, 1.0);
+    AddDeterminant(e, a, b, d, -1.0);
+    AddDeterminant(e, a, b, c, 1.0);
+    return e.Estimate();
+}
+
+bool Math::PointOnSegment(const double* p, const double* a, const double* b)
+{
+    // a point off the line of a and b is off it in some coordinate plane.
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (OrientProjected(a, b, p, axis) != 0.0) {
+            return false;
+        }
+    }
+    return InBox(a, b, p, -1);
+}
+
+bool Math::PointInTriangle(const double* p, const double* a, const double* b, const double* c)
+{
+    if (Orient3D(a, b, c, p) != 0.0) {
+        return false;
+    }
+
+    // in the plane, dropping a coordinate the triangle does not collapse
+    // along keeps it one to one.
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int t = Sign(OrientProjected(a, b, c, axis));
+        if (t == 0) {
+            continue;
+        }
+        return Sign(OrientProjected(a, b, p, axis)) * t >= 0 &&
+            Sign(OrientProjected(b, c, p, axis)) * t >= 0 &&
+            Sign(OrientProjected(c, a, p, axis)) * t >= 0;
+    }
+
+    // a degenerate triangle is the segments between its corners.
+    return PointOnSegment(p, a, b) || PointOnSegment(p, b, c) || PointOnSegment(p, a, c);
+}
+
+bool Math::SegmentsIntersect(const double* p1, const double* q1, const double* p2, const double* q2)
+{
+    if (Orient3D(p1, q1, p2, q2) != 0.0) {
+        return false;
+    }
+
+    // coplanar, or degenerate. Dropping a coordinate the plane (or the
+    // line, or the point) does not run along keeps it one to one, so the
+    // segments meet if and only if their projections meet in all three
+    // coordinate planes.
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (!ProjectedSegmentsIntersect(p1, q1, p2, q2, axis)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Math::SegmentsTouch(const double* p1, const double* q1, const double* p2, const double* q2)
+{
+    if (!SegmentsIntersect(p1, q1, p2, q2)) {
+        return false;
+    }
+
+    // segments crossing at inner points of both are not touching.
+    if (!PointOnSegment(p2, p1, q1) && !PointOnSegment(q2, p1, q1) &&
+        !PointOnSegment(p1, p2, q2) && !PointOnSegment(q1, p2, q2)) {
+        return false;
+    }
+
+    // neither are collinear segments overlapping by more than a point.
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (OrientProjected(p1, q1, p2, axis) != 0.0 || OrientProjected(p1, q1, q2, axis) != 0.0) {
+            return true;
+        }
+    }
+
+    int k = 0;
+    for (int i = 1; i < 3; ++i)
+    {
+        if (std::abs(q1[i] - p1[i]) > std::abs(q1[k] - p1[k])) {
+            k = i;
+        }
+    }
+    const double low = std::max(std::min(p1[k], q1[k]), std::min(p2[k], q2[k]));
+    const double high = std::min(std::max(p1[k], q1[k]), std::max(p2[k], q2[k]));
+    return !(low < high);
+}
+
+bool Math::SegmentIntersectsBox(const double* p, const double* q, const double* low, const double* high, bool touch)
+{
+    // the part [t0, t1] of the segment p + t (q - p) within the slabs seen so far.
+    double t0 = 0.0, t1 = 1.0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const double dir = q[i] - p[i];
+        if (dir == 0.0)
+        {
+            if (touch ? (p[i] <= low[i] || p[i] >= high[i]) : (p[i] < low[i] || p[i] > high[i])) {
+                return false;
+            }
+            continue;
+        }
+
+        double ta = (low[i] - p[i]) / dir;
+        double tb = (high[i] - p[i]) / dir;
+        if (ta > tb) {
+            std::swap(ta, tb);
+        }
+        t0 = std::max(t0, ta);
+        t1 = std::min(t1, tb);
+        if (touch ? t0 >= t1 : t0 > t1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Math::PolygonIntersectsBox(const double* verts, size_t count, const double* low, const double* high, bool touch)
+{
+    // relative to the box center the box spans [-r, r] on an axis a, with
+    // r the sum of half[i] * |a[i]|.
+    double center[3], half[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        center[i] = (low[i] + high[i]) * 0.5;
+        half[i] = (high[i] - low[i]) * 0.5;
+    }
+
+    const Hull poly = { verts, count };
+    auto separates = [&](const double* axis)
+    {
+        double l, h;
+        Project(poly, center, axis, l, h);
+        const double r = half[0] * std::abs(axis[0]) + half[1] * std::abs(axis[1]) + half[2] * std::abs(axis[2]);
+
+        if (h < -r || r < l) {
+            return true;
+        }
+        return touch && (h <= -r || r <= l) && !(l == h && r == 0.0);
+    };
+
+    // box normals, polygon normal, the in-plane normals of the polygon
+    // edges and the crosses of the box and polygon edges.
+    const double units[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    for (int k = 0; k < 3; ++k)
+    {
+        if (separates(units[k])) {
+            return false;
+        }
+    }
+
+    double n[3], e[3], axis[3];
+    PolygonNormal(verts, count, n);
+    if (separates(n)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        PolygonEdge(verts, count, i, e);
+        Cross(n, e, axis);
+        if (separates(axis)) {
+            return false;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            Cross(units[k], e, axis);
+            if (separates(axis)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Math::PolygonsIntersect(const double* verts1, size_t count1, const double* verts2, size_t count2, bool touch)
+{
+    const Hull poly1 = { verts1, count1 };
+    const Hull poly2 = { verts2, count2 };
+
+    // both normals, the in-plane normals of all edges for coplanar
+    // polygons and the crosses of the edges.
+    double n1[3], n2[3], e1[3], e2[3], axis[3];
+    PolygonNormal(verts1, count1, n1);
+    PolygonNormal(verts2, count2, n2);
+    if (Separates(poly1, poly2, n1, touch) || Separates(poly1, poly2, n2, touch)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count1; ++i)
+    {
+        PolygonEdge(verts1, count1, i, e1);
+        Cross(n1, e1, axis);
+        if (Separates(poly1, poly2, axis, touch)) {
+            return false;
+        }
+    }
+
+    for (size_t j = 0; j < count2; ++j)
+    {
+        PolygonEdge(verts2, count2, j, e2);
+        Cross(n2, e2, axis);
+        if (Separates(poly1, poly2, axis, touch)) {
+            return false;
+        }
+        for (size_t i = 0; i < count1; ++i)
+        {
+            PolygonEdge(verts1, count1, i, e1);
+            Cross(e1, e2, axis);
+            if (Separates(poly1, poly2, axis, touch)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Math::SegmentIntersectsPolygon(const double* p, const double* q, const double* verts, size_t count, bool touch)
+{
+    const double seg_pts[6] = { p[0], p[1], p[2], q[0], q[1], q[2] };
+    const Hull seg = { seg_pts, 2 };
+    const Hull poly = { verts, count };
+
+    // polygon normal, the in-plane normals of the segment and the edges,
+    // and the crosses of the segment with the edges.
+    double n[3], d[3], e[3], axis[3];
+    PolygonNormal(verts, count, n);
+    Sub(q, p, d);
+    if (Separates(seg, poly, n, touch)) {
+        return false;
+    }
+
+    Cross(n, d, axis);
+    if (Separates(seg, poly, axis, touch)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        PolygonEdge(verts, count, i, e);
+        Cross(n, e, axis);
+        if (Separates(seg, poly, axis, touch)) {
+            return false;
+        }
+        Cross(d, e, axis);
+        if (Separates(seg, poly, axis, touch)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double Math::PointBoxDistanceSq(const double* p, const double* low, const double* high)
+{
+    double ret = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const double x = p[i] < low[i] ? low[i] - p[i] : (p[i] > high[i] ? p[i] - high[i] : 0.0);
+        ret += x * x;
+    }
+    return ret;
+}
+
+double Math::PointSegmentDistanceSq(const double* p, const double* a, const double* b)
+{
+    double ab[3], ap[3];
+    Sub(b, a, ab);
+    Sub(p, a, ap);
+
+    const double len = Dot(ab, ab);
+    const double t = len > 0.0 ? Clamp(Dot(ap, ab) / len, 0.0, 1.0) : 0.0;
+
+    double ret = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const double x = ap[i] - t * ab[i];
+        ret += x * x;
+    }
+    return ret;
+}
+
+double Math::PointTriangleDistanceSq(const double* p, const double* a, const double* b, const double* c)
+{
+    // the Voronoi region of p among the vertices, edges and the face.
+    double ab[3], ac[3], ap[3], bp[3], cp[3];
+    Sub(b, a, ab);
+    Sub(c, a, ac);
+    Sub(p, a, ap);
+
+    const double d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0) {
+        return Dot(ap, ap);
+    }
+
+    Sub(p, b, bp);
+    const double d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3) {
+        return Dot(bp, bp);
+    }
+
+    Sub(p, c, cp);
+    const double d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6) {
+        return Dot(cp, cp);
+    }
+
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        return PointSegmentDistanceSq(p, a, b);
+    }
+
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        return PointSegmentDistanceSq(p, a, c);
+    }
+
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0) {
+        return PointSegmentDistanceSq(p, b, c);
+    }
+
+    // inside the face, the distance to the plane.
+    double n[3];
+    Cross(ab, ac, n);
+    const double h = Dot(ap, n);
+    return h * h / Dot(n, n);
+}
+
+double Math::SegmentsDistanceSq(const double* p1, const double* q1, const double* p2, const double* q2)
+{
+    double d1[3], d2[3], r[3];
+    Sub(q1, p1, d1);
+    Sub(q2, p2, d2);
+    Sub(p1, p2, r);
+
+    const double a = Dot(d1, d1), e = Dot(d2, d2), f = Dot(d2, r);
+
+    // the parameters s on the first and t on the second segment of the
+    // closest points.
+    double s, t;
+    if (a <= 0.0 && e <= 0.0)
+    {
+        s = t = 0.0;
+    }
+    else if (a <= 0.0)
+    {
+        s = 0.0;
+        t = Clamp(f / e, 0.0, 1.0);
+    }
+    else
+    {
+        const double c = Dot(d1, r);
+        if (e <= 0.0)
+        {
+            t = 0.0;
+            s = Clamp(-c / a, 0.0, 1.0);
+        }
+        else
+        {
+            const double b = Dot(d1, d2);
+            const double denom = a * e - b * b;
+
+            s = denom > 0.0 ? Clamp((b * f - c * e) / denom, 0.0, 1.0) : 0.0;
+            t = (b * s + f) / e;
+
+            if (t < 0.0)
+            {
+                t = 0.0;
+                s = Clamp(-c / a, 0.0, 1.0);
+            }
+            else if (t > 1.0)
+            {
+                t = 1.0;
+                s = Clamp((b - c) / a, 0.0, 1.0);
+            }
+        }
+    }
+
+    double ret = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const double x = r[i] + s * d1[i] - t * d2[i];
+        ret += x * x;
+    }
+    return ret;
+}
+
+double Math::SegmentBoxDistanceSq(const double* p, const double* q, const double* low, const double* high)
+{
+    if (SegmentIntersectsBox(p, q, low, high)) {
+        return 0.0;
+    }
+
+    // disjoint, the closest points are an endpoint and the box or the
+    // segment and a box edge.
+    double corners[8][3];
+    for (int k = 0; k < 8; ++k) {
+        for (int i = 0; i < 3; ++i) {
+            corners[k][i] = (k & (1 << i)) ? high[i] : low[i];
+        }
+    }
+
+    double ret = std::min(PointBoxDistanceSq(p, low, high), PointBoxDistanceSq(q, low, high));
+    for (int k = 0; k < 8; ++k)
+    {
+        for (int d = 0; d < 3; ++d)
+        {
+            if (!(k & (1 << d))) {
+                ret = std::min(ret, SegmentsDistanceSq(p, q, corners[k], corners[k | (1 << d)]));
+            }
+        }
+    }
+    return ret;
+}
+
+double Math::SegmentTriangleDistanceSq(const double* p, const double* q, const double* a, const double* b, const double* c)
+{
+    const double tri[9] = { a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1], c[2] };
+    if (SegmentIntersectsPolygon(p, q, tri, 3)) {
+        return 0.0;
+    }
+
+    // disjoint, the closest points are on an endpoint or an edge.
+    double ret = std::min(PointTriangleDistanceSq(p, a, b, c), PointTriangleDistanceSq(q, a, b, c));
+    ret = std::min(ret, SegmentsDistanceSq(p, q, a, b));
+    ret = std::min(ret, SegmentsDistanceSq(p, q, b, c));
+    ret = std::min(ret, SegmentsDistanceSq(p, q, c, a));
+    return ret;
+}
+
+double Math::TrianglesDistanceSq(const double* a1, const double* b1, const double* c1, const double* a2, const double* b2, const double* c2)
+{
+    const double tri1[9] = { a1[0], a1[1], a1[2], b1[0], b1[1], b1[2], c1[0], c1[1], c1[2] };
+    const double tri2[9] = { a2[0], a2[1], a2[2], b2[0], b2[1], b2[2], c2[0], c2[1], c2[2] };
+    if (PolygonsIntersect(tri1, 3, tri2, 3)) {
+        return 0.0;
+    }
+
+    // disjoint, the closest points are a vertex and a face or two edges.
+    const double* t1[3] = { a1, b1, c1 };
+    const double* t2[3] = { a2, b2, c2 };
+
+    double ret = std::numeric_limits<double>::max();
+    for (int i = 0; i < 3; ++i)
+    {
+        ret = std::min(ret, PointTriangleDistanceSq(t1[i], a2, b2, c2));
+        ret = std::min(ret, PointTriangleDistanceSq(t2[i], a1, b1, c1));
+        for (int j = 0; j < 3; ++j) {
+            ret = std::min(ret, SegmentsDistanceSq(t1[i], t1[(i + 1) % 3], t2[j], t2[(j + 1) % 3]));
+        }
+    }
+    return ret;
+}
+
+double Math::TriangleBoxDistanceSq(const double* a, const double* b, const double* c, const double* low, const double* high)
+{
+    const double tri[9] = { a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1], c[2] };
+    if (PolygonIntersectsBox(tri, 3, low, high)) {
+        return 0.0;
+    }
+
+    // disjoint, the closest points are a vertex and a face or two edges.
+    const double* t[3] = { a, b, c };
+
+    double corners[8][3];
+    for (int k = 0; k < 8; ++k) {
+        for (int i = 0; i < 3; ++i) {
+            corners[k][i] = (k & (1 << i)) ? high[i] : low[i];
+        }
+    }
+
+    double ret = std::numeric_limits<double>::max();
+    for (int i = 0; i < 3; ++i) {
+        ret = std::min(ret, PointBoxDistanceSq(t[i], low, high));
+    }
+    for (int k = 0; k < 8; ++k)
+    {
+        ret = std::min(ret, PointTriangleDistanceSq(corners[k], a, b, c));
+
+        // the box edges leaving corner k upwards.
+        for (int d = 0; d < 3; ++d)
+        {
+            if (k & (1 << d)) {
+                continue;
+            }
+            for (int i = 0; i < 3; ++i) {
+                ret = std::min(ret, SegmentsDistanceSq(t[i], t[(i + 1) % 3], corners[k], corners[k | (1 << d)]));
+            }
+        }
+    }
+    return ret;
+}
+
+void Math::Lifted::Lift(const double* coords, size_t count, double z)
+{
+    double* out = m_inline;
+    if (3 * count > sizeof(m_inline) / sizeof(double))
+    {
+        m_heap.reset(new double[3 * count]);
+        out = m_heap.get();
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (int d = 0; d < 3; ++d) {
+            out[3 * i + d] = d < DIMENSION ? coords[DIMENSION * i + d] : z;
+        }
+    }
+    m_coords = out;
+}
+
+}
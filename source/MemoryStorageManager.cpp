@@ -96,4 +96,27 @@ void MemoryStorageManager::Flush()
 {
 }
 
+bool MemoryStorageManager::LoadByteArrayView(const id_type page, uint32_t& len, const uint8_t** data, std::shared_ptr<const void>& owner)
+{
+	Entry* e;
+	try
+	{
+		e = m_buffer.at(page);
+		if (e == nullptr) {
+			throw InvalidPageException(page);
+		}
+	}
+	catch (std::out_of_range&)
+	{
+		throw InvalidPageException(page);
+	}
+
+	// entries live until the page is stored again or deleted.
+	len = e->m_length;
+	*data = e->m_data;
+	owner.reset();
+
+	return true;
+}
+
 }
\ No newline at end of file
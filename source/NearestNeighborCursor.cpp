@@ -0,0 +1,302 @@
+#include "spatialdb/NearestNeighborCursor.h"
+#include "spatialdb/RTree.h"
+#include "spatialdb/Data.h"
+#include "spatialdb/Region.h"
+#include "spatialdb/Point.h"
+#include "spatialdb/MBRFilter.h"
+#include "spatialdb/ShapeType.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace spatialdb
+{
+
+//
+// class NearestNeighborCursor::Entry
+//
+
+NearestNeighborCursor::Entry::Entry(const std::shared_ptr<const NodeView>& node, uint32_t index)
+	: m_node(node)
+	, m_index(index)
+{
+}
+
+IObject* NearestNeighborCursor::Entry::Clone()
+{
+	Region mbr;
+	m_node->GetChildMBR(m_index, mbr);
+	uint32_t len;
+	const uint8_t* data = m_node->GetChildData(m_index, len);
+	return new Data(len, data, mbr, GetIdentifier());
+}
+
+id_type NearestNeighborCursor::Entry::GetIdentifier() const
+{
+	return m_node->GetChildIdentifier(m_index);
+}
+
+void NearestNeighborCursor::Entry::GetShape(IShape** out) const
+{
+	Region* r = new Region();
+	m_node->GetChildMBR(m_index, *r);
+	*out = r;
+}
+
+void NearestNeighborCursor::Entry::GetData(uint32_t& len, uint8_t** data) const
+{
+	const uint8_t* src = m_node->GetChildData(m_index, len);
+
+	*data = nullptr;
+	if (len > 0)
+	{
+		*data = new uint8_t[len];
+		memcpy(*data, src, len);
+	}
+}
+
+void NearestNeighborCursor::Entry::GetMBR(Region& out) const
+{
+	m_node->GetChildMBR(m_index, out);
+}
+
+const uint8_t* NearestNeighborCursor::Entry::GetData(uint32_t& len) const
+{
+	return m_node->GetChildData(m_index, len);
+}
+
+//
+// class NearestNeighborCursor
+//
+
+NearestNeighborCursor::NearestNeighborCursor(RTree& tree, const IShape& query)
+	: NearestNeighborCursor(tree, query, nullptr, nullptr, true)
+{
+}
+
+NearestNeighborCursor::NearestNeighborCursor(RTree& tree, const IShape& query, INearestNeighborComparator& nnc)
+	: NearestNeighborCursor(tree, query, &nnc, nullptr, true)
+{
+}
+
+NearestNeighborCursor::NearestNeighborCursor(RTree& tree, const IShape& query, INearestNeighborComparator* nnc, IVisitor* v, bool lock)
+	: m_tree(tree)
+	, m_lock(tree.m_lock, std::defer_lock)
+	, m_nnc(nnc)
+	, m_visitor(v)
+{
+	if (lock) {
+		m_lock.lock();
+	}
+	Reset(query);
+}
+
+const NearestNeighborCursor::Entry* NearestNeighborCursor::Next(double max_distance)
+{
+	// everything left is farther than m_prune once the top is.
+	while (!m_heap.empty() && m_heap.front().dist <= m_prune)
+	{
+		const double dist = m_squared ? std::sqrt(m_heap.front().dist) : m_heap.front().dist;
+		if (dist > max_distance) {
+			break;
+		}
+
+		std::pop_heap(m_heap.begin(), m_heap.end(), Farther);
+		const Item item = m_heap.back();
+		m_heap.pop_back();
+
+		if (item.leaf == NODE)
+		{
+			Expand(item.id);
+			continue;
+		}
+
+		m_current = Entry(m_leaves[item.leaf], item.child);
+		m_distance = dist;
+		++m_tree.m_stats.query_results;
+
+		return &m_current;
+	}
+
+	return nullptr;
+}
+
+void NearestNeighborCursor::SetLimit(uint32_t k)
+{
+	m_limit = k;
+	m_prune = std::numeric_limits<double>::max();
+	m_best.clear();
+}
+
+void NearestNeighborCursor::Reset(const IShape& query)
+{
+	m_query = &query;
+
+	m_squared = false;
+	if (m_nnc == nullptr && query.ShapeType() == ST_POINT)
+	{
+		const double* coords = static_cast<const Point&>(query).GetCoords();
+		std::copy(coords, coords + DIMENSION, m_low);
+		std::copy(coords, coords + DIMENSION, m_high);
+		m_squared = true;
+	}
+	else if (m_nnc == nullptr && query.ShapeType() == ST_REGION)
+	{
+		const Region& r = static_cast<const Region&>(query);
+		std::copy(r.GetLow(), r.GetLow() + DIMENSION, m_low);
+		std::copy(r.GetHigh(), r.GetHigh() + DIMENSION, m_high);
+		m_squared = true;
+	}
+	// quantized bounds are not touched by their content on every face.
+	m_minmax = m_squared && query.ShapeType() == ST_POINT && m_tree.m_tight_mbrs &&
+		m_tree.m_index_encoding == NodeEncoding::Plain;
+
+	m_prune = std::numeric_limits<double>::max();
+	m_best.clear();
+
+	m_heap.clear();
+	m_leaves.clear();
+	m_current = Entry();
+	m_distance = 0.0;
+
+	m_heap.push_back({ 0.0, m_tree.m_root_id, NODE, 0 });
+}
+
+bool NearestNeighborCursor::Farther(const Item& a, const Item& b)
+{
+	return a.dist > b.dist;
+}
+
+void NearestNeighborCursor::Expand(id_type page)
+{
+	NodeView n = m_tree.ReadNodeView(page);
+
+	if (m_visitor && m_visitor->VisitNode(n) != VisitorStatus::Continue)
+	{
+		// the MINMAXDIST bounds may have counted on entries under this
+		// node, only the queued data entries are certain from here on.
+		if (m_minmax)
+		{
+			m_minmax = false;
+			m_prune = m_limit > 0 && m_best.size() == m_limit ? m_best.front() : std::numeric_limits<double>::max();
+		}
+		return;
+	}
+
+	const uint32_t count = n.GetChildrenCount();
+	Region mbr;
+
+	if (m_squared)
+	{
+		m_dist.resize(count);
+		for (uint32_t base = 0; base < count; base += MBRFilter::BATCH)
+		{
+			const uint32_t batch = std::min(count - base, MBRFilter::BATCH);
+			MBRFilter::MinDistanceSq(n.GetChildLow(), n.GetChildHigh(), base, batch, m_low, m_high, &m_dist[base]);
+		}
+	}
+
+	if (n.IsIndex())
+	{
+		if (m_minmax && m_limit > 0)
+		{
+			// the children are disjoint from the pages read so far, their
+			// bounds and the queued data entries stand for distinct entries.
+			m_bounds.resize(count);
+			for (uint32_t base = 0; base < count; base += MBRFilter::BATCH)
+			{
+				const uint32_t batch = std::min(count - base, MBRFilter::BATCH);
+				MBRFilter::MinMaxDistanceSq(n.GetChildLow(), n.GetChildHigh(), base, batch, m_low, &m_bounds[base]);
+			}
+			Tighten();
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			double dist;
+			if (m_squared)
+			{
+				dist = m_dist[i];
+			}
+			else
+			{
+				n.GetChildMBR(i, mbr);
+				dist = m_nnc ? m_nnc->GetMinimumDistance(*m_query, mbr) : m_query->GetMinimumDistance(mbr);
+			}
+			Push(dist, n.GetChildIdentifier(i), NODE, 0);
+		}
+		return;
+	}
+
+	// leaves are kept until Reset, the queued entries point into them.
+	const uint32_t leaf = static_cast<uint32_t>(m_leaves.size());
+	m_leaves.push_back(std::make_shared<const NodeView>(std::move(n)));
+	const std::shared_ptr<const NodeView>& view = m_leaves.back();
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		double dist;
+		if (m_squared)
+		{
+			dist = m_dist[i];
+		}
+		else if (m_nnc)
+		{
+			// the comparator sees the entry in place, nothing is copied
+			// unless it asks for the shape or the payload.
+			Entry e(view, i);
+			dist = m_nnc->GetMinimumDistance(*m_query, e);
+		}
+		else
+		{
+			view->GetChildMBR(i, mbr);
+			dist = m_query->GetMinimumDistance(mbr);
+		}
+
+		if (dist > m_prune) {
+			continue;
+		}
+		Push(dist, view->GetChildIdentifier(i), leaf, i);
+
+		if (m_limit == 0) {
+			continue;
+		}
+		if (m_best.size() < m_limit)
+		{
+			m_best.push_back(dist);
+			std::push_heap(m_best.begin(), m_best.end());
+		}
+		else if (dist < m_best.front())
+		{
+			std::pop_heap(m_best.begin(), m_best.end());
+			m_best.back() = dist;
+			std::push_heap(m_best.begin(), m_best.end());
+		}
+		if (m_best.size() == m_limit) {
+			m_prune = std::min(m_prune, m_best.front());
+		}
+	}
+}
+
+void NearestNeighborCursor::Push(double dist, id_type id, uint32_t leaf, uint32_t child)
+{
+	if (dist > m_prune) {
+		return;
+	}
+	m_heap.push_back({ dist, id, leaf, child });
+	std::push_heap(m_heap.begin(), m_heap.end(), Farther);
+}
+
+void NearestNeighborCursor::Tighten()
+{
+	m_bounds.insert(m_bounds.end(), m_best.begin(), m_best.end());
+	if (m_bounds.size() < m_limit) {
+		return;
+	}
+
+	std::nth_element(m_bounds.begin(), m_bounds.begin() + (m_limit - 1), m_bounds.end());
+	m_prune = std::min(m_prune, m_bounds[m_limit - 1]);
+}
+
+}
@@ -8,6 +8,8 @@
 #include <exception>
 #include <string>
 #include <cmath>
+#include <cstring>
+#include <limits>
 
 #include <assert.h>
 
@@ -98,6 +100,42 @@ public:
 
 }; // ReinsertEntry
 
+// child MBRs as cells of the grid, T values in the layout of the coord_type
+// bounds: low[DIMENSION][children], then high[DIMENSION][children].
+template <class T>
+void StoreCells(const spatialdb::QuantizedGrid& grid, const Region* mbrs, uint32_t children, uint8_t* ptr)
+{
+	uint32_t cell_low[spatialdb::DIMENSION], cell_high[spatialdb::DIMENSION];
+	for (uint32_t i = 0; i < children; ++i)
+	{
+		grid.GetCells(mbrs[i].GetLow(), mbrs[i].GetHigh(), cell_low, cell_high);
+		for (int d = 0; d < spatialdb::DIMENSION; ++d)
+		{
+			const T l = static_cast<T>(cell_low[d]);
+			const T h = static_cast<T>(cell_high[d]);
+			memcpy(ptr + (d * children + i) * sizeof(T), &l, sizeof(T));
+			memcpy(ptr + ((spatialdb::DIMENSION + d) * children + i) * sizeof(T), &h, sizeof(T));
+		}
+	}
+}
+
+template <class T>
+void LoadCells(const spatialdb::QuantizedGrid& grid, Region* mbrs, uint32_t children, const uint8_t* ptr)
+{
+	for (uint32_t i = 0; i < children; ++i)
+	{
+		auto low = const_cast<double*>(mbrs[i].GetLow());
+		auto high = const_cast<double*>(mbrs[i].GetHigh());
+		for (int d = 0; d < spatialdb::DIMENSION; ++d)
+		{
+			T l, h;
+			memcpy(&l, ptr + (d * children + i) * sizeof(T), sizeof(T));
+			memcpy(&h, ptr + ((spatialdb::DIMENSION + d) * children + i) * sizeof(T), sizeof(T));
+			low[d] = grid.Bound(d, l);
+			high[d] = grid.Bound(d, h);
+		}
+	}
+}
 
 }
 
@@ -152,13 +190,7 @@ IObject* Node::Clone()
 
 uint32_t Node::GetByteArraySize() const
 {
-	return
-		sizeof(uint32_t) +
-		sizeof(uint32_t) +
-		sizeof(uint32_t) +
-		m_children * (DIMENSION * sizeof(double) * 2 + sizeof(id_type) + sizeof(uint32_t)) +
-		m_total_data_len +
-		2 * DIMENSION * sizeof(double);
+	return GetNodeSize(GetPageEncoding(), m_children, m_total_data_len);
 }
 
 void Node::LoadFromByteArray(const uint8_t* data)
@@ -172,23 +204,59 @@ void Node::LoadFromByteArray(const uint8_t* data)
 	memcpy(&m_level, ptr, sizeof(uint32_t));
 	ptr += sizeof(uint32_t);
 
-	memcpy(&m_children, ptr, sizeof(uint32_t));
+	uint32_t children;
+	memcpy(&children, ptr, sizeof(uint32_t));
 	ptr += sizeof(uint32_t);
 
-	for (int i = 0; i < m_children; ++i)
-	{
+	uint32_t format;
+	memcpy(&format, ptr, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+
+	// checked before the children are taken over, the destructor frees them.
+	if (!IsPageFormat(format)) {
+		throw IllegalStateException("Node: Unknown page format " + std::to_string(format >> 16) + ".");
+	}
+	m_children = children;
+	m_encoding = GetFormatEncoding(format);
+
+	for (int i = 0; i < m_children; ++i) {
 		m_children_mbr[i].MakeInfinite();
+	}
+
+	// child MBRs are stored coordinate-major, one array per bound and
+	// dimension. Cells are decoded once the node MBR is read.
+	const uint8_t* cells = ptr;
+	coord_type c;
+	if (m_encoding != NodeEncoding::Plain) {
+		ptr += QuantizedGrid::GetBoundsSize(m_encoding, m_children);
+	}
+	for (int d = 0; d < DIMENSION && m_encoding == NodeEncoding::Plain; ++d)
+	{
+		for (int i = 0; i < m_children; ++i)
+		{
+			memcpy(&c, ptr, sizeof(coord_type));
+			const_cast<double*>(m_children_mbr[i].GetLow())[d] = c;
+			ptr += sizeof(coord_type);
+		}
+	}
+	for (int d = 0; d < DIMENSION && m_encoding == NodeEncoding::Plain; ++d)
+	{
+		for (int i = 0; i < m_children; ++i)
+		{
+			memcpy(&c, ptr, sizeof(coord_type));
+			const_cast<double*>(m_children_mbr[i].GetHigh())[d] = c;
+			ptr += sizeof(coord_type);
+		}
+	}
 
-		memcpy(const_cast<double*>(m_children_mbr[i].GetLow()), ptr, DIMENSION * sizeof(double));
-		ptr += DIMENSION * sizeof(double);
-		memcpy(const_cast<double*>(m_children_mbr[i].GetHigh()), ptr, DIMENSION * sizeof(double));
-		ptr += DIMENSION * sizeof(double);
-		memcpy(&(m_children_id[i]), ptr, sizeof(id_type));
-		ptr += sizeof(id_type);
+	memcpy(m_children_id, ptr, m_children * sizeof(id_type));
+	ptr += m_children * sizeof(id_type);
 
-		memcpy(&(m_children_data_len[i]), ptr, sizeof(uint32_t));
-		ptr += sizeof(uint32_t);
+	memcpy(m_children_data_len, ptr, m_children * sizeof(uint32_t));
+	ptr += m_children * sizeof(uint32_t);
 
+	for (int i = 0; i < m_children; ++i)
+	{
 		if (m_children_data_len[i] > 0)
 		{
 			m_total_data_len += m_children_data_len[i];
@@ -202,10 +270,28 @@ void Node::LoadFromByteArray(const uint8_t* data)
 		}
 	}
 
-	memcpy(const_cast<double*>(m_node_mbr.GetLow()), ptr, DIMENSION * sizeof(double));
-	ptr += DIMENSION * sizeof(double);
-	memcpy(const_cast<double*>(m_node_mbr.GetHigh()), ptr, DIMENSION * sizeof(double));
-	//ptr += DIMENSION * sizeof(double);
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		memcpy(&c, ptr, sizeof(coord_type));
+		const_cast<double*>(m_node_mbr.GetLow())[d] = c;
+		ptr += sizeof(coord_type);
+	}
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		memcpy(&c, ptr, sizeof(coord_type));
+		const_cast<double*>(m_node_mbr.GetHigh())[d] = c;
+		ptr += sizeof(coord_type);
+	}
+
+	if (m_encoding != NodeEncoding::Plain)
+	{
+		const QuantizedGrid grid(m_node_mbr.GetLow(), m_node_mbr.GetHigh(), m_encoding);
+		if (m_encoding == NodeEncoding::Quantized8) {
+			LoadCells<uint8_t>(grid, m_children_mbr, m_children, cells);
+		} else {
+			LoadCells<uint16_t>(grid, m_children_mbr, m_children, cells);
+		}
+	}
 }
 
 void Node::StoreToByteArray(uint8_t** data, uint32_t& len) const
@@ -226,18 +312,58 @@ void Node::StoreToByteArray(uint8_t** data, uint32_t& len) const
 	memcpy(ptr, &m_children, sizeof(uint32_t));
 	ptr += sizeof(uint32_t);
 
-	for (int i = 0; i < m_children; ++i)
+	// the format and the encoding of the child MBRs, also keeps them 8-byte
+	// aligned.
+	const NodeEncoding encoding = GetPageEncoding();
+	const uint32_t format = MakePageFormat(encoding);
+	memcpy(ptr, &format, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+
+	// structure of arrays: low[DIMENSION][children], high[DIMENSION][children],
+	// ids[children], lengths[children], then the payloads back to back. The
+	// payload of an index entry is the uint64 count of its subtree. Bounds
+	// are coord_type, the MBRs in the tree are rounded to it on the way in
+	// (see Region::RoundOutward), so the conversion is exact.
+	coord_type c;
+	if (encoding != NodeEncoding::Plain)
+	{
+		const QuantizedGrid grid(m_node_mbr.GetLow(), m_node_mbr.GetHigh(), encoding);
+		const uint32_t size = QuantizedGrid::GetBoundsSize(encoding, m_children);
+		memset(ptr, 0, size);
+		if (encoding == NodeEncoding::Quantized8) {
+			StoreCells<uint8_t>(grid, m_children_mbr, m_children, ptr);
+		} else {
+			StoreCells<uint16_t>(grid, m_children_mbr, m_children, ptr);
+		}
+		ptr += size;
+	}
+	for (int d = 0; d < DIMENSION && encoding == NodeEncoding::Plain; ++d)
 	{
-		memcpy(ptr, m_children_mbr[i].GetLow(), DIMENSION * sizeof(double));
-		ptr += DIMENSION * sizeof(double);
-		memcpy(ptr, m_children_mbr[i].GetHigh(), DIMENSION * sizeof(double));
-		ptr += DIMENSION * sizeof(double);
-		memcpy(ptr, &(m_children_id[i]), sizeof(id_type));
-		ptr += sizeof(id_type);
+		for (int i = 0; i < m_children; ++i)
+		{
+			c = static_cast<coord_type>(m_children_mbr[i].GetLow()[d]);
+			memcpy(ptr, &c, sizeof(coord_type));
+			ptr += sizeof(coord_type);
+		}
+	}
+	for (int d = 0; d < DIMENSION && encoding == NodeEncoding::Plain; ++d)
+	{
+		for (int i = 0; i < m_children; ++i)
+		{
+			c = static_cast<coord_type>(m_children_mbr[i].GetHigh()[d]);
+			memcpy(ptr, &c, sizeof(coord_type));
+			ptr += sizeof(coord_type);
+		}
+	}
+
+	memcpy(ptr, m_children_id, m_children * sizeof(id_type));
+	ptr += m_children * sizeof(id_type);
 
-		memcpy(ptr, &(m_children_data_len[i]), sizeof(uint32_t));
-		ptr += sizeof(uint32_t);
+	memcpy(ptr, m_children_data_len, m_children * sizeof(uint32_t));
+	ptr += m_children * sizeof(uint32_t);
 
+	for (int i = 0; i < m_children; ++i)
+	{
 		if (m_children_data_len[i] > 0)
 		{
 			memcpy(ptr, m_children_data[i], m_children_data_len[i]);
@@ -246,12 +372,59 @@ void Node::StoreToByteArray(uint8_t** data, uint32_t& len) const
 	}
 
 	// store the node MBR for efficiency. This increases the node size a little bit.
-	memcpy(ptr, m_node_mbr.GetLow(), DIMENSION * sizeof(double));
-	ptr += DIMENSION * sizeof(double);
-	memcpy(ptr, m_node_mbr.GetHigh(), DIMENSION * sizeof(double));
-	//ptr += DIMENSION * sizeof(double);
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		c = static_cast<coord_type>(m_node_mbr.GetLow()[d]);
+		memcpy(ptr, &c, sizeof(coord_type));
+		ptr += sizeof(coord_type);
+	}
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		c = static_cast<coord_type>(m_node_mbr.GetHigh()[d]);
+		memcpy(ptr, &c, sizeof(coord_type));
+		ptr += sizeof(coord_type);
+	}
+
+	assert(len == static_cast<uint32_t>(ptr - *data));
+}
+
+uint32_t Node::GetNodeSize(NodeEncoding encoding, uint32_t children, uint32_t data_len)
+{
+	return
+		sizeof(uint32_t) +
+		sizeof(uint32_t) +
+		sizeof(uint32_t) +
+		sizeof(uint32_t) +
+		QuantizedGrid::GetBoundsSize(encoding, children) +
+		children * (sizeof(id_type) + sizeof(uint32_t)) +
+		data_len +
+		2 * DIMENSION * sizeof(coord_type);
+}
+
+NodeEncoding Node::GetPageEncoding() const
+{
+	// leaves stay exact, and a node MBR too wide to be cut into cells
+	// falls back to plain bounds.
+	if (m_level == 0 || m_tree->m_index_encoding == NodeEncoding::Plain ||
+		!QuantizedGrid::Fits(m_node_mbr.GetLow(), m_node_mbr.GetHigh())) {
+		return NodeEncoding::Plain;
+	}
+	return m_tree->m_index_encoding;
+}
 
-	assert(len == (ptr - *data) + DIMENSION * sizeof(double));
+size_t Node::GetMemorySize() const
+{
+	return
+		sizeof(Node) +
+		(m_capacity + 1) * (sizeof(id_type) + sizeof(uint8_t*) + sizeof(uint32_t) + sizeof(Region)) +
+		m_total_data_len;
+}
+
+void Node::EvictFromCache()
+{
+	if (m_identifier >= 0) {
+		m_tree->m_node_cache.Erase(m_identifier);
+	}
 }
 
 id_type Node::GetIdentifier() const
@@ -313,6 +486,8 @@ bool Node::IsLeaf() const
 
 void Node::InsertEntry(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id)
 {
+	EvictFromCache();
+
 	assert(m_children < m_capacity);
 
 	m_children_data_len[m_children] = data_len;
@@ -328,6 +503,8 @@ void Node::InsertEntry(uint32_t data_len, uint8_t* data, const Region& mbr, id_t
 
 void Node::DeleteEntry(uint32_t index)
 {
+	EvictFromCache();
+
 	assert(index >= 0 && index < m_children);
 
 	Region r = m_children_mbr[index];
@@ -360,18 +537,68 @@ void Node::DeleteEntry(uint32_t index)
 	}
 }
 
+bool Node::GetSubtreeCount(uint64_t& count) const
+{
+	if (m_level == 0)
+	{
+		count = m_children;
+		return true;
+	}
+
+	count = 0;
+	for (uint32_t i = 0; i < m_children; ++i)
+	{
+		if (m_children_data_len[i] != sizeof(uint64_t)) {
+			return false;
+		}
+		uint64_t c;
+		memcpy(&c, m_children_data[i], sizeof(uint64_t));
+		count += c;
+	}
+	return true;
+}
+
+uint8_t* Node::NewEntryData(uint32_t& len) const
+{
+	uint64_t count;
+	if (!GetSubtreeCount(count))
+	{
+		len = 0;
+		return nullptr;
+	}
+
+	len = sizeof(uint64_t);
+	uint8_t* data = new uint8_t[len];
+	memcpy(data, &count, len);
+	return data;
+}
+
+void Node::UpdateEntry(uint32_t child, const Node& n)
+{
+	EvictFromCache();
+
+	assert(child < m_children);
+
+	m_children_mbr[child] = n.m_node_mbr;
+
+	m_total_data_len -= m_children_data_len[child];
+	delete[] m_children_data[child];
+	m_children_data[child] = n.NewEntryData(m_children_data_len[child]);
+	m_total_data_len += m_children_data_len[child];
+}
+
 bool Node::InsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id, std::stack<id_type>& path_buf, uint8_t* overflow_tbl)
 {
 	if (m_children < m_capacity)
 	{
 		bool adjusted = false;
 
-		bool b = m_node_mbr.ContainsRegion(mbr);
-
 		InsertEntry(data_len, data, mbr, id);
 		m_tree->WriteNode(*this);
 
-		if (!b && !path_buf.empty())
+		// the parent entry counts the new entry even if the MBR still
+		// contains it.
+		if (!path_buf.empty())
 		{
 			id_type parent = path_buf.top(); path_buf.pop();
 			std::shared_ptr<Node> n = m_tree->ReadNode(parent);
@@ -503,8 +730,11 @@ bool Node::InsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_ty
 			m_tree->WriteNode(*nn);
 
 			std::shared_ptr<Node> ptr_r = std::make_shared<Index>(m_tree, m_tree->m_root_id, m_level + 1);
-			ptr_r->InsertEntry(0, nullptr, n->m_node_mbr, n->m_identifier);
-			ptr_r->InsertEntry(0, nullptr, nn->m_node_mbr, nn->m_identifier);
+			uint32_t len;
+			uint8_t* count = n->NewEntryData(len);
+			ptr_r->InsertEntry(len, count, n->m_node_mbr, n->m_identifier);
+			count = nn->NewEntryData(len);
+			ptr_r->InsertEntry(len, count, nn->m_node_mbr, nn->m_identifier);
 
 			m_tree->WriteNode(*ptr_r);
 
@@ -523,8 +753,8 @@ bool Node::InsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_ty
 			m_tree->WriteNode(*nn);
 
 			id_type c_parent = path_buf.top(); path_buf.pop();
-			std::shared_ptr<Node> n = m_tree->ReadNode(c_parent);
-			std::static_pointer_cast<Index>(n)->AdjustTree(n.get(), nn.get(), path_buf, overflow_tbl);
+			std::shared_ptr<Node> p = m_tree->ReadNode(c_parent);
+			std::static_pointer_cast<Index>(p)->AdjustTree(n.get(), nn.get(), path_buf, overflow_tbl);
 		}
 
 		return true;
@@ -533,6 +763,8 @@ bool Node::InsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_ty
 
 void Node::ReinsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id, std::vector<uint32_t>& reinsert, std::vector<uint32_t>& keep)
 {
+	EvictFromCache();
+
 	ReinsertEntry** v = new ReinsertEntry*[m_capacity + 1];
 
 	m_children_data_len[m_children] = data_len;
@@ -593,6 +825,8 @@ void Node::ReinsertData(uint32_t data_len, uint8_t* data, const Region& mbr, id_
 
 void Node::RTreeSplit(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id, std::vector<uint32_t>& group1, std::vector<uint32_t>& group2)
 {
+	EvictFromCache();
+
 	uint32_t minimum_load = static_cast<uint32_t>(std::floor(m_capacity * m_tree->m_fill_factor));
 
 	// use this mask array for marking visited entries.
@@ -743,6 +977,8 @@ void Node::RTreeSplit(uint32_t data_len, uint8_t* data, const Region& mbr, id_ty
 
 void Node::RStarSplit(uint32_t data_len, uint8_t* data, const Region& mbr, id_type id, std::vector<uint32_t>& group1, std::vector<uint32_t>& group2)
 {
+	EvictFromCache();
+
 	RStarSplitEntry** data_low = nullptr;
 	RStarSplitEntry** data_high = nullptr;
 
@@ -1054,8 +1290,9 @@ void Node::CondenseTree(std::stack<std::shared_ptr<Node>>& to_reinsert, std::sta
 		}
 		else
 		{
-			// adjust the entry in 'p' to contain the new bounding region of this node.
-			parent->m_children_mbr[child] = m_node_mbr;
+			// adjust the entry in 'p' to contain the new bounding region and
+			// count of this node.
+			parent->UpdateEntry(child, *this);
 
 			// global recalculation necessary since the MBR can only shrink in size,
 			// due to data removal.
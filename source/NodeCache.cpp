@@ -0,0 +1,119 @@
+#include "spatialdb/NodeCache.h"
+
+namespace spatialdb
+{
+
+NodeCache::NodeCache(size_t budget, uint32_t pinned_levels)
+	: m_budget(budget)
+	, m_pinned_levels(pinned_levels)
+{
+}
+
+std::shared_ptr<Node> NodeCache::Find(id_type page)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	auto itr = m_map.find(page);
+	if (itr == m_map.end()) {
+		return nullptr;
+	}
+
+	Entry& e = itr->second;
+	if (!e.pinned) {
+		m_lru.splice(m_lru.begin(), m_lru, e.lru);
+	}
+
+	return e.node;
+}
+
+void NodeCache::Insert(id_type page, const std::shared_ptr<Node>& n, size_t size, bool pinned)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	if (m_budget == 0) {
+		return;
+	}
+
+	Remove(page);
+
+	Entry e;
+	e.node = n;
+	e.size = size;
+	e.pinned = pinned;
+	if (!pinned)
+	{
+		m_lru.push_front(page);
+		e.lru = m_lru.begin();
+	}
+
+	m_map.insert({ page, e });
+	m_size += size;
+
+	Evict();
+}
+
+void NodeCache::Erase(id_type page)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	Remove(page);
+}
+
+void NodeCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_map.clear();
+	m_lru.clear();
+	m_size = 0;
+}
+
+void NodeCache::SetBudget(size_t budget)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_budget = budget;
+	if (m_budget == 0)
+	{
+		m_map.clear();
+		m_lru.clear();
+		m_size = 0;
+	}
+	else
+	{
+		Evict();
+	}
+}
+
+size_t NodeCache::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_size;
+}
+
+void NodeCache::Remove(id_type page)
+{
+	auto itr = m_map.find(page);
+	if (itr == m_map.end()) {
+		return;
+	}
+
+	if (!itr->second.pinned) {
+		m_lru.erase(itr->second.lru);
+	}
+
+	m_size -= itr->second.size;
+	m_map.erase(itr);
+}
+
+void NodeCache::Evict()
+{
+	while (m_size > m_budget && !m_lru.empty())
+	{
+		auto itr = m_map.find(m_lru.back());
+		m_size -= itr->second.size;
+		m_map.erase(itr);
+		m_lru.pop_back();
+	}
+}
+
+}
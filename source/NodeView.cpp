@@ -0,0 +1,301 @@
+#include "spatialdb/NodeView.h"
+#include "spatialdb/Exception.h"
+#include "spatialdb/MBRFilter.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <string>
+
+#include <assert.h>
+
+namespace
+{
+
+const uint32_t HEADER_SIZE = 4 * sizeof(uint32_t);
+const uint32_t MBR_SIZE = 2 * spatialdb::DIMENSION * sizeof(spatialdb::coord_type);
+const uint32_t ENTRY_SIZE = sizeof(spatialdb::id_type) + sizeof(uint32_t);
+
+// the cell arrays of a quantized page, in the layout of the coord_type bounds.
+// the MBRFilter test of the children on the T cells of a quantized page.
+template <bool Contained, class T>
+uint64_t CellMask(const uint8_t* cells, uint32_t children, uint32_t begin, uint32_t count,
+	const uint32_t* q_low, const uint32_t* q_high)
+{
+	using spatialdb::DIMENSION;
+	using spatialdb::MBRFilter;
+
+	auto base = reinterpret_cast<const T*>(cells);
+	const T* c_low[DIMENSION];
+	const T* c_high[DIMENSION];
+	T low[DIMENSION], high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		c_low[d] = base + d * children;
+		c_high[d] = base + (DIMENSION + d) * children;
+		low[d] = static_cast<T>(q_low[d]);
+		high[d] = static_cast<T>(q_high[d]);
+	}
+	return Contained
+		? MBRFilter::ContainedInCells(c_low, c_high, begin, count, low, high)
+		: MBRFilter::IntersectsCells(c_low, c_high, begin, count, low, high);
+}
+
+}
+
+namespace spatialdb
+{
+
+NodeView::NodeView(id_type id, uint32_t len, const uint8_t* data, const std::shared_ptr<const void>& owner)
+	: m_owner(owner)
+{
+	Reset(id, len, data);
+}
+
+IObject* NodeView::Clone()
+{
+	throw std::runtime_error("IObject::clone should never be called.");
+}
+
+uint32_t NodeView::GetByteArraySize() const
+{
+	return m_len;
+}
+
+void NodeView::LoadFromByteArray(const uint8_t* data)
+{
+	uint32_t children, format;
+	memcpy(&children, data + 2 * sizeof(uint32_t), sizeof(uint32_t));
+	memcpy(&format, data + 3 * sizeof(uint32_t), sizeof(uint32_t));
+	if (!IsPageFormat(format)) {
+		throw IllegalStateException("NodeView: Unknown page format " + std::to_string(format >> 16) + ".");
+	}
+	const NodeEncoding encoding = GetFormatEncoding(format);
+
+	// the length is not known up front, sum up the payloads.
+	const uint32_t bounds = QuantizedGrid::GetBoundsSize(encoding, children);
+	auto lens = data + HEADER_SIZE + bounds + children * sizeof(id_type);
+	uint32_t len = HEADER_SIZE + bounds + children * ENTRY_SIZE + MBR_SIZE;
+	for (uint32_t i = 0; i < children; ++i)
+	{
+		uint32_t l;
+		memcpy(&l, lens + i * sizeof(uint32_t), sizeof(uint32_t));
+		len += l;
+	}
+
+	m_owner.reset();
+	Reset(m_identifier, len, data);
+}
+
+void NodeView::StoreToByteArray(uint8_t** data, uint32_t& len) const
+{
+	len = m_len;
+	*data = new uint8_t[len];
+	memcpy(*data, m_data, len);
+}
+
+id_type NodeView::GetIdentifier() const
+{
+	return m_identifier;
+}
+
+void NodeView::GetShape(IShape** s) const
+{
+	*s = new Region(m_node_mbr);
+}
+
+uint32_t NodeView::GetChildrenCount() const
+{
+	return m_children;
+}
+
+id_type NodeView::GetChildIdentifier(uint32_t index) const
+{
+	assert(index < m_children);
+	return m_child_id[index];
+}
+
+void NodeView::GetChildShape(uint32_t index, IShape** out) const
+{
+	Region* r = new Region();
+	GetChildMBR(index, *r);
+	*out = r;
+}
+
+void NodeView::GetChildData(uint32_t index, uint32_t& length, uint8_t** data) const
+{
+	*data = const_cast<uint8_t*>(GetChildData(index, length));
+}
+
+uint32_t NodeView::GetLevel() const
+{
+	return m_level;
+}
+
+bool NodeView::IsIndex() const
+{
+	return m_level != 0;
+}
+
+bool NodeView::IsLeaf() const
+{
+	return m_level == 0;
+}
+
+void NodeView::GetChildMBR(uint32_t index, Region& out) const
+{
+	assert(index < m_children);
+
+	auto low = const_cast<double*>(out.GetLow());
+	auto high = const_cast<double*>(out.GetHigh());
+	if (m_encoding != NodeEncoding::Plain && m_decoded == nullptr)
+	{
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			low[d] = m_grid.Bound(d, GetCell(0, d, index));
+			high[d] = m_grid.Bound(d, GetCell(1, d, index));
+		}
+		return;
+	}
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		low[d] = m_child_low[d][index];
+		high[d] = m_child_high[d][index];
+	}
+}
+
+const uint8_t* NodeView::GetChildData(uint32_t index, uint32_t& length) const
+{
+	assert(index < m_children);
+
+	length = m_child_len[index];
+	return length > 0 ? m_payload + Seek(index) : nullptr;
+}
+
+template <bool Contained>
+uint64_t NodeView::Filter(uint32_t begin, uint32_t count, const double* low, const double* high) const
+{
+	if (m_encoding == NodeEncoding::Plain)
+	{
+		return Contained
+			? MBRFilter::ContainedIn(m_child_low, m_child_high, begin, count, low, high)
+			: MBRFilter::Intersects(m_child_low, m_child_high, begin, count, low, high);
+	}
+
+	uint32_t q_low[DIMENSION], q_high[DIMENSION];
+	if (!m_grid.GetQueryCells(low, high, q_low, q_high)) {
+		return 0;
+	}
+
+	return m_encoding == NodeEncoding::Quantized8
+		? CellMask<Contained, uint8_t>(m_cells, m_children, begin, count, q_low, q_high)
+		: CellMask<Contained, uint16_t>(m_cells, m_children, begin, count, q_low, q_high);
+}
+
+uint64_t NodeView::FilterIntersects(uint32_t begin, uint32_t count, const double* low, const double* high) const
+{
+	return Filter<false>(begin, count, low, high);
+}
+
+uint64_t NodeView::FilterContainedIn(uint32_t begin, uint32_t count, const double* low, const double* high) const
+{
+	return Filter<true>(begin, count, low, high);
+}
+
+void NodeView::DecodeCells() const
+{
+	m_decoded.reset(new coord_type[2 * DIMENSION * m_children]);
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		coord_type* low = m_decoded.get() + d * m_children;
+		coord_type* high = m_decoded.get() + (DIMENSION + d) * m_children;
+		for (uint32_t i = 0; i < m_children; ++i)
+		{
+			low[i] = static_cast<coord_type>(m_grid.Bound(d, GetCell(0, d, i)));
+			high[i] = static_cast<coord_type>(m_grid.Bound(d, GetCell(1, d, i)));
+		}
+		m_child_low[d] = low;
+		m_child_high[d] = high;
+	}
+}
+
+uint32_t NodeView::GetCell(int b, int dim, uint32_t index) const
+{
+	const uint32_t i = (b * DIMENSION + dim) * m_children + index;
+	if (m_encoding == NodeEncoding::Quantized8) {
+		return m_cells[i];
+	}
+	uint16_t c;
+	memcpy(&c, m_cells + i * sizeof(uint16_t), sizeof(uint16_t));
+	return c;
+}
+
+void NodeView::Reset(id_type id, uint32_t len, const uint8_t* data)
+{
+	assert(reinterpret_cast<uintptr_t>(data) % sizeof(double) == 0);
+
+	m_identifier = id;
+	m_data = data;
+	m_len = len;
+
+	memcpy(&m_level, data + sizeof(uint32_t), sizeof(uint32_t));
+	memcpy(&m_children, data + 2 * sizeof(uint32_t), sizeof(uint32_t));
+	uint32_t format;
+	memcpy(&format, data + 3 * sizeof(uint32_t), sizeof(uint32_t));
+	assert(IsPageFormat(format));
+	m_encoding = GetFormatEncoding(format);
+
+	// the node MBR is always the last field of the page.
+	coord_type node_mbr[2 * DIMENSION];
+	memcpy(node_mbr, data + len - MBR_SIZE, MBR_SIZE);
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const_cast<double*>(m_node_mbr.GetLow())[d] = node_mbr[d];
+		const_cast<double*>(m_node_mbr.GetHigh())[d] = node_mbr[DIMENSION + d];
+	}
+
+	m_decoded.reset();
+	if (m_encoding == NodeEncoding::Plain)
+	{
+		auto coords = reinterpret_cast<const coord_type*>(data + HEADER_SIZE);
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			m_child_low[d] = coords + d * m_children;
+			m_child_high[d] = coords + (DIMENSION + d) * m_children;
+		}
+		m_cells = nullptr;
+	}
+	else
+	{
+		m_grid = QuantizedGrid(m_node_mbr.GetLow(), m_node_mbr.GetHigh(), m_encoding);
+		m_cells = data + HEADER_SIZE;
+	}
+
+	auto ptr = data + HEADER_SIZE + QuantizedGrid::GetBoundsSize(m_encoding, m_children);
+	m_child_id = reinterpret_cast<const id_type*>(ptr);
+	ptr += m_children * sizeof(id_type);
+	m_child_len = reinterpret_cast<const uint32_t*>(ptr);
+	ptr += m_children * sizeof(uint32_t);
+	m_payload = ptr;
+
+	m_cursor_index = 0;
+	m_cursor_offset = 0;
+}
+
+uint32_t NodeView::Seek(uint32_t index) const
+{
+	assert(index < m_children);
+
+	if (index < m_cursor_index)
+	{
+		m_cursor_index = 0;
+		m_cursor_offset = 0;
+	}
+
+	while (m_cursor_index < index) {
+		m_cursor_offset += m_child_len[m_cursor_index++];
+	}
+
+	return m_cursor_offset;
+}
+
+}
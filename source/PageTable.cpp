@@ -0,0 +1,356 @@
+#include "spatialdb/PageTable.h"
+#include "spatialdb/Exception.h"
+#include "spatialdb/LogRecord.h"
+
+#include <filesystem>
+#include <cstring>
+
+namespace
+{
+
+// The log starts with a header (magic, page size) followed by the records.
+const uint64_t INDEX_MAGIC = 0x3158444942445053ull; // "SPDBIDX1"
+const uint32_t INDEX_HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+const uint64_t INDEX_COMPACT_SLACK = 64 * 1024;
+
+enum IndexRecordType : uint32_t
+{
+	IR_PUT_ENTRY = 1,
+	IR_DELETE_ENTRY,
+	IR_NEXT_PAGE
+};
+
+template <typename T>
+T Read(const uint8_t*& ptr)
+{
+	T v;
+	memcpy(&v, ptr, sizeof(T));
+	ptr += sizeof(T);
+	return v;
+}
+
+void PutEntryRecord(spatialdb::LogWriter& writer, spatialdb::id_type id, const spatialdb::PageTable::Entry& e)
+{
+	writer.Begin(IR_PUT_ENTRY);
+	writer.Append(id);
+	writer.Append(e.length);
+	writer.Append(static_cast<uint32_t>(e.pages.size()));
+	writer.Append(e.pages.data(), e.pages.size() * sizeof(spatialdb::id_type));
+	writer.End();
+}
+
+uint64_t EntryRecordSize(const spatialdb::PageTable::Entry& e)
+{
+	return spatialdb::LogWriter::HEADER_SIZE + sizeof(spatialdb::id_type) + 2 * sizeof(uint32_t) + e.pages.size() * sizeof(spatialdb::id_type);
+}
+
+}
+
+namespace spatialdb
+{
+
+PageTable::PageTable(const std::string& filename, bool overwrite, uint32_t page_size)
+	: m_filename(filename)
+{
+	std::ios_base::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+	if (overwrite || !std::filesystem::exists(filename)) {
+		mode |= std::ios::trunc;
+	}
+
+	m_file.open(filename.c_str(), mode);
+	if (m_file.fail()) {
+		throw IllegalStateException("PageTable: Could not open the storage manager index file.");
+	}
+
+	m_file.seekg(0, m_file.end);
+	const std::streamoff length = m_file.tellg();
+	m_file.seekg(0, m_file.beg);
+
+	if (overwrite || length == 0)
+	{
+		m_page_size = page_size;
+		m_compact = true;
+		return;
+	}
+
+	// one read, the records are decoded from memory.
+	std::vector<uint8_t> buf(static_cast<size_t>(length));
+	m_file.read(reinterpret_cast<char*>(buf.data()), length);
+	if (m_file.fail()) {
+		throw IllegalStateException("PageTable: Could not read the storage manager index file.");
+	}
+
+	uint64_t magic = 0;
+	if (buf.size() >= INDEX_HEADER_SIZE) {
+		memcpy(&magic, buf.data(), sizeof(uint64_t));
+	}
+
+	if (magic == INDEX_MAGIC) {
+		LoadLog(buf);
+	} else {
+		LoadLegacy(buf);
+	}
+
+	RebuildEmptyPages();
+	m_flushed_next_page = m_next_page;
+}
+
+void PageTable::Flush(bool sync)
+{
+	// rewrite the index once the log holds mostly superseded records.
+	if (m_compact || m_log_size > 2 * m_snapshot_size + INDEX_COMPACT_SLACK) {
+		WriteSnapshot();
+	} else if (AppendRecords() && sync) {
+		LogWriter::SyncFile(m_filename);
+	}
+}
+
+const PageTable::Entry* PageTable::Find(id_type id) const
+{
+	auto it = m_entries.find(id);
+	return it == m_entries.end() ? nullptr : &it->second;
+}
+
+void PageTable::Put(id_type id, Entry&& e)
+{
+	// entries replayed from a write-ahead log may use pages past the end.
+	for (auto page : e.pages) {
+		if (page >= m_next_page) {
+			m_next_page = page + 1;
+		}
+	}
+
+	m_snapshot_size += EntryRecordSize(e);
+
+	auto it = m_entries.find(id);
+	if (it != m_entries.end())
+	{
+		m_snapshot_size -= EntryRecordSize(it->second);
+		it->second = std::move(e);
+	}
+	else
+	{
+		m_entries.insert({ id, std::move(e) });
+	}
+
+	m_dirty_entries.insert(id);
+}
+
+void PageTable::Erase(id_type id)
+{
+	auto it = m_entries.find(id);
+	if (it == m_entries.end()) {
+		return;
+	}
+
+	m_snapshot_size -= EntryRecordSize(it->second);
+	m_entries.erase(it);
+
+	m_dirty_entries.insert(id);
+}
+
+id_type PageTable::AllocatePage()
+{
+	if (!m_empty_pages.empty())
+	{
+		const id_type page = *m_empty_pages.begin();
+		m_empty_pages.erase(m_empty_pages.begin());
+		return page;
+	}
+
+	return m_next_page++;
+}
+
+void PageTable::FreePage(id_type page)
+{
+	m_empty_pages.insert(page);
+}
+
+void PageTable::LoadLog(const std::vector<uint8_t>& buf)
+{
+	const uint8_t* ptr = buf.data() + sizeof(uint64_t);
+	m_page_size = Read<uint32_t>(ptr);
+
+	LogReader reader(buf.data() + INDEX_HEADER_SIZE, buf.size() - INDEX_HEADER_SIZE);
+
+	uint32_t type;
+	while (reader.Next(type))
+	{
+		switch (type)
+		{
+		case IR_PUT_ENTRY:
+		{
+			const id_type id = reader.Read<id_type>();
+			Entry e;
+			e.length = reader.Read<uint32_t>();
+			e.pages.resize(reader.Read<uint32_t>());
+			reader.Read(e.pages.data(), e.pages.size() * sizeof(id_type));
+			Put(id, std::move(e));
+		}
+			break;
+		case IR_DELETE_ENTRY:
+			Erase(reader.Read<id_type>());
+			break;
+		case IR_NEXT_PAGE:
+			m_next_page = reader.Read<id_type>();
+			break;
+		default:
+			throw IllegalStateException("PageTable: Corrupted storage manager index file.");
+		}
+	}
+
+	m_log_size = INDEX_HEADER_SIZE + reader.GetOffset();
+	m_dirty_entries.clear();
+
+	// the garbage after a torn append is dropped by rewriting the index.
+	if (m_log_size != buf.size()) {
+		m_compact = true;
+	}
+}
+
+void PageTable::LoadLegacy(const std::vector<uint8_t>& buf)
+{
+	// page size, next page, the free pages and the entries, without a header.
+	const uint8_t* ptr = buf.data();
+	const uint8_t* end = buf.data() + buf.size();
+	auto require = [&](size_t n) {
+		if (static_cast<size_t>(end - ptr) < n) {
+			throw IllegalStateException("PageTable: Corrupted storage manager index file.");
+		}
+	};
+
+	require(sizeof(uint32_t) + sizeof(id_type) + sizeof(uint32_t));
+	m_page_size = Read<uint32_t>(ptr);
+	m_next_page = Read<id_type>(ptr);
+
+	// the free pages are recomputed from the entries.
+	const uint32_t empty_count = Read<uint32_t>(ptr);
+	require(empty_count * sizeof(id_type) + sizeof(uint32_t));
+	ptr += empty_count * sizeof(id_type);
+
+	const uint32_t count = Read<uint32_t>(ptr);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		require(sizeof(id_type) + 2 * sizeof(uint32_t));
+		const id_type id = Read<id_type>(ptr);
+		Entry e;
+		e.length = Read<uint32_t>(ptr);
+		e.pages.resize(Read<uint32_t>(ptr));
+
+		require(e.pages.size() * sizeof(id_type));
+		memcpy(e.pages.data(), ptr, e.pages.size() * sizeof(id_type));
+		ptr += e.pages.size() * sizeof(id_type);
+
+		Put(id, std::move(e));
+	}
+
+	// converted to the log format on the next flush.
+	m_dirty_entries.clear();
+	m_compact = true;
+}
+
+void PageTable::RebuildEmptyPages()
+{
+	// free pages are every page below the next one that no entry uses.
+	std::vector<bool> used(static_cast<size_t>(m_next_page), false);
+	for (auto& pair : m_entries) {
+		for (auto page : pair.second.pages) {
+			if (page >= 0 && page < m_next_page) {
+				used[static_cast<size_t>(page)] = true;
+			}
+		}
+	}
+
+	m_empty_pages.clear();
+	for (id_type page = 0; page < m_next_page; ++page) {
+		if (!used[static_cast<size_t>(page)]) {
+			m_empty_pages.insert(m_empty_pages.end(), page);
+		}
+	}
+}
+
+bool PageTable::AppendRecords()
+{
+	if (m_dirty_entries.empty() && m_next_page == m_flushed_next_page) {
+		return false;
+	}
+
+	std::vector<uint8_t> buf;
+	LogWriter writer(buf);
+	for (auto id : m_dirty_entries)
+	{
+		auto it = m_entries.find(id);
+		if (it != m_entries.end())
+		{
+			PutEntryRecord(writer, id, it->second);
+		}
+		else
+		{
+			writer.Begin(IR_DELETE_ENTRY);
+			writer.Append(id);
+			writer.End();
+		}
+	}
+
+	writer.Begin(IR_NEXT_PAGE);
+	writer.Append(m_next_page);
+	writer.End();
+
+	m_file.seekp(m_log_size, std::ios_base::beg);
+	m_file.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+	m_file.flush();
+	if (m_file.fail()) {
+		throw IllegalStateException("PageTable: Could not write the storage manager index file.");
+	}
+
+	m_log_size += buf.size();
+	m_dirty_entries.clear();
+	m_flushed_next_page = m_next_page;
+
+	return true;
+}
+
+void PageTable::WriteSnapshot()
+{
+	std::vector<uint8_t> buf;
+	buf.reserve(INDEX_HEADER_SIZE + LogWriter::HEADER_SIZE + sizeof(id_type) + m_snapshot_size);
+
+	LogWriter writer(buf);
+	writer.Append(INDEX_MAGIC);
+	writer.Append(m_page_size);
+
+	writer.Begin(IR_NEXT_PAGE);
+	writer.Append(m_next_page);
+	writer.End();
+
+	for (auto& pair : m_entries) {
+		PutEntryRecord(writer, pair.first, pair.second);
+	}
+
+	// written next to the index and renamed over it, a crash leaves either
+	// the old or the new index behind.
+	const std::string tmp_file = m_filename + ".tmp";
+	{
+		std::ofstream fout(tmp_file.c_str(), std::ios::binary | std::ios::trunc);
+		fout.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+		fout.flush();
+		if (fout.fail()) {
+			throw IllegalStateException("PageTable: Could not write the storage manager index file.");
+		}
+	}
+	LogWriter::SyncFile(tmp_file);
+
+	m_file.close();
+	std::filesystem::rename(tmp_file, m_filename);
+	m_file.open(m_filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (m_file.fail()) {
+		throw IllegalStateException("PageTable: Could not open the storage manager index file.");
+	}
+
+	m_log_size = buf.size();
+	m_dirty_entries.clear();
+	m_flushed_next_page = m_next_page;
+	m_compact = false;
+}
+
+}
@@ -1,5 +1,7 @@
 #include "spatialdb/Point.h"
 #include "spatialdb/Region.h"
+#include "spatialdb/Edge.h"
+#include "spatialdb/Face.h"
 #include "spatialdb/ShapeType.h"
 
 #include <cmath>
@@ -78,6 +80,18 @@ bool Point::IntersectsShape(const IShape& s) const
 		return r.ContainsPoint(*this);
 	}
 
+	if (s.ShapeType() == ST_EDGE)
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		return e.ContainsPoint(*this);
+	}
+
+	if (s.ShapeType() == ST_FACE)
+	{
+		const Face& f = static_cast<const Face&>(s);
+		return f.ContainsPoint(*this);
+	}
+
 	return false;
 }
 
@@ -98,6 +112,18 @@ bool Point::TouchesShape(const IShape& s) const
 		ret = *this == p;
 	}
 		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = e.TouchesShape(*this);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.TouchesShape(*this);
+	}
+		break;
 	case ST_REGION:
 	{
 		const Region& r = static_cast<const Region&>(s);
@@ -136,6 +162,18 @@ double Point::GetMinimumDistance(const IShape& s) const
 		ret = GetMinimumDistance(p);
 	}
 		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = e.GetMinimumDistance(*this);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.GetMinimumDistance(*this);
+	}
+		break;
 	case ST_REGION:
 	{
 		const Region& r = static_cast<const Region&>(s);
@@ -151,8 +189,10 @@ double Point::GetMinimumDistance(const Point& p) const
 {
 	double ret = 0.0;
 
-	for (int i = 0; i < DIMENSION; ++i) {
-		ret += std::pow(m_coords[i] - p.m_coords[i], 2.0);
+	for (int i = 0; i < DIMENSION; ++i)
+	{
+		const double x = m_coords[i] - p.m_coords[i];
+		ret += x * x;
 	}
 
 	return std::sqrt(ret);
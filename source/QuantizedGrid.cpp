@@ -0,0 +1,131 @@
+#include "spatialdb/QuantizedGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <assert.h>
+
+namespace spatialdb
+{
+
+QuantizedGrid::QuantizedGrid(const double* low, const double* high, NodeEncoding encoding)
+{
+	assert(encoding != NodeEncoding::Plain);
+
+	m_steps = encoding == NodeEncoding::Quantized8 ? UINT8_MAX : UINT16_MAX;
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		m_low[d] = low[d];
+		m_high[d] = high[d];
+		m_step[d] = (high[d] - low[d]) / m_steps;
+	}
+}
+
+bool QuantizedGrid::Fits(const double* low, const double* high)
+{
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		if (!(low[d] <= high[d]) || !std::isfinite(high[d] - low[d])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t QuantizedGrid::GetBoundsSize(NodeEncoding encoding, uint32_t children)
+{
+	switch (encoding)
+	{
+	case NodeEncoding::Quantized8:
+		return (2 * DIMENSION * children * sizeof(uint8_t) + 7) & ~7u;
+	case NodeEncoding::Quantized16:
+		return (2 * DIMENSION * children * sizeof(uint16_t) + 7) & ~7u;
+	default:
+		return 2 * DIMENSION * children * sizeof(coord_type);
+	}
+}
+
+int64_t QuantizedGrid::Below(int dim, double x) const
+{
+	if (!(x >= m_low[dim])) {
+		return -1;
+	}
+	if (x >= m_high[dim]) {
+		return m_steps;
+	}
+	return Split(dim, x, true);
+}
+
+int64_t QuantizedGrid::Above(int dim, double x) const
+{
+	if (!(x <= m_high[dim])) {
+		return int64_t(m_steps) + 1;
+	}
+	if (x <= m_low[dim]) {
+		return 0;
+	}
+	return Split(dim, x, false) + 1;
+}
+
+void QuantizedGrid::GetCells(const double* low, const double* high, uint32_t* cell_low, uint32_t* cell_high) const
+{
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		cell_low[d] = static_cast<uint32_t>(std::max<int64_t>(Below(d, low[d]), 0));
+		cell_high[d] = static_cast<uint32_t>(std::min<int64_t>(Above(d, high[d]), m_steps));
+	}
+}
+
+bool QuantizedGrid::GetQueryCells(const double* low, const double* high, uint32_t* cell_low, uint32_t* cell_high) const
+{
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		const int64_t l = Above(d, low[d]);
+		const int64_t h = Below(d, high[d]);
+		if (l > m_steps || h < 0) {
+			return false;
+		}
+		cell_low[d] = static_cast<uint32_t>(l);
+		cell_high[d] = static_cast<uint32_t>(h);
+	}
+	return true;
+}
+
+int64_t QuantizedGrid::Split(int dim, double x, bool inclusive) const
+{
+	auto passes = [&](int64_t q)
+	{
+		const double b = Bound(dim, static_cast<uint32_t>(q));
+		return inclusive ? b <= x : b < x;
+	};
+
+	// the cell of x is exact but for rounding, so it and its neighbors are
+	// probed before the rest is bisected.
+	const double t = (x - m_low[dim]) / m_step[dim];
+	const int64_t guess = static_cast<int64_t>(std::min(std::max(t, 0.0), double(m_steps)));
+
+	int64_t lo = 0, hi = m_steps;
+	for (int64_t q : { guess, guess + 1, guess - 1 })
+	{
+		if (q > lo && q < hi)
+		{
+			if (passes(q)) {
+				lo = q;
+			} else {
+				hi = q;
+			}
+		}
+	}
+	while (hi - lo > 1)
+	{
+		const int64_t mid = lo + (hi - lo) / 2;
+		if (passes(mid)) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+}
@@ -1,13 +1,23 @@
 #include "spatialdb/RTree.h"
+#include "spatialdb/Data.h"
 #include "spatialdb/Node.h"
 #include "spatialdb/Index.h"
 #include "spatialdb/Leaf.h"
+#include "spatialdb/NodeView.h"
+#include "spatialdb/NearestNeighborCursor.h"
 #include "spatialdb/Exception.h"
-#include "spatialdb/IdVisitor.h"
+#include "spatialdb/IdSink.h"
+#include "spatialdb/MBRFilter.h"
+#include "spatialdb/ShapeType.h"
 
 #include <iostream>
+#include <algorithm>
 #include <queue>
+#include <bitset>
 #include <map>
+#include <cstring>
+#include <limits>
+#include <string>
 
 #include <assert.h>
 
@@ -16,32 +26,31 @@ namespace
 
 using namespace spatialdb;
 
-class Data : public IData, public ISerializable
+// the header starts with its magic and layout version.
+const uint32_t HEADER_MAGIC = 0x45455254; // "TREE"
+const uint32_t HEADER_VERSION = 1;
+
+// a leaf entry read in place, valid as long as its node. Clone copies it
+// into a Data.
+class ChildData : public IData
 {
 public:
-	Data(uint32_t len, uint8_t* data, Region& r, id_type id)
-		: m_id(id)
-		, m_region(r)
-		, m_data(nullptr)
-		, m_data_len(len)
-	{
-		if (m_data_len > 0)
-		{
-			m_data = new uint8_t[m_data_len];
-			memcpy(m_data, data, m_data_len);
-		}
-	}
-	virtual ~Data() 
+	ChildData(const NodeView& n, uint32_t index)
+		: m_node(n)
+		, m_index(index)
 	{
-		delete[] m_data;
 	}
 
 	//
 	// IObject interface
 	//
-	virtual Data* Clone() override
+	virtual IObject* Clone() override
 	{
-		return new Data(m_data_len, m_data, m_region, m_id);
+		Region mbr;
+		m_node.GetChildMBR(m_index, mbr);
+		uint32_t len;
+		const uint8_t* data = m_node.GetChildData(m_index, len);
+		return new Data(len, data, mbr, GetIdentifier());
 	}
 
 	//
@@ -49,11 +58,13 @@ public:
 	//
 	virtual id_type GetIdentifier() const override
 	{
-		return m_id;
+		return m_node.GetChildIdentifier(m_index);
 	}
 	virtual void GetShape(IShape** out) const override
 	{
-		*out = new Region(m_region);
+		Region* r = new Region();
+		m_node.GetChildMBR(m_index, *r);
+		*out = r;
 	}
 
 	//
@@ -61,119 +72,298 @@ public:
 	//
 	virtual void GetData(uint32_t& len, uint8_t** data) const override
 	{
-		len = m_data_len;
-		*data = nullptr;
+		const uint8_t* src = m_node.GetChildData(m_index, len);
 
-		if (m_data_len > 0)
+		*data = nullptr;
+		if (len > 0)
 		{
-			*data = new uint8_t[m_data_len];
-			memcpy(*data, m_data, m_data_len);
+			*data = new uint8_t[len];
+			memcpy(*data, src, len);
 		}
 	}
 
-	//
-	// ISerializable interface
-	//
-	virtual uint32_t GetByteArraySize() const override
+private:
+	const NodeView& m_node;
+	uint32_t m_index;
+
+}; // ChildData
+
+// hands the hits of a query to a visitor, as ChildData read in place, or
+// to a sink at the detail it asks for. A Count sink gets the total from
+// Finish.
+class ResultWriter
+{
+public:
+	ResultWriter(IVisitor* v, IResultSink* sink)
+		: m_visitor(v)
+		, m_sink(sink)
+		, m_detail(v ? ResultDetail::Entry : sink->GetDetail())
 	{
-		return
-			sizeof(id_type) +
-			sizeof(uint32_t) +
-			m_data_len +
-			m_region.GetByteArraySize();
 	}
-	virtual void LoadFromByteArray(const uint8_t* data) override
-	{
-		auto ptr = data;
 
-		memcpy(&m_id, ptr, sizeof(id_type));
-		ptr += sizeof(id_type);
+	void Add(const NodeView& n, uint32_t i)
+	{
+		++m_count;
 
-		delete[] m_data;
-		m_data = nullptr;
+		if (m_visitor)
+		{
+			ChildData d(n, i);
+			m_visitor->VisitData(d);
+			return;
+		}
 
-		memcpy(&m_data_len, ptr, sizeof(uint32_t));
-		ptr += sizeof(uint32_t);
+		switch (m_detail)
+		{
+		case ResultDetail::Count:
+			break;
+		case ResultDetail::Identifier:
+			m_sink->AddIdentifier(n.GetChildIdentifier(i));
+			break;
+		case ResultDetail::Entry:
+		{
+			n.GetChildMBR(i, m_mbr);
+			uint32_t len;
+			const uint8_t* data = n.GetChildData(i, len);
+			m_sink->AddEntry(n.GetChildIdentifier(i), m_mbr, data, len);
+		}
+			break;
+		}
+	}
 
-		if (m_data_len > 0)
+	// children base + bit of the mask.
+	void Add(const NodeView& n, uint32_t base, uint64_t mask)
+	{
+		if (m_detail == ResultDetail::Count)
 		{
-			m_data = new uint8_t[m_data_len];
-			memcpy(m_data, ptr, m_data_len);
-			ptr += m_data_len;
+			m_count += std::bitset<64>(mask).count();
+			return;
+		}
+		while (mask != 0) {
+			Add(n, base + MBRFilter::NextBit(mask));
 		}
+	}
 
-		m_region.LoadFromByteArray(ptr);
+	// returns the number of results.
+	uint64_t Finish()
+	{
+		if (m_sink && m_detail == ResultDetail::Count && m_count > 0) {
+			m_sink->AddCount(m_count);
+		}
+		return m_count;
 	}
-	virtual void StoreToByteArray(uint8_t** data, uint32_t& len) const override
+
+private:
+	IVisitor* m_visitor;
+	IResultSink* m_sink;
+	ResultDetail m_detail;
+	uint64_t m_count = 0;
+	Region m_mbr;
+
+}; // ResultWriter
+
+// children [base, base + 64) of the node whose MBR intersects, or lies
+// inside, the box r.
+uint64_t FilterChildren(const NodeView& n, uint32_t base, const Region& r, bool contained)
+{
+	const uint32_t count = std::min(MBRFilter::BATCH, n.GetChildrenCount() - base);
+	if (contained) {
+		return n.FilterContainedIn(base, count, r.GetLow(), r.GetHigh());
+	} else {
+		return n.FilterIntersects(base, count, r.GetLow(), r.GetHigh());
+	}
+}
+
+// the number of data entries below index entry i, false if the entry was
+// written before the subtree counts were kept.
+bool SubtreeCount(const NodeView& n, uint32_t i, uint64_t& count)
+{
+	uint32_t len;
+	const uint8_t* data = n.GetChildData(i, len);
+	if (len != sizeof(uint64_t)) {
+		return false;
+	}
+	memcpy(&count, data, sizeof(uint64_t));
+	return true;
+}
+
+// indices of the children of n intersecting r, ordered by the low
+// coordinate of the first dimension.
+void SortedChildren(const NodeView& n, const Region& r, std::vector<uint32_t>& out)
+{
+	out.clear();
+	for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
 	{
-		// it is thread safe this way.
-		uint32_t regionsize;
-		uint8_t* regiondata = nullptr;
-		m_region.StoreToByteArray(&regiondata, regionsize);
+		for (uint64_t mask = FilterChildren(n, base, r, false); mask != 0; ) {
+			out.push_back(base + MBRFilter::NextBit(mask));
+		}
+	}
 
-		len = sizeof(id_type) + sizeof(uint32_t) + m_data_len + regionsize;
+	const coord_type* low = n.GetChildLow(0);
+	std::sort(out.begin(), out.end(), [low](uint32_t a, uint32_t b) { return low[a] < low[b]; });
+}
 
-		*data = new uint8_t[len];
-		uint8_t* ptr = *data;
+// whether child i of n1 and child j of n2 intersect in the dimensions
+// after the first.
+bool IntersectsAfterFirst(const NodeView& n1, uint32_t i, const NodeView& n2, uint32_t j)
+{
+	for (int d = 1; d < DIMENSION; ++d)
+	{
+		if (n1.GetChildLow(d)[i] > n2.GetChildHigh(d)[j] || n1.GetChildHigh(d)[i] < n2.GetChildLow(d)[j]) {
+			return false;
+		}
+	}
+	return true;
+}
 
-		memcpy(ptr, &m_id, sizeof(id_type));
-		ptr += sizeof(id_type);
-		memcpy(ptr, &m_data_len, sizeof(uint32_t));
-		ptr += sizeof(uint32_t);
+// pairs of intersecting children of n1 and n2 inside r, found by a sweep
+// along the first dimension over both sorted child lists instead of
+// testing every pair.
+void SweepPairs(const NodeView& n1, const NodeView& n2, const Region& r,
+	std::vector<uint32_t>& s1, std::vector<uint32_t>& s2, std::vector<std::pair<uint32_t, uint32_t>>& out)
+{
+	out.clear();
+	SortedChildren(n1, r, s1);
+	SortedChildren(n2, r, s2);
 
-		if (m_data_len > 0)
+	const coord_type* low1 = n1.GetChildLow(0);
+	const coord_type* high1 = n1.GetChildHigh(0);
+	const coord_type* low2 = n2.GetChildLow(0);
+	const coord_type* high2 = n2.GetChildHigh(0);
+
+	size_t a = 0, b = 0;
+	while (a < s1.size() && b < s2.size())
+	{
+		if (low1[s1[a]] <= low2[s2[b]])
 		{
-			memcpy(ptr, m_data, m_data_len);
-			ptr += m_data_len;
+			const uint32_t i = s1[a++];
+			for (size_t k = b; k < s2.size() && low2[s2[k]] <= high1[i]; ++k)
+			{
+				if (IntersectsAfterFirst(n1, i, n2, s2[k])) {
+					out.emplace_back(i, s2[k]);
+				}
+			}
+		}
+		else
+		{
+			const uint32_t j = s2[b++];
+			for (size_t k = a; k < s1.size() && low1[s1[k]] <= high2[j]; ++k)
+			{
+				if (IntersectsAfterFirst(n1, s1[k], n2, j)) {
+					out.emplace_back(s1[k], j);
+				}
+			}
 		}
-
-		memcpy(ptr, regiondata, regionsize);
-		delete[] regiondata;
-		// ptr += regionsize;
 	}
+}
 
-private:
-	id_type m_id;
-	Region m_region;
-	uint8_t* m_data = nullptr;
-	uint32_t m_data_len = 0;
+// the unordered pairs of distinct intersecting children of n inside r,
+// each once.
+void SweepPairs(const NodeView& n, const Region& r, std::vector<uint32_t>& sorted, std::vector<std::pair<uint32_t, uint32_t>>& out)
+{
+	out.clear();
+	SortedChildren(n, r, sorted);
+
+	const coord_type* low = n.GetChildLow(0);
+	const coord_type* high = n.GetChildHigh(0);
 
-}; // Data
+	for (size_t a = 0; a < sorted.size(); ++a)
+	{
+		const uint32_t i = sorted[a];
+		for (size_t k = a + 1; k < sorted.size() && low[sorted[k]] <= high[i]; ++k)
+		{
+			if (IntersectsAfterFirst(n, i, n, sorted[k])) {
+				out.emplace_back(i, sorted[k]);
+			}
+		}
+	}
+}
 
-class NNEntry
+// the buffers of a join walk.
+struct JoinState
 {
-public:
-	id_type m_id;
-	IEntry* m_entry;
-	double m_min_dist;
+	std::vector<uint32_t> s1, s2;
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	Region window;
+};
+
+// joins one pair of nodes of t1 and t2. Child pairs that need to be joined
+// go to push(id1, id2), a pair of leaves gives report(n1, n2, pairs). The
+// taller of two nodes on different levels is descended alone.
+template <class Push, class Report>
+void JoinNodes(RTree& t1, RTree& t2, id_type id1, id_type id2, JoinState& js, Push&& push, Report&& report)
+{
+	NodeView n1 = t1.ReadNodeView(id1);
+	NodeView n2 = t2.ReadNodeView(id2);
+
+	if (!n1.GetRegion().IntersectsRegion(n2.GetRegion())) {
+		return;
+	}
+	js.window = n1.GetRegion().GetIntersectingRegion(n2.GetRegion());
 
-	NNEntry(id_type id, IEntry* e, double f) 
-		: m_id(id)
-		, m_entry(e)
-		, m_min_dist(f) 
+	if (n1.GetLevel() > n2.GetLevel())
 	{
+		SortedChildren(n1, js.window, js.s1);
+		for (uint32_t i : js.s1) {
+			push(n1.GetChildIdentifier(i), id2);
+		}
+		return;
+	}
+	if (n2.GetLevel() > n1.GetLevel())
+	{
+		SortedChildren(n2, js.window, js.s2);
+		for (uint32_t j : js.s2) {
+			push(id1, n2.GetChildIdentifier(j));
+		}
+		return;
 	}
-	~NNEntry() = default;
 
-}; // NNEntry
+	SweepPairs(n1, n2, js.window, js.s1, js.s2, js.pairs);
+	if (js.pairs.empty()) {
+		return;
+	}
 
-class NNComparator : public INearestNeighborComparator
-{
-public:
-	double GetMinimumDistance(const IShape& query, const IShape& entry) 
+	if (n1.GetLevel() == 0)
 	{
-		return query.GetMinimumDistance(entry);
+		report(n1, n2, js.pairs);
+		return;
+	}
+	for (const auto& p : js.pairs) {
+		push(n1.GetChildIdentifier(p.first), n2.GetChildIdentifier(p.second));
 	}
+}
+
+// interleaves the bits of the MBR center, scaled to the extent.
+uint64_t ZOrder(const Region& r, const Region& extent)
+{
+	const int BITS = 63 / DIMENSION;
 
-	double GetMinimumDistance(const IShape& query, const IData& data) 
+	uint64_t cell[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
 	{
-		IShape* pS;
-		data.GetShape(&pS);
-		double ret = query.GetMinimumDistance(*pS);
-		delete pS;
-		return ret;
+		const double size = extent.GetHigh()[d] - extent.GetLow()[d];
+		const double center = (r.GetLow()[d] + r.GetHigh()[d]) / 2.0;
+		const double t = size > 0.0 ? (center - extent.GetLow()[d]) / size : 0.0;
+		cell[d] = static_cast<uint64_t>(std::min(std::max(t, 0.0), 1.0) * ((uint64_t(1) << BITS) - 1));
+	}
+
+	uint64_t key = 0;
+	for (int b = BITS - 1; b >= 0; --b) {
+		for (int d = 0; d < DIMENSION; ++d) {
+			key = (key << 1) | ((cell[d] >> b) & 1);
+		}
 	}
-}; // NNComparator
+	return key;
+}
+
+// the most entries with payload bytes each that fit in a node of size bytes.
+uint32_t FitCapacity(uint32_t size, NodeEncoding encoding, uint32_t payload)
+{
+	uint32_t n = 0;
+	while (Node::GetNodeSize(encoding, n + 1, (n + 1) * payload) <= size) {
+		++n;
+	}
+	return n;
+}
 
 }
 
@@ -184,22 +374,35 @@ RTree::RTree(const std::shared_ptr<IStorageManager>& sm, bool overwrite)
 	: m_storage_mgr(sm)
 {
 	if (overwrite) {
-		InitNew();
+		InitNew(RTreeOptions());
 	} else {
 		InitOld();
 	}
 }
 
+RTree::RTree(const std::shared_ptr<IStorageManager>& sm, const RTreeOptions& options)
+	: m_storage_mgr(sm)
+{
+	InitNew(options);
+}
+
 RTree::~RTree()
 {
+	StoreDirtyPages();
 	StoreHeader();
 }
 
 void RTree::InsertData(uint32_t len, const uint8_t* data, const IShape& shape, id_type shape_id)
 {
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	CheckPayload(len);
+
 	// convert the shape into a Region (R-Trees index regions only; i.e., approximations of the shapes).
 	Region mbr;
 	shape.GetMBR(mbr);
+	mbr.RoundOutward();
+	CheckMBR(mbr);
 
 	uint8_t* buffer = nullptr;
 	if (len > 0)
@@ -210,36 +413,45 @@ void RTree::InsertData(uint32_t len, const uint8_t* data, const IShape& shape, i
 
 	InsertDataImpl(len, buffer, mbr, shape_id);
 		// the buffer is stored in the tree. Do not delete here.
+
+	Commit();
 }
 
 bool RTree::DeleteData(const IShape& shape, id_type shape_id)
 {
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
 	Region mbr;
 	shape.GetMBR(mbr);
+	mbr.RoundOutward();
+
+	const bool ret = DeleteDataImpl(mbr, shape_id);
+	Commit();
 
-	return DeleteDataImpl(mbr, shape_id);
+	return ret;
 }
 
 void RTree::LevelTraversal(IVisitor& v)
 {
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
 	try
 	{
-		std::stack<std::shared_ptr<Node>> st;
-		std::shared_ptr<Node> root = ReadNode(m_root_id);
-		st.push(root);
+		std::stack<NodeView> st;
+		st.push(ReadNodeView(m_root_id));
 
 		while (!st.empty())
 		{
-			std::shared_ptr<Node> n = st.top(); st.pop();
+			NodeView n = std::move(st.top()); st.pop();
 
-			VisitorStatus status = v.VisitNode(*n);
+			VisitorStatus status = v.VisitNode(n);
 
-			if (n->IsIndex())
+			if (n.IsIndex())
 			{
 				if (status == VisitorStatus::Continue)
 				{
-					for (int i = 0; i < n->m_children; ++i) {
-						st.push(ReadNode(n->m_children_id[i]));
+					for (uint32_t i = 0; i < n.GetChildrenCount(); ++i) {
+						st.push(ReadNodeView(n.GetChildIdentifier(i)));
 					}
 				}
 			}
@@ -254,52 +466,60 @@ void RTree::LevelTraversal(IVisitor& v)
 
 void RTree::InternalNodesQuery(const IShape& query, IVisitor& v)
 {
-#ifdef HAVE_PTHREAD_H
-	Tools::LockGuard lock(&m_lock);
-#endif
+	std::shared_lock<std::shared_mutex> lock(m_lock);
 
 	try
 	{
-		std::stack<std::shared_ptr<Node>> st;
-		std::shared_ptr<Node> root = ReadNode(m_root_id);
-		st.push(root);
+		// the box filter is exact for region queries, other shapes test the candidates.
+		const bool exact = query.ShapeType() == ST_REGION;
+		Region query_mbr;
+		query.GetMBR(query_mbr);
+
+		std::stack<NodeView> st;
+		st.push(ReadNodeView(m_root_id));
 
+		Region mbr;
 		while (!st.empty())
 		{
-			std::shared_ptr<Node> n = st.top(); st.pop();
+			NodeView n = std::move(st.top()); st.pop();
 
-			if (query.ContainsShape(n->m_node_mbr))
+			if (query.ContainsShape(n.GetRegion()))
 			{
-				IdVisitor v_id = IdVisitor();
-				VisitSubTree(n, v_id);
-				const uint64_t n_obj = v_id.GetResultCount();
-				uint64_t* obj = new uint64_t[n_obj];
-				std::copy(v_id.GetResults().begin(), v_id.GetResults().end(), obj);
+				IdSink ids;
+				VisitSubTree(n, nullptr, &ids);
+				const uint64_t n_obj = ids.GetResultCount();
 
-				Data data = Data((uint32_t)(sizeof(uint64_t) * n_obj), (uint8_t*)obj, n->m_node_mbr, n->GetIdentifier());
+				Data data = Data((uint32_t)(sizeof(id_type) * n_obj), (const uint8_t*)ids.GetResults().data(), n.GetRegion(), n.GetIdentifier());
 				v.VisitData(data);
 				++m_stats.query_results;
 			}
 			else
 			{
-				if (n->m_level == 0)
+				if (n.GetLevel() == 0)
 				{
-					for (int i = 0; i < n->m_children; ++i)
+					for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
 					{
-						if (query.ContainsShape(n->m_children_mbr[i]))
+						uint64_t mask = FilterChildren(n, base, query_mbr, true);
+						while (mask != 0)
 						{
-							Data data = Data(sizeof(id_type), (uint8_t*)&n->m_children_id[i], n->m_children_mbr[i], n->GetIdentifier());
-							v.VisitData(data);
-							++m_stats.query_results;
+							const uint32_t i = base + MBRFilter::NextBit(mask);
+							n.GetChildMBR(i, mbr);
+							if (exact || query.ContainsShape(mbr))
+							{
+								const id_type id = n.GetChildIdentifier(i);
+								Data data = Data(sizeof(id_type), (const uint8_t*)&id, mbr, n.GetIdentifier());
+								v.VisitData(data);
+								++m_stats.query_results;
+							}
 						}
 					}
 				}
 				else
 				{
-					if (query.IntersectsShape(n->m_node_mbr))
+					if (query.IntersectsShape(n.GetRegion()))
 					{
-						for (int i = 0; i < n->m_children; ++i) {
-							st.push(ReadNode(n->m_children_id[i]));
+						for (uint32_t i = 0; i < n.GetChildrenCount(); ++i) {
+							st.push(ReadNodeView(n.GetChildIdentifier(i)));
 						}
 					}
 				}
@@ -315,162 +535,398 @@ void RTree::InternalNodesQuery(const IShape& query, IVisitor& v)
 
 void RTree::ContainsWhatQuery(const IShape& query, IVisitor& v)
 {
-	try
-	{
-		std::stack<std::shared_ptr<Node>> st;
-		std::shared_ptr<Node> root = ReadNode(m_root_id);
-		st.push(root);
-
-		while (!st.empty())
-		{
-			std::shared_ptr<Node> n = st.top(); st.pop();
+	std::shared_lock<std::shared_mutex> lock(m_lock);
 
-			if (n->m_level == 0)
-			{
-				v.VisitNode(*n);
+	ContainsWhatQueryImpl(query, &v, nullptr);
+}
 
-				for (int i = 0; i < n->m_children; ++i)
-				{
-					if (query.ContainsShape(n->m_children_mbr[i]))
-					{
-						Data data = Data(n->m_children_data_len[i], n->m_children_data[i], n->m_children_mbr[i], n->m_children_id[i]);
-						v.VisitData(data);
-						++m_stats.query_results;
-					}
-				}
-			}
-			else
-			{
-				if (query.ContainsShape(n->m_node_mbr))
-				{
-					VisitSubTree(n, v);
-				}
-				else if (query.IntersectsShape(n->m_node_mbr))
-				{
-					VisitorStatus status = v.VisitNode(*n);
-					if (status == VisitorStatus::Continue)
-					{
-						for (int i = 0; i < n->m_children; ++i) {
-							if (query.IntersectsShape(n->m_children_mbr[i])) {
-								st.push(ReadNode(n->m_children_id[i]));
-							}
-						}
-					}
-				}
-			}
-		}
+void RTree::ContainsWhatQuery(const IShape& query, IResultSink& sink)
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
 
-	}
-	catch (...)
-	{
-		throw;
+	if (sink.GetDetail() == ResultDetail::Count) {
+		CountQuery(ContainmentQuery, query, sink);
+	} else {
+		ContainsWhatQueryImpl(query, nullptr, &sink);
 	}
 }
 
 void RTree::IntersectsWithQuery(const IShape& query, IVisitor& v)
 {
-	RangeQuery(IntersectionQuery, query, v);
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	RangeQuery(IntersectionQuery, query, &v, nullptr);
+}
+
+void RTree::IntersectsWithQuery(const IShape& query, IResultSink& sink)
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	if (sink.GetDetail() == ResultDetail::Count) {
+		CountQuery(IntersectionQuery, query, sink);
+	} else {
+		RangeQuery(IntersectionQuery, query, nullptr, &sink);
+	}
 }
 
 void RTree::PointLocationQuery(const Point& query, IVisitor& v)
 {
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
 	Region r(query, query);
-	RangeQuery(IntersectionQuery, r, v);
+	RangeQuery(IntersectionQuery, r, &v, nullptr);
 }
 
-void RTree::NearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc)
+void RTree::PointLocationQuery(const Point& query, IResultSink& sink)
 {
-	auto ascending = [](const NNEntry* lhs, const NNEntry* rhs) 
-	{ 
-		return lhs->m_min_dist > rhs->m_min_dist;  
-	};
-	std::priority_queue<NNEntry*, std::vector<NNEntry*>, decltype(ascending)> queue(ascending);
+	std::shared_lock<std::shared_mutex> lock(m_lock);
 
-	queue.push(new NNEntry(m_root_id, nullptr, 0.0));
+	Region r(query, query);
+	if (sink.GetDetail() == ResultDetail::Count) {
+		CountQuery(IntersectionQuery, r, sink);
+	} else {
+		RangeQuery(IntersectionQuery, r, nullptr, &sink);
+	}
+}
 
-	uint32_t count = 0;
-	double knearest = 0.0;
+void RTree::AggregateQuery(RangeQueryType type, const IShape& query, Aggregate& out)
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	out.mbr.MakeInfinite();
+	AggregateQueryImpl(type, query, out.count, &out.mbr);
+}
+
+void RTree::IntersectsWithQueries(size_t count, const IShape* const* queries, IVisitor* const* visitors)
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	if (count == 0) {
+		return;
+	}
 
-	while (!queue.empty())
+	std::vector<Region> mbrs(count);
+	Region extent;
+	extent.MakeInfinite();
+	for (size_t j = 0; j < count; ++j)
 	{
-		NNEntry* pFirst = queue.top();
+		queries[j]->GetMBR(mbrs[j]);
+		extent.Combine(mbrs[j]);
+	}
 
-		// report all nearest neighbors with equal greatest distances.
-		// (neighbors can be more than k, if many happen to have the same greatest distance).
-		if (count >= k && pFirst->m_min_dist > knearest) {
-			break;
+	// bit positions follow the Z-order of the query centers, the queries
+	// active below a node then share few bitset words.
+	std::vector<std::pair<uint64_t, uint32_t>> keys(count);
+	for (size_t j = 0; j < count; ++j) {
+		keys[j] = std::make_pair(ZOrder(mbrs[j], extent), static_cast<uint32_t>(j));
+	}
+	std::sort(keys.begin(), keys.end());
+
+	// the query MBRs in bit order and coordinate-major, MBRFilter tests a
+	// child MBR against 64 of them per call.
+	std::vector<double> bounds(2 * DIMENSION * count);
+	const double* q_low[DIMENSION];
+	const double* q_high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		q_low[d] = &bounds[d * count];
+		q_high[d] = &bounds[(DIMENSION + d) * count];
+	}
+
+	std::vector<uint32_t> order(count);
+	std::vector<bool> exact(count);
+	for (size_t q = 0; q < count; ++q)
+	{
+		order[q] = keys[q].second;
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			bounds[d * count + q] = mbrs[order[q]].GetLow()[d];
+			bounds[(DIMENSION + d) * count + q] = mbrs[order[q]].GetHigh()[d];
 		}
+		exact[q] = queries[order[q]]->ShapeType() == ST_REGION;
+	}
+
+	// pages to visit with the bitsets of their active queries, the bitsets
+	// are stacked in masks in the same order.
+	const size_t words = (count + MBRFilter::BATCH - 1) / MBRFilter::BATCH;
+	std::vector<id_type> st;
+	std::vector<uint64_t> masks;
+	std::vector<uint64_t> active(words);
+
+	st.push_back(m_root_id);
+	masks.resize(words, ~uint64_t(0));
+	if (count % MBRFilter::BATCH != 0) {
+		masks.back() = (uint64_t(1) << (count % MBRFilter::BATCH)) - 1;
+	}
 
-		queue.pop();
+	// per child, the hits of the non zero words of active.
+	std::vector<size_t> active_words;
+	std::vector<uint64_t> hits;
 
-		if (pFirst->m_entry == nullptr)
+	uint64_t results = 0;
+	Region mbr;
+	double low[DIMENSION], high[DIMENSION];
+
+	while (!st.empty())
+	{
+		NodeView n = ReadNodeView(st.back()); st.pop_back();
+		std::copy(masks.end() - words, masks.end(), active.begin());
+		masks.resize(masks.size() - words);
+
+		const bool leaf = n.GetLevel() == 0;
+		size_t queries_active = 0;
+		active_words.clear();
+		for (size_t w = 0; w < words; ++w)
 		{
-			// n is a leaf or an index.
-			std::shared_ptr<Node> n = ReadNode(pFirst->m_id);
+			for (uint64_t m = active[w]; m != 0; )
+			{
+				const uint32_t j = MBRFilter::NextBit(m);
+				const VisitorStatus status = visitors[order[w * MBRFilter::BATCH + j]]->VisitNode(n);
+				if (!leaf && status != VisitorStatus::Continue) {
+					active[w] &= ~(uint64_t(1) << j);
+				}
+			}
+			if (active[w] != 0)
+			{
+				active_words.push_back(w);
+				queries_active += std::bitset<64>(active[w]).count();
+			}
+		}
 
-			VisitorStatus status = v.VisitNode(*n);
+		const size_t children = n.GetChildrenCount();
+		const size_t k_words = active_words.size();
+		if (k_words == 0 || children == 0) {
+			continue;
+		}
+		hits.assign(children * k_words, 0);
 
-			if (status == VisitorStatus::Continue)
+		// each child against 64 queries, or each query against 64
+		// children, whichever takes fewer MBRFilter calls.
+		const size_t child_batches = (children + MBRFilter::BATCH - 1) / MBRFilter::BATCH;
+		if (children * k_words <= queries_active * child_batches)
+		{
+			for (size_t i = 0; i < children; ++i)
+			{
+				for (int d = 0; d < DIMENSION; ++d)
+				{
+					low[d] = n.GetChildLow(d)[i];
+					high[d] = n.GetChildHigh(d)[i];
+				}
+				for (size_t k = 0; k < k_words; ++k)
+				{
+					const size_t w = active_words[k];
+					const uint32_t batch = static_cast<uint32_t>(std::min<size_t>(MBRFilter::BATCH, count - w * MBRFilter::BATCH));
+					hits[i * k_words + k] = active[w] & MBRFilter::Intersects(q_low, q_high, static_cast<uint32_t>(w * MBRFilter::BATCH), batch, low, high);
+				}
+			}
+		}
+		else
+		{
+			for (size_t k = 0; k < k_words; ++k)
 			{
-				for (int i = 0; i < n->m_children; ++i)
+				const size_t w = active_words[k];
+				for (uint64_t m = active[w]; m != 0; )
 				{
-					if (n->m_level == 0)
+					const uint32_t j = MBRFilter::NextBit(m);
+					const size_t q = w * MBRFilter::BATCH + j;
+					for (int d = 0; d < DIMENSION; ++d)
 					{
-						Data* e = new Data(n->m_children_data_len[i], n->m_children_data[i], n->m_children_mbr[i], n->m_children_id[i]);
-						// we need to compare the query with the actual data entry here, so we call the
-						// appropriate getMinimumDistance method of NearestNeighborComparator.
-						queue.push(new NNEntry(n->m_children_id[i], e, nnc.GetMinimumDistance(query, *e)));
+						low[d] = q_low[d][q];
+						high[d] = q_high[d][q];
 					}
-					else
+					for (uint32_t base = 0; base < children; base += MBRFilter::BATCH)
 					{
-						queue.push(new NNEntry(n->m_children_id[i], nullptr, nnc.GetMinimumDistance(query, n->m_children_mbr[i])));
+						const uint32_t batch = std::min<uint32_t>(MBRFilter::BATCH, static_cast<uint32_t>(children) - base);
+						for (uint64_t c = MBRFilter::Intersects(n.GetChildLow(), n.GetChildHigh(), base, batch, low, high); c != 0; ) {
+							hits[(base + MBRFilter::NextBit(c)) * k_words + k] |= uint64_t(1) << j;
+						}
 					}
 				}
 			}
 		}
-		else
+
+		for (uint32_t i = 0; i < children; ++i)
 		{
-			v.VisitData(*(static_cast<IData*>(pFirst->m_entry)));
-			++m_stats.query_results;
-			++count;
-			knearest = pFirst->m_min_dist;
-			delete pFirst->m_entry;
-		}
+			uint64_t* child_hits = &hits[i * k_words];
+			if (std::all_of(child_hits, child_hits + k_words, [](uint64_t m) { return m == 0; })) {
+				continue;
+			}
 
-		delete pFirst;
-	}
+			n.GetChildMBR(i, mbr);
 
-	while (!queue.empty())
-	{
-		NNEntry* e = queue.top(); queue.pop();
-		if (e->m_entry != nullptr) delete e->m_entry;
-		delete e;
+			// other shapes than regions test the candidates exactly.
+			bool hit = false;
+			for (size_t k = 0; k < k_words; ++k)
+			{
+				for (uint64_t m = child_hits[k]; m != 0; )
+				{
+					const uint32_t j = MBRFilter::NextBit(m);
+					const size_t q = active_words[k] * MBRFilter::BATCH + j;
+					if (!exact[q] && !queries[order[q]]->IntersectsShape(mbr)) {
+						child_hits[k] &= ~(uint64_t(1) << j);
+					}
+				}
+				hit = hit || child_hits[k] != 0;
+			}
+			if (!hit) {
+				continue;
+			}
+
+			if (!leaf)
+			{
+				st.push_back(n.GetChildIdentifier(i));
+				masks.resize(masks.size() + words, 0);
+				for (size_t k = 0; k < k_words; ++k) {
+					masks[masks.size() - words + active_words[k]] = child_hits[k];
+				}
+				continue;
+			}
+
+			ChildData d(n, i);
+			for (size_t k = 0; k < k_words; ++k)
+			{
+				for (uint64_t m = child_hits[k]; m != 0; )
+				{
+					visitors[order[active_words[k] * MBRFilter::BATCH + MBRFilter::NextBit(m)]]->VisitData(d);
+					++results;
+				}
+			}
+		}
 	}
+
+	m_stats.query_results += results;
+}
+
+void RTree::NearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc)
+{
+	NearestNeighborQuery(k, query, v, &nnc);
 }
 
 void RTree::NearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v)
 {
-	NNComparator nnc;
-	NearestNeighborQuery(k, query, v, nnc);
+	NearestNeighborQuery(k, query, v, nullptr);
 }
 
 void RTree::SelfJoinQuery(const IShape& query, IVisitor& v)
 {
-	Region mbr;
-	query.GetMBR(mbr);
-	
-	SelfJoinQuery(m_root_id, m_root_id, mbr, v);
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	Region r;
+	query.GetMBR(r);
+
+	// node pairs to join, a node paired with itself stands for the pairs
+	// among its own subtree. Every unordered pair of entries is reported once.
+	std::vector<std::pair<id_type, id_type>> st;
+	st.emplace_back(m_root_id, m_root_id);
+
+	JoinState js;
+	std::vector<const IData*> entries(2);
+	uint64_t results = 0;
+
+	while (!st.empty())
+	{
+		const auto ids = st.back(); st.pop_back();
+		const bool same = ids.first == ids.second;
+
+		NodeView n1 = ReadNodeView(ids.first);
+		NodeView n2 = same ? n1 : ReadNodeView(ids.second);
+		v.VisitNode(n1);
+		if (!same) {
+			v.VisitNode(n2);
+		}
+
+		if (!r.IntersectsRegion(n1.GetRegion()) || !r.IntersectsRegion(n2.GetRegion()) ||
+			!n1.GetRegion().IntersectsRegion(n2.GetRegion())) {
+			continue;
+		}
+		js.window = r.GetIntersectingRegion(n1.GetRegion().GetIntersectingRegion(n2.GetRegion()));
+
+		if (same) {
+			SweepPairs(n1, js.window, js.s1, js.pairs);
+		} else {
+			SweepPairs(n1, n2, js.window, js.s1, js.s2, js.pairs);
+		}
+
+		if (n1.GetLevel() > 0)
+		{
+			if (same) {
+				for (uint32_t i : js.s1) {
+					st.emplace_back(n1.GetChildIdentifier(i), n1.GetChildIdentifier(i));
+				}
+			}
+			for (const auto& p : js.pairs) {
+				st.emplace_back(n1.GetChildIdentifier(p.first), n2.GetChildIdentifier(p.second));
+			}
+			continue;
+		}
+
+		for (const auto& p : js.pairs)
+		{
+			ChildData e1(n1, p.first), e2(n2, p.second);
+			if (e1.GetIdentifier() == e2.GetIdentifier()) {
+				continue;
+			}
+			entries[0] = &e1;
+			entries[1] = &e2;
+			v.VisitData(entries);
+			++results;
+		}
+	}
+
+	m_stats.query_results += results;
+}
+
+void RTree::JoinQuery(RTree& other, IVisitor& v)
+{
+	// the two locks in address order.
+	RTree* first = std::min(this, &other, std::less<RTree*>());
+	RTree* second = std::max(this, &other, std::less<RTree*>());
+	std::shared_lock<std::shared_mutex> lock1(first->m_lock);
+	std::shared_lock<std::shared_mutex> lock2;
+	if (second != first) {
+		lock2 = std::shared_lock<std::shared_mutex>(second->m_lock);
+	}
+
+	JoinState js;
+	uint64_t results = 0;
+
+	std::vector<std::pair<id_type, id_type>> work;
+	auto push = [&](id_type id1, id_type id2) { work.emplace_back(id1, id2); };
+
+	std::vector<const IData*> entries(2);
+	auto report = [&](const NodeView& n1, const NodeView& n2, const std::vector<std::pair<uint32_t, uint32_t>>& pairs)
+	{
+		for (const auto& p : pairs)
+		{
+			ChildData e1(n1, p.first), e2(n2, p.second);
+			entries[0] = &e1;
+			entries[1] = &e2;
+			v.VisitData(entries);
+		}
+		results += pairs.size();
+	};
+
+	work.emplace_back(m_root_id, other.m_root_id);
+	while (!work.empty())
+	{
+		const auto ids = work.back(); work.pop_back();
+		JoinNodes(*this, other, ids.first, ids.second, js, push, report);
+	}
+
+	m_stats.query_results += results;
 }
 
 void RTree::QueryStrategy(IQueryStrategy& qs)
 {
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
 	id_type next = m_root_id;
 
 	bool has_next = true;
 	while (has_next)
 	{
-		std::shared_ptr<Node> n = ReadNode(next);
-		qs.GetNextEntry(*n, next, has_next);
+		NodeView n = ReadNodeView(next);
+		qs.GetNextEntry(n, next, has_next);
 	}
 }
 
@@ -478,6 +934,8 @@ void RTree::QueryStrategy(IQueryStrategy& qs)
 
 void RTree::AddCommand(const std::shared_ptr<ICommand>& in, CommandType ct)
 {
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
 	switch (ct)
 	{
 	case CommandType::Write:
@@ -494,17 +952,22 @@ void RTree::AddCommand(const std::shared_ptr<ICommand>& in, CommandType ct)
 
 bool RTree::IsIndexValid()
 {
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
 	class ValidateEntry
 	{
 	public:
-		ValidateEntry(Region& r, const std::shared_ptr<Node>& node) 
+		ValidateEntry(Region& r, const std::shared_ptr<Node>& node, bool exact = true) 
 			: m_parent_mbr(r)
 			, m_node(node)
+			, m_exact(exact)
 		{
 		}
 
 		Region m_parent_mbr;
 		std::shared_ptr<Node> m_node = nullptr;
+		// false if the parent entry was quantized and only contains the node.
+		bool m_exact = true;
 
 	}; // ValidateEntry
 
@@ -540,7 +1003,7 @@ bool RTree::IsIndexValid()
 			std::cerr << "Invalid parent information." << std::endl;
 			ret = false;
 		}
-		else if (!(tmp_region == e.m_parent_mbr))
+		else if (e.m_exact ? !(tmp_region == e.m_parent_mbr) : !e.m_parent_mbr.ContainsRegion(tmp_region))
 		{
 			std::cerr << "Error in parent." << std::endl;
 			ret = false;
@@ -551,7 +1014,18 @@ bool RTree::IsIndexValid()
 			for (uint32_t cChild = 0; cChild < e.m_node->m_children; ++cChild)
 			{
 				std::shared_ptr<Node> ptr_n = ReadNode(e.m_node->m_children_id[cChild]);
-				ValidateEntry tmpEntry(e.m_node->m_children_mbr[cChild], ptr_n);
+				ValidateEntry tmpEntry(e.m_node->m_children_mbr[cChild], ptr_n, e.m_node->m_encoding == NodeEncoding::Plain);
+
+				uint64_t count, entry_count;
+				if (e.m_node->m_children_data_len[cChild] == sizeof(uint64_t) && ptr_n->GetSubtreeCount(count))
+				{
+					memcpy(&entry_count, e.m_node->m_children_data[cChild], sizeof(uint64_t));
+					if (count != entry_count)
+					{
+						std::cerr << "Invalid subtree count." << std::endl;
+						ret = false;
+					}
+				}
 
 				auto itr = nodes_in_level.find(tmpEntry.m_node->m_level);
 				if (itr == nodes_in_level.end())
@@ -568,6 +1042,13 @@ bool RTree::IsIndexValid()
 		}
 	}
 
+	uint64_t count;
+	if (root->GetSubtreeCount(count) && count != m_stats.data)
+	{
+		std::cerr << "Invalid data count." << std::endl;
+		ret = false;
+	}
+
 	uint32_t nodes = 0;
 	for (int i = 0; i < m_stats.tree_height; ++i)
 	{
@@ -593,26 +1074,155 @@ bool RTree::IsIndexValid()
 
 void RTree::Flush()
 {
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	StoreDirtyPages();
 	StoreHeader();
+	m_storage_mgr->Flush();
+}
+
+void RTree::BeginBatch()
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	if (m_batch) {
+		throw IllegalStateException("RTree: a batch is already open.");
+	}
+	m_batch = true;
+}
+
+void RTree::CommitBatch()
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	if (!m_batch) {
+		throw IllegalStateException("RTree: no batch is open.");
+	}
+
+	StoreDirtyPages();
+	m_batch = false;
+
+	Commit();
+}
+
+void RTree::InsertBatch(const BulkLoadEntry* entries, size_t count)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	// joins a batch opened by the caller, otherwise forms its own.
+	const bool own_batch = !m_batch;
+	m_batch = true;
+
+	try
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			CheckPayload(entries[i].data_len);
+
+			Region mbr = entries[i].mbr;
+			mbr.RoundOutward();
+			CheckMBR(mbr);
+
+			uint8_t* buffer = nullptr;
+			if (entries[i].data_len > 0)
+			{
+				buffer = new uint8_t[entries[i].data_len];
+				memcpy(buffer, entries[i].data, entries[i].data_len);
+			}
+
+			InsertDataImpl(entries[i].data_len, buffer, mbr, entries[i].id);
+		}
+	}
+	catch (...)
+	{
+		if (own_batch)
+		{
+			StoreDirtyPages();
+			m_batch = false;
+		}
+		throw;
+	}
+
+	if (own_batch)
+	{
+		StoreDirtyPages();
+		m_batch = false;
+
+		Commit();
+	}
+}
+
+void RTree::BulkLoad(IDataStream& stream, BulkLoadMethod method)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	BulkLoader loader(*this, method);
+	loader.Load(stream);
+
+	Commit();
+}
+
+void RTree::BulkLoad(const BulkLoadEntry* entries, size_t count, BulkLoadMethod method)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	BulkLoader loader(*this, method);
+	loader.Load(entries, count);
+
+	Commit();
+}
+
+void RTree::SetNodeCache(size_t budget, uint32_t pinned_levels)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	m_node_cache.Clear();
+	m_node_cache.SetBudget(budget);
+	m_node_cache.SetPinnedLevels(pinned_levels);
 }
 
 id_type RTree::WriteNode(const Node& n)
 {
+	++m_generation;
+
 	uint8_t* buffer;
 	uint32_t data_len;
 	n.StoreToByteArray(&buffer, data_len);
+	assert(m_node_size == 0 || data_len <= m_node_size || (n.m_level == 0 && !m_limit_payload));
 
-	id_type page = n.m_identifier < 0 ? NewPage : n.m_identifier;
-	try
+	id_type page = n.m_identifier < 0 ? static_cast<id_type>(NewPage) : n.m_identifier;
+
+	// write-through: the next read decodes the stored page again. Erased
+	// before the store, a failed write leaves nothing stale behind.
+	if (page != NewPage) {
+		m_node_cache.Erase(page);
+	}
+
+	if (m_batch && page != NewPage)
 	{
-		m_storage_mgr->StoreByteArray(page, data_len, buffer);
-		delete[] buffer;
+		// replaces earlier writes of the page, stored once by the commit.
+		m_dirty_pages[page] = { data_len, std::shared_ptr<uint8_t>(buffer, std::default_delete<uint8_t[]>()) };
 	}
-	catch (InvalidPageException& e)
+	else
 	{
-		delete[] buffer;
-		std::cerr << e.what() << std::endl;
-		throw;
+		try
+		{
+			m_storage_mgr->StoreByteArray(page, data_len, buffer);
+			delete[] buffer;
+		}
+		catch (InvalidPageException& e)
+		{
+			delete[] buffer;
+			std::cerr << e.what() << std::endl;
+			throw;
+		}
+		catch (...)
+		{
+			delete[] buffer;
+			throw;
+		}
+
+		++m_stats.writes;
 	}
 
 	if (n.m_identifier < 0)
@@ -634,34 +1244,57 @@ id_type RTree::WriteNode(const Node& n)
 #endif
 	}
 
-	++m_stats.writes;
+	for (auto& cmd : m_write_node_cmds) {
+		cmd->Execute(n);
+	}
+
+	return page;
+}
+
+std::shared_ptr<Node> RTree::ReadNode(id_type page)
+{
+	std::shared_ptr<Node> cached = m_node_cache.Find(page);
+	if (cached)
+	{
+		++m_stats.hits;
+
+		for (auto& cmd : m_read_node_cmds) {
+			cmd->Execute(*cached);
+		}
 
-	for (auto& cmd : m_write_node_cmds) {
-		cmd->Execute(n);
+		return cached;
 	}
 
-	return page;
-}
+	++m_stats.misses;
 
-std::shared_ptr<Node> RTree::ReadNode(id_type page)
-{
 	uint32_t data_len;
-	uint8_t* buffer;
+	uint8_t* buffer = nullptr;
+	const uint8_t* data;
 
-	try
+	auto dirty = m_dirty_pages.find(page);
+	if (dirty != m_dirty_pages.end())
 	{
-		m_storage_mgr->LoadByteArray(page, data_len, &buffer);
+		data_len = dirty->second.len;
+		data = dirty->second.data.get();
 	}
-	catch (InvalidPageException& e)
+	else
 	{
-		std::cerr << e.what() << std::endl;
-		throw;
+		try
+		{
+			m_storage_mgr->LoadByteArray(page, data_len, &buffer);
+		}
+		catch (InvalidPageException& e)
+		{
+			std::cerr << e.what() << std::endl;
+			throw;
+		}
+		data = buffer;
 	}
 
 	try
 	{
 		uint32_t node_type;
-		memcpy(&node_type, buffer, sizeof(uint32_t));
+		memcpy(&node_type, data, sizeof(uint32_t));
 
 		std::shared_ptr<Node> n = nullptr;
 		if (node_type == PersistentIndex) {
@@ -674,7 +1307,7 @@ std::shared_ptr<Node> RTree::ReadNode(id_type page)
 
 		//n->m_pTree = this;
 		n->m_identifier = page;
-		n->LoadFromByteArray(buffer);
+		n->LoadFromByteArray(data);
 
 		++m_stats.reads;
 
@@ -682,6 +1315,9 @@ std::shared_ptr<Node> RTree::ReadNode(id_type page)
 			cmd->Execute(*n);
 		}
 
+		const bool pinned = n->m_level + m_node_cache.GetPinnedLevels() >= m_stats.tree_height;
+		m_node_cache.Insert(page, n, n->GetMemorySize(), pinned);
+
 		delete[] buffer;
 		return n;
 	}
@@ -694,6 +1330,10 @@ std::shared_ptr<Node> RTree::ReadNode(id_type page)
 
 void RTree::DeleteNode(const Node& n)
 {
+	++m_generation;
+	m_node_cache.Erase(n.m_identifier);
+	m_dirty_pages.erase(n.m_identifier);
+
 	try
 	{
 		m_storage_mgr->DeleteByteArray(n.m_identifier);
@@ -712,29 +1352,221 @@ void RTree::DeleteNode(const Node& n)
 	}
 }
 
+NodeView RTree::ReadNodeView(id_type page)
+{
+	auto dirty = m_dirty_pages.find(page);
+	if (dirty != m_dirty_pages.end()) {
+		return CreateNodeView(page, dirty->second.len, dirty->second.data.get(), dirty->second.data);
+	}
+
+	uint32_t data_len;
+	const uint8_t* data;
+	std::shared_ptr<const void> owner;
+
+	try
+	{
+		if (!m_storage_mgr->LoadByteArrayView(page, data_len, &data, owner))
+		{
+			// the storage manager can only hand out copies.
+			uint8_t* buffer;
+			m_storage_mgr->LoadByteArray(page, data_len, &buffer);
+			owner = std::shared_ptr<uint8_t>(buffer, std::default_delete<uint8_t[]>());
+			data = buffer;
+		}
+	}
+	catch (InvalidPageException& e)
+	{
+		std::cerr << e.what() << std::endl;
+		throw;
+	}
+
+	return CreateNodeView(page, data_len, data, owner);
+}
+
+void RTree::ReadNodeViews(const std::vector<id_type>& pages, std::vector<NodeView>& out)
+{
+	const size_t first = out.size();
+	out.resize(first + pages.size());
+
+	// pages of an open batch are served from memory, the rest in one load.
+	std::vector<id_type> stored;
+	std::vector<size_t> slots;
+	const std::vector<id_type>* load = &pages;
+	if (!m_dirty_pages.empty())
+	{
+		for (size_t i = 0; i < pages.size(); ++i)
+		{
+			auto dirty = m_dirty_pages.find(pages[i]);
+			if (dirty != m_dirty_pages.end())
+			{
+				out[first + i] = CreateNodeView(pages[i], dirty->second.len, dirty->second.data.get(), dirty->second.data);
+			}
+			else
+			{
+				stored.push_back(pages[i]);
+				slots.push_back(first + i);
+			}
+		}
+		load = &stored;
+	}
+
+	try
+	{
+		m_storage_mgr->LoadByteArrays(*load, [&](size_t i, uint32_t len, const uint8_t* data, const std::shared_ptr<const void>& owner) {
+			const size_t slot = slots.empty() ? first + i : slots[i];
+			out[slot] = CreateNodeView((*load)[i], len, data, owner);
+		});
+	}
+	catch (InvalidPageException& e)
+	{
+		std::cerr << e.what() << std::endl;
+		throw;
+	}
+}
+
+void RTree::SetBatchedReads(bool enable)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	m_batched_reads = enable;
+}
+
+NodeView RTree::CreateNodeView(id_type page, uint32_t len, const uint8_t* data, const std::shared_ptr<const void>& owner)
+{
+	uint32_t node_type;
+	memcpy(&node_type, data, sizeof(uint32_t));
+	if (node_type != PersistentIndex && node_type != PersistentLeaf) {
+		throw IllegalStateException("readNodeView: failed reading the correct node type information");
+	}
+
+	uint32_t format;
+	memcpy(&format, data + 3 * sizeof(uint32_t), sizeof(uint32_t));
+	if (!IsPageFormat(format)) {
+		throw IllegalStateException("readNodeView: Unknown page format " + std::to_string(format >> 16) + ".");
+	}
+
+	NodeView n(page, len, data, owner);
+
+	++m_stats.reads;
+
+	for (auto& cmd : m_read_node_cmds) {
+		cmd->Execute(n);
+	}
+
+	return n;
+}
+
 void RTree::SetMetaPage(const std::string& key, id_type page)
 {
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
 	m_meta_pages[key] = page;
+
+	Commit();
 }
 
 id_type RTree::GetMetaPage(const std::string& key) const
 {
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
 	auto it = m_meta_pages.find(key);
-	return (it != m_meta_pages.end()) ? it->second : NewPage;
+	return (it != m_meta_pages.end()) ? it->second : static_cast<id_type>(NewPage);
 }
 
 bool RTree::HasMetaPage(const std::string& key) const
 {
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
 	return m_meta_pages.count(key) > 0;
 }
 
 void RTree::RemoveMetaPage(const std::string& key)
 {
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
 	m_meta_pages.erase(key);
+
+	Commit();
 }
 
-void RTree::InitNew()
+void RTree::StoreMetaData(const std::string& key, uint32_t len, const uint8_t* data)
 {
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+
+	auto it = m_meta_pages.find(key);
+	id_type page = (it != m_meta_pages.end()) ? it->second : static_cast<id_type>(NewPage);
+	m_storage_mgr->StoreByteArray(page, len, data);
+	m_meta_pages[key] = page;
+
+	Commit();
+}
+
+void RTree::LoadMetaData(const std::string& key, uint32_t& len, uint8_t** data) const
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	auto it = m_meta_pages.find(key);
+	if (it == m_meta_pages.end()) {
+		throw IllegalArgumentException("RTree: Unknown meta page " + key + ".");
+	}
+	m_storage_mgr->LoadByteArray(it->second, len, data);
+}
+
+void RTree::InitNew(const RTreeOptions& options)
+{
+	if (options.variant != RV_LINEAR && options.variant != RV_QUADRATIC && options.variant != RV_RSTAR) {
+		throw IllegalArgumentException("RTree: Unknown tree variant.");
+	}
+	if (!(options.fill_factor > 0.0 && options.fill_factor < 1.0)) {
+		throw IllegalArgumentException("RTree: The fill factor must lie in (0, 1).");
+	}
+	if (options.index_encoding != NodeEncoding::Plain && options.index_encoding != NodeEncoding::Quantized8 &&
+		options.index_encoding != NodeEncoding::Quantized16) {
+		throw IllegalArgumentException("RTree: Unknown index encoding.");
+	}
+
+	const uint64_t page_size = options.page_size != 0 ? options.page_size
+		: m_storage_mgr->GetPageSize() != 0 ? m_storage_mgr->GetPageSize() : 4096;
+	const uint64_t node_size = page_size * options.node_pages;
+	if (node_size == 0 || node_size > std::numeric_limits<int32_t>::max()) {
+		throw IllegalArgumentException("RTree: Invalid node size of " + std::to_string(node_size) + " bytes.");
+	}
+
+	m_tree_var = options.variant;
+	m_fill_factor = options.fill_factor;
+	m_tight_mbrs = options.tight_mbrs;
+	m_index_encoding = options.index_encoding;
+	m_node_size = static_cast<uint32_t>(node_size);
+	m_leaf_payload = options.leaf_payload;
+	m_limit_payload = options.limit_payload;
+
+	// the capacities are the entries of a full node. CheckMBR keeps the
+	// node MBRs of quantized index nodes finite, so they never fall back
+	// to plain bounds.
+	const uint32_t index_fit = FitCapacity(m_node_size, m_index_encoding, sizeof(uint64_t));
+	const uint32_t leaf_fit = FitCapacity(m_node_size, NodeEncoding::Plain, m_leaf_payload);
+	m_index_capacity = options.index_capacity != 0 ? options.index_capacity : index_fit;
+	m_leaf_capacity = options.leaf_capacity != 0 ? options.leaf_capacity : leaf_fit;
+
+	if ((options.index_capacity != 0 && options.index_capacity < 4) || (options.leaf_capacity != 0 && options.leaf_capacity < 4)) {
+		throw IllegalArgumentException("RTree: A capacity must be at least 4.");
+	}
+	if (m_index_capacity < 4 || m_leaf_capacity < 4) {
+		throw IllegalArgumentException(
+			"RTree: Nodes of " + std::to_string(m_node_size) + " bytes hold " + std::to_string(index_fit) +
+			" index and " + std::to_string(leaf_fit) + " leaf entries, at least 4 are needed.");
+	}
+	if (m_index_capacity > index_fit) {
+		throw IllegalArgumentException(
+			"RTree: An index capacity of " + std::to_string(m_index_capacity) + " does not fit in " +
+			std::to_string(m_node_size) + " bytes, at most " + std::to_string(index_fit) + " does.");
+	}
+	if (m_leaf_capacity > leaf_fit) {
+		throw IllegalArgumentException(
+			"RTree: A leaf capacity of " + std::to_string(m_leaf_capacity) + " does not fit in " +
+			std::to_string(m_node_size) + " bytes, at most " + std::to_string(leaf_fit) + " does.");
+	}
+
 	StoreHeader();
 
 	m_stats.tree_height = 1;
@@ -744,6 +1576,7 @@ void RTree::InitNew()
 	m_root_id = WriteNode(root);
 
 	StoreHeader();
+	m_storage_mgr->Commit();
 }
 
 void RTree::InitOld()
@@ -752,6 +1585,28 @@ void RTree::InitOld()
 	LoadHeader();
 }
 
+void RTree::Commit()
+{
+	// the header goes with every group, a recovered tree finds its root.
+	// A batch is one group, it is committed by CommitBatch.
+	if (!m_batch && m_storage_mgr->HasWriteAheadLog())
+	{
+		StoreHeader();
+		m_storage_mgr->Commit();
+	}
+}
+
+void RTree::StoreDirtyPages()
+{
+	for (auto& pair : m_dirty_pages)
+	{
+		id_type page = pair.first;
+		m_storage_mgr->StoreByteArray(page, pair.second.len, pair.second.data.get());
+		++m_stats.writes;
+	}
+	m_dirty_pages.clear();
+}
+
 void RTree::StoreHeader()
 {
 	uint32_t meta_sz = sizeof(uint32_t);  // meta_count
@@ -762,6 +1617,8 @@ void RTree::StoreHeader()
 	}
 
 	const uint32_t header_sz =
+		sizeof(uint32_t) +						// HEADER_MAGIC
+		sizeof(uint32_t) +						// HEADER_VERSION
 		sizeof(id_type) +						// m_rootID
 		sizeof(RTreeVariant) +					// m_treeVariant
 		sizeof(double) +						// m_fillFactor
@@ -770,17 +1627,27 @@ void RTree::StoreHeader()
 		sizeof(uint32_t) +						// m_nearMinimumOverlapFactor
 		sizeof(double) +						// m_splitDistributionFactor
 		sizeof(double) +						// m_reinsertFactor
-		sizeof(uint32_t) +						// m_dimension
+		sizeof(uint32_t) +						// DIMENSION
+		sizeof(uint32_t) +						// sizeof(coord_type)
+		sizeof(NodeEncoding) +					// m_index_encoding
+		sizeof(uint32_t) +						// m_node_size
+		sizeof(uint32_t) +						// m_leaf_payload
+		sizeof(char) +							// m_limit_payload
 		sizeof(char) +							// m_bTightMBRs
 		sizeof(uint32_t) +						// m_stats.m_nodes
 		sizeof(uint64_t) +						// m_stats.m_data
 		sizeof(uint32_t) +						// m_stats.m_treeHeight
 		m_stats.tree_height * sizeof(uint32_t) +// m_stats.m_nodesInLevel
-		meta_sz;
+		meta_sz +
+		sizeof(uint64_t);						// m_generation
 
 	uint8_t* header = new uint8_t[header_sz];
 	uint8_t* ptr = header;
 
+	memcpy(ptr, &HEADER_MAGIC, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, &HEADER_VERSION, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
 	memcpy(ptr, &m_root_id, sizeof(id_type));
 	ptr += sizeof(id_type);
 	memcpy(ptr, &m_tree_var, sizeof(RTreeVariant));
@@ -797,8 +1664,22 @@ void RTree::StoreHeader()
 	ptr += sizeof(double);
 	memcpy(ptr, &m_reinsert_factor, sizeof(double));
 	ptr += sizeof(double);
-	//memcpy(ptr, &m_dimension, sizeof(uint32_t));
-	//ptr += sizeof(uint32_t);
+	// the build parameters the pages were written with.
+	const uint32_t dimension = DIMENSION;
+	memcpy(ptr, &dimension, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	const uint32_t coord_size = sizeof(coord_type);
+	memcpy(ptr, &coord_size, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, &m_index_encoding, sizeof(NodeEncoding));
+	ptr += sizeof(NodeEncoding);
+	memcpy(ptr, &m_node_size, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, &m_leaf_payload, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	char limit = (char)m_limit_payload;
+	memcpy(ptr, &limit, sizeof(char));
+	ptr += sizeof(char);
 	char c = (char)m_tight_mbrs;
 	memcpy(ptr, &c, sizeof(char));
 	ptr += sizeof(char);
@@ -832,6 +1713,9 @@ void RTree::StoreHeader()
 		ptr += sizeof(id_type);
 	}
 
+	memcpy(ptr, &m_generation, sizeof(uint64_t));
+	ptr += sizeof(uint64_t);
+
 	m_storage_mgr->StoreByteArray(m_header_id, header_sz, header);
 
 	delete[] header;
@@ -845,6 +1729,27 @@ void RTree::LoadHeader()
 
 	uint8_t* ptr = header;
 
+	uint32_t magic = 0, version = 0;
+	if (headerSize >= 2 * sizeof(uint32_t))
+	{
+		memcpy(&magic, ptr, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		memcpy(&version, ptr, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+	}
+	if (magic != HEADER_MAGIC)
+	{
+		delete[] header;
+		throw IllegalStateException("RTree: The storage manager holds no tree header.");
+	}
+	if (version != HEADER_VERSION)
+	{
+		delete[] header;
+		throw IllegalStateException(
+			"RTree: Unknown header version " + std::to_string(version) + ", this build reads version " +
+			std::to_string(HEADER_VERSION) + ".");
+	}
+
 	memcpy(&m_root_id, ptr, sizeof(id_type));
 	ptr += sizeof(id_type);
 	memcpy(&m_tree_var, ptr, sizeof(RTreeVariant));
@@ -861,8 +1766,47 @@ void RTree::LoadHeader()
 	ptr += sizeof(double);
 	memcpy(&m_reinsert_factor, ptr, sizeof(double));
 	ptr += sizeof(double);
-	//memcpy(&m_dimension, ptr, sizeof(uint32_t));
-	//ptr += sizeof(uint32_t);
+	uint32_t dimension, coord_size;
+	memcpy(&dimension, ptr, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(&coord_size, ptr, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	if (dimension != DIMENSION || coord_size != sizeof(coord_type))
+	{
+		delete[] header;
+		throw IllegalStateException(
+			"RTree: the index was written for " + std::to_string(dimension) + " dimensions and " +
+			std::to_string(coord_size) + " byte coordinates, this build uses " + std::to_string(DIMENSION) +
+			" and " + std::to_string(sizeof(coord_type)) + ".");
+	}
+	memcpy(&m_index_encoding, ptr, sizeof(NodeEncoding));
+	ptr += sizeof(NodeEncoding);
+	if (m_index_encoding != NodeEncoding::Plain && m_index_encoding != NodeEncoding::Quantized8 &&
+		m_index_encoding != NodeEncoding::Quantized16)
+	{
+		delete[] header;
+		throw IllegalStateException(
+			"RTree: Unknown index encoding " + std::to_string(static_cast<uint32_t>(m_index_encoding)) + ".");
+	}
+	memcpy(&m_node_size, ptr, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(&m_leaf_payload, ptr, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	char limit;
+	memcpy(&limit, ptr, sizeof(char));
+	m_limit_payload = (limit != 0);
+	ptr += sizeof(char);
+	// the same bounds InitNew checks the options against.
+	if (m_node_size == 0 || m_node_size > static_cast<uint32_t>(std::numeric_limits<int32_t>::max()) ||
+		m_index_capacity < 4 || m_leaf_capacity < 4 ||
+		m_index_capacity > FitCapacity(m_node_size, m_index_encoding, sizeof(uint64_t)) ||
+		m_leaf_capacity > FitCapacity(m_node_size, NodeEncoding::Plain, m_leaf_payload))
+	{
+		delete[] header;
+		throw IllegalStateException(
+			"RTree: Nodes of " + std::to_string(m_node_size) + " bytes can not hold the capacities of the header, " +
+			std::to_string(m_index_capacity) + " index and " + std::to_string(m_leaf_capacity) + " leaf entries.");
+	}
 	char c;
 	memcpy(&c, ptr, sizeof(char));
 	m_tight_mbrs = (c != 0);
@@ -908,9 +1852,38 @@ void RTree::LoadHeader()
 		}
 	}
 
+	memcpy(&m_generation, ptr, sizeof(uint64_t));
+	ptr += sizeof(uint64_t);
+
 	delete[] header;
 }
 
+void RTree::CheckPayload(uint32_t data_len) const
+{
+	if (m_limit_payload && data_len > m_leaf_payload)
+	{
+		throw IllegalArgumentException(
+			"RTree: A payload of " + std::to_string(data_len) + " bytes exceeds the " +
+			std::to_string(m_leaf_payload) + " bytes reserved per leaf entry.");
+	}
+}
+
+void RTree::CheckMBR(const Region& mbr) const
+{
+	if (m_index_encoding == NodeEncoding::Plain) {
+		return;
+	}
+
+	// the extent of any union of such MBRs is finite.
+	const double limit = std::numeric_limits<double>::max() / 2.0;
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		if (!(-limit <= mbr.GetLow()[d] && mbr.GetLow()[d] <= mbr.GetHigh()[d] && mbr.GetHigh()[d] <= limit)) {
+			throw IllegalArgumentException("RTree: Quantized index nodes need finite MBRs below half the largest double.");
+		}
+	}
+}
+
 void RTree::InsertDataImpl(uint32_t data_len, uint8_t* data, Region& mbr, id_type id) 
 {
 	std::stack<id_type> path_buf;
@@ -944,10 +1917,6 @@ void RTree::InsertDataImpl(uint32_t data_len, uint8_t* data, Region& mbr, id_typ
 
 	assert(n->m_level == level);
 
-	if (n.get() == root.get())
-	{
-		assert(root.unique());
-	}
 	n->InsertData(data_len, data, mbr, id, path_buf, overflow_tbl);
 }
 
@@ -956,9 +1925,6 @@ bool RTree::DeleteDataImpl(const Region& mbr, id_type id)
 	std::stack<id_type> path_buf;
 	std::shared_ptr<Node> root = ReadNode(m_root_id);
 	std::shared_ptr<Node> l = root->FindLeaf(mbr, id, path_buf);
-	if (l.get() == root.get()) {
-		assert(root.unique());
-	}
 
 	if (l != nullptr)
 	{
@@ -970,128 +1936,303 @@ bool RTree::DeleteDataImpl(const Region& mbr, id_type id)
 	return false;
 }
 
-void RTree::RangeQuery(RangeQueryType type, const IShape& query, IVisitor& v)
+void RTree::ContainsWhatQueryImpl(const IShape& query, IVisitor* v, IResultSink* sink)
 {
-	std::stack<std::shared_ptr<Node>> st;
-	std::shared_ptr<Node> root = ReadNode(m_root_id);
+	const bool exact = query.ShapeType() == ST_REGION;
+	Region query_mbr;
+	query.GetMBR(query_mbr);
 
-	if (root->m_children > 0 && query.IntersectsShape(root->m_node_mbr)) {
-		st.push(root);
-	}
+	ResultWriter out(v, sink);
+
+	std::stack<NodeView> st;
+	st.push(ReadNodeView(m_root_id));
 
+	Region mbr;
 	while (!st.empty())
 	{
-		std::shared_ptr<Node> n = st.top(); st.pop();
+		NodeView n = std::move(st.top()); st.pop();
 
-		if (n->m_level == 0)
+		if (n.GetLevel() == 0)
 		{
-			v.VisitNode(*n);
+			if (v) {
+				v->VisitNode(n);
+			}
 
-			for (int i = 0; i < n->m_children; ++i)
+			for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
+			{
+				uint64_t mask = FilterChildren(n, base, query_mbr, true);
+				for (uint64_t m = exact ? 0 : mask; m != 0; )
+				{
+					const uint32_t bit = MBRFilter::NextBit(m);
+					n.GetChildMBR(base + bit, mbr);
+					if (!query.ContainsShape(mbr)) {
+						mask &= ~(uint64_t(1) << bit);
+					}
+				}
+				out.Add(n, base, mask);
+			}
+		}
+		else
+		{
+			if (query.ContainsShape(n.GetRegion()))
+			{
+				VisitSubTree(n, v, sink);
+			}
+			else if (query.IntersectsShape(n.GetRegion()))
 			{
-				bool b;
-				if (type == ContainmentQuery) {
-					b = query.ContainsShape(n->m_children_mbr[i]);
-				} else {
-					b = query.IntersectsShape(n->m_children_mbr[i]);
+				VisitorStatus status = v ? v->VisitNode(n) : VisitorStatus::Continue;
+				if (status == VisitorStatus::Continue)
+				{
+					for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
+					{
+						uint64_t mask = FilterChildren(n, base, query_mbr, false);
+						while (mask != 0)
+						{
+							const uint32_t i = base + MBRFilter::NextBit(mask);
+							n.GetChildMBR(i, mbr);
+							if (exact || query.IntersectsShape(mbr)) {
+								st.push(ReadNodeView(n.GetChildIdentifier(i)));
+							}
+						}
+					}
 				}
+			}
+		}
+	}
+
+	m_stats.query_results += out.Finish();
+}
+
+void RTree::CountQuery(RangeQueryType type, const IShape& query, IResultSink& sink)
+{
+	uint64_t count;
+	AggregateQueryImpl(type, query, count, nullptr);
+	if (count > 0) {
+		sink.AddCount(count);
+	}
+}
 
-				if (b)
+void RTree::AggregateQueryImpl(RangeQueryType type, const IShape& query, uint64_t& count, Region* mbr)
+{
+	const bool exact = query.ShapeType() == ST_REGION;
+	Region query_mbr;
+	query.GetMBR(query_mbr);
+
+	// a subtree is summed up by its parent entry if it lies inside the
+	// query, its MBR is the union of its entries only if kept tight and
+	// not quantized.
+	const bool whole = mbr == nullptr || (m_tight_mbrs && m_index_encoding == NodeEncoding::Plain);
+
+	count = 0;
+
+	std::vector<NodeView> st;
+	NodeView root = ReadNodeView(m_root_id);
+
+	if (root.GetChildrenCount() > 0 && query.IntersectsShape(root.GetRegion())) {
+		st.push_back(std::move(root));
+	}
+
+	Region child;
+	while (!st.empty())
+	{
+		NodeView n = std::move(st.back()); st.pop_back();
+
+		if (n.GetLevel() == 0)
+		{
+			for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
+			{
+				uint64_t mask = FilterChildren(n, base, query_mbr, type == ContainmentQuery);
+				if (exact && mbr == nullptr)
 				{
-					Data data = Data(n->m_children_data_len[i], n->m_children_data[i], n->m_children_mbr[i], n->m_children_id[i]);
-					v.VisitData(data);
-					++m_stats.query_results;
+					count += std::bitset<64>(mask).count();
+					continue;
+				}
+				while (mask != 0)
+				{
+					n.GetChildMBR(base + MBRFilter::NextBit(mask), child);
+					if (!exact && !(type == ContainmentQuery ? query.ContainsShape(child) : query.IntersectsShape(child))) {
+						continue;
+					}
+					++count;
+					if (mbr) {
+						mbr->Combine(child);
+					}
 				}
 			}
+			continue;
 		}
-		else
+
+		for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
 		{
-			VisitorStatus status = v.VisitNode(*n);
-			if (status == VisitorStatus::Continue)
+			uint64_t mask = FilterChildren(n, base, query_mbr, false);
+			const uint64_t inside = whole ? FilterChildren(n, base, query_mbr, true) : 0;
+			while (mask != 0)
 			{
-				for (int i = 0; i < n->m_children; ++i)
+				const uint32_t bit = MBRFilter::NextBit(mask);
+				const uint32_t i = base + bit;
+				if (mbr || !exact) {
+					n.GetChildMBR(i, child);
+				}
+
+				uint64_t c;
+				if ((inside >> bit & 1) != 0 && (exact || query.ContainsShape(child)) && SubtreeCount(n, i, c))
 				{
-					if (query.IntersectsShape(n->m_children_mbr[i])) {
-						st.push(ReadNode(n->m_children_id[i]));
+					count += c;
+					if (mbr) {
+						mbr->Combine(child);
 					}
+					continue;
+				}
+				if (!exact && !query.IntersectsShape(child)) {
+					continue;
 				}
+				st.push_back(ReadNodeView(n.GetChildIdentifier(i)));
 			}
 		}
 	}
+
+	m_stats.query_results += count;
 }
 
-void RTree::SelfJoinQuery(id_type id1, id_type id2, const Region& r, IVisitor& vis)
+void RTree::RangeQuery(RangeQueryType type, const IShape& query, IVisitor* v, IResultSink* sink)
 {
-	std::shared_ptr<Node> n1 = ReadNode(id1);
-	std::shared_ptr<Node> n2 = ReadNode(id2);
-	vis.VisitNode(*n1);
-	vis.VisitNode(*n2);
+	// children are filtered on the query MBR a batch at a time, which is
+	// exact for region queries. Other shapes test the remaining candidates.
+	const bool exact = query.ShapeType() == ST_REGION;
+	Region query_mbr;
+	query.GetMBR(query_mbr);
+
+	ResultWriter out(v, sink);
 
-	for (int i = 0; i < n1->m_children; ++i)
+	// nodes to visit, taken from the back. With batched reads it holds one
+	// level at a time and the children of that level are read together.
+	std::vector<NodeView> st;
+	std::vector<id_type> batch;
+
+	NodeView root = ReadNodeView(m_root_id);
+
+	if (root.GetChildrenCount() > 0 && query.IntersectsShape(root.GetRegion())) {
+		st.push_back(std::move(root));
+	}
+
+	Region mbr;
+	while (!st.empty())
 	{
-		if (r.IntersectsRegion(n1->m_children_mbr[i]))
+		NodeView n = std::move(st.back()); st.pop_back();
+
+		if (n.GetLevel() == 0)
+		{
+			if (v) {
+				v->VisitNode(n);
+			}
+
+			for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
+			{
+				uint64_t mask = FilterChildren(n, base, query_mbr, type == ContainmentQuery);
+				for (uint64_t m = exact ? 0 : mask; m != 0; )
+				{
+					const uint32_t bit = MBRFilter::NextBit(m);
+					n.GetChildMBR(base + bit, mbr);
+					if (!(type == ContainmentQuery ? query.ContainsShape(mbr) : query.IntersectsShape(mbr))) {
+						mask &= ~(uint64_t(1) << bit);
+					}
+				}
+				out.Add(n, base, mask);
+			}
+		}
+		else
 		{
-			for (int j = 0; j < n2->m_children; ++j)
+			VisitorStatus status = v ? v->VisitNode(n) : VisitorStatus::Continue;
+			if (status == VisitorStatus::Continue)
 			{
-				if (r.IntersectsRegion(n2->m_children_mbr[j]) &&
-					n1->m_children_mbr[i].IntersectsRegion(n2->m_children_mbr[j]))
+				for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
 				{
-					if (n1->m_level == 0)
+					uint64_t mask = FilterChildren(n, base, query_mbr, false);
+					while (mask != 0)
 					{
-						if (n1->m_children_id[i] != n2->m_children_id[j])
+						const uint32_t i = base + MBRFilter::NextBit(mask);
+						if (!exact)
 						{
-							assert(n2->m_level == 0);
-
-							std::vector<const IData*> v;
-							Data e1(n1->m_children_data_len[i], n1->m_children_data[i], n1->m_children_mbr[i], n1->m_children_id[i]);
-							Data e2(n2->m_children_data_len[j], n2->m_children_data[j], n2->m_children_mbr[j], n2->m_children_id[j]);
-							v.push_back(&e1);
-							v.push_back(&e2);
-							vis.VisitData(v);
+							n.GetChildMBR(i, mbr);
+							if (!query.IntersectsShape(mbr)) {
+								continue;
+							}
+						}
+						if (m_batched_reads) {
+							batch.push_back(n.GetChildIdentifier(i));
+						} else {
+							st.push_back(ReadNodeView(n.GetChildIdentifier(i)));
 						}
-					}
-					else
-					{
-						Region rr = r.GetIntersectingRegion(n1->m_children_mbr[i].GetIntersectingRegion(n2->m_children_mbr[j]));
-						SelfJoinQuery(n1->m_children_id[i], n2->m_children_id[j], rr, vis);
 					}
 				}
 			}
 		}
+
+		if (st.empty() && !batch.empty())
+		{
+			ReadNodeViews(batch, st);
+			batch.clear();
+		}
+	}
+
+	m_stats.query_results += out.Finish();
+}
+
+void RTree::NearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator* nnc)
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+
+	NearestNeighborCursor cursor(*this, query, nnc, &v, false);
+	cursor.SetLimit(k);
+
+	uint32_t count = 0;
+	double knearest = k == 0 ? 0.0 : std::numeric_limits<double>::max();
+
+	// report all nearest neighbors with equal greatest distances.
+	// (neighbors can be more than k, if many happen to have the same greatest distance).
+	while (const IData* e = cursor.Next(knearest))
+	{
+		v.VisitData(*e);
+		if (++count >= k) {
+			knearest = cursor.GetDistance();
+		}
 	}
 }
 
-void RTree::VisitSubTree(const std::shared_ptr<Node>& sub_tree, IVisitor& v)
+void RTree::VisitSubTree(const NodeView& sub_tree, IVisitor* v, IResultSink* sink)
 {
-	std::stack<std::shared_ptr<Node>> st;
+	ResultWriter out(v, sink);
+
+	std::stack<NodeView> st;
 	st.push(sub_tree);
 
 	while (!st.empty())
 	{
-		std::shared_ptr<Node> n = st.top(); st.pop();
+		NodeView n = std::move(st.top()); st.pop();
 
-		VisitorStatus status = v.VisitNode(*n);
+		VisitorStatus status = v ? v->VisitNode(n) : VisitorStatus::Continue;
 
-		if (n->m_level == 0)
+		if (n.GetLevel() == 0)
 		{
-			for (int i = 0; i < n->m_children; ++i)
+			for (uint32_t base = 0; base < n.GetChildrenCount(); base += MBRFilter::BATCH)
 			{
-				Data data = Data(n->m_children_data_len[i], n->m_children_data[i], n->m_children_mbr[i], n->m_children_id[i]);
-				v.VisitData(data);
-				++m_stats.query_results;
+				const uint32_t count = std::min(MBRFilter::BATCH, n.GetChildrenCount() - base);
+				out.Add(n, base, count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1);
 			}
 		}
 		else
 		{
 			if (status == VisitorStatus::Continue)
 			{
-				for (int i = 0; i < n->m_children; ++i)
+				for (uint32_t i = 0; i < n.GetChildrenCount(); ++i)
 				{
-					st.push(ReadNode(n->m_children_id[i]));
+					st.push(ReadNodeView(n.GetChildIdentifier(i)));
 				}
 			}
 		}
 	}
+
+	m_stats.query_results += out.Finish();
 }
 
 }
\ No newline at end of file
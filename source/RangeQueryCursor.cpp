@@ -0,0 +1,214 @@
+#include "spatialdb/RangeQueryCursor.h"
+#include "spatialdb/RTree.h"
+#include "spatialdb/Region.h"
+#include "spatialdb/MBRFilter.h"
+#include "spatialdb/ShapeType.h"
+#include "spatialdb/Exception.h"
+
+#include <algorithm>
+#include <cstring>
+#include <shared_mutex>
+
+namespace
+{
+
+const uint32_t CONTINUATION_MAGIC = 0x52435143; // "CQCR"
+
+}
+
+namespace spatialdb
+{
+
+RangeQueryCursor::RangeQueryCursor(RTree& tree, RangeQueryType type, const IShape& query)
+	: m_tree(tree)
+	, m_type(type)
+	, m_query(query)
+	, m_exact(query.ShapeType() == ST_REGION)
+{
+	query.GetMBR(m_query_mbr);
+
+	std::shared_lock<std::shared_mutex> lock(m_tree.m_lock);
+
+	m_generation = m_tree.m_generation;
+	m_path.push_back({ m_tree.m_root_id, 0, false, NodeView() });
+}
+
+RangeQueryCursor::RangeQueryCursor(RTree& tree, RangeQueryType type, const IShape& query, const std::vector<uint8_t>& continuation)
+	: m_tree(tree)
+	, m_type(type)
+	, m_query(query)
+	, m_exact(query.ShapeType() == ST_REGION)
+{
+	query.GetMBR(m_query_mbr);
+
+	// magic, type, frames, generation, then the page and offset of every frame.
+	const size_t header = 3 * sizeof(uint32_t) + sizeof(uint64_t);
+	const size_t frame = sizeof(id_type) + sizeof(uint32_t);
+
+	uint32_t magic = 0, stored_type = 0, frames = 0;
+	if (continuation.size() >= header)
+	{
+		const uint8_t* ptr = continuation.data();
+		memcpy(&magic, ptr, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		memcpy(&stored_type, ptr, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		memcpy(&frames, ptr, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		memcpy(&m_generation, ptr, sizeof(uint64_t));
+	}
+
+	if (magic != CONTINUATION_MAGIC || stored_type != static_cast<uint32_t>(type) || continuation.size() != header + frames * frame) {
+		throw IllegalArgumentException("RangeQueryCursor: Invalid continuation.");
+	}
+
+	const uint8_t* ptr = continuation.data() + header;
+	m_path.resize(frames);
+	for (auto& f : m_path)
+	{
+		memcpy(&f.page, ptr, sizeof(id_type));
+		ptr += sizeof(id_type);
+		memcpy(&f.next, ptr, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		f.loaded = false;
+	}
+}
+
+size_t RangeQueryCursor::Fetch(IResultSink& sink, size_t limit, const CancellationToken* cancel)
+{
+	std::shared_lock<std::shared_mutex> lock(m_tree.m_lock);
+
+	if (m_generation != m_tree.m_generation) {
+		throw IllegalStateException("RangeQueryCursor: The tree was modified.");
+	}
+
+	const ResultDetail detail = sink.GetDetail();
+	size_t count = 0;
+	Region mbr;
+
+	while (!m_path.empty() && count < limit)
+	{
+		if (cancel && cancel->IsCancelled()) {
+			break;
+		}
+
+		Frame& f = m_path.back();
+		if (!f.loaded)
+		{
+			f.node = m_tree.ReadNodeView(f.page);
+			f.loaded = true;
+		}
+
+		const NodeView& n = f.node;
+		const uint32_t children = n.GetChildrenCount();
+		id_type child = NewPage;
+
+		while (f.next < children && child == NewPage && count < limit)
+		{
+			const uint32_t base = f.next - f.next % MBRFilter::BATCH;
+			uint64_t mask = Filter(n, base) & (~uint64_t(0) << (f.next - base));
+			f.next = std::min(children, base + MBRFilter::BATCH);
+
+			while (mask != 0)
+			{
+				const uint32_t i = base + MBRFilter::NextBit(mask);
+
+				if (n.IsIndex())
+				{
+					child = n.GetChildIdentifier(i);
+					f.next = i + 1;
+					break;
+				}
+
+				switch (detail)
+				{
+				case ResultDetail::Count:
+					break;
+				case ResultDetail::Identifier:
+					sink.AddIdentifier(n.GetChildIdentifier(i));
+					break;
+				case ResultDetail::Entry:
+				{
+					n.GetChildMBR(i, mbr);
+					uint32_t len;
+					const uint8_t* data = n.GetChildData(i, len);
+					sink.AddEntry(n.GetChildIdentifier(i), mbr, data, len);
+				}
+					break;
+				}
+
+				if (++count == limit)
+				{
+					f.next = i + 1;
+					break;
+				}
+			}
+		}
+
+		if (child != NewPage) {
+			m_path.push_back({ child, 0, false, NodeView() });
+		} else if (f.next >= children) {
+			m_path.pop_back();
+		}
+	}
+
+	if (detail == ResultDetail::Count && count > 0) {
+		sink.AddCount(count);
+	}
+	m_tree.m_stats.query_results += count;
+
+	return count;
+}
+
+void RangeQueryCursor::GetContinuation(std::vector<uint8_t>& out) const
+{
+	const uint32_t type = static_cast<uint32_t>(m_type);
+	const uint32_t frames = static_cast<uint32_t>(m_path.size());
+
+	out.resize(3 * sizeof(uint32_t) + sizeof(uint64_t) + frames * (sizeof(id_type) + sizeof(uint32_t)));
+	uint8_t* ptr = out.data();
+
+	memcpy(ptr, &CONTINUATION_MAGIC, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, &type, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, &frames, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	memcpy(ptr, &m_generation, sizeof(uint64_t));
+	ptr += sizeof(uint64_t);
+
+	for (const auto& f : m_path)
+	{
+		memcpy(ptr, &f.page, sizeof(id_type));
+		ptr += sizeof(id_type);
+		memcpy(ptr, &f.next, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+	}
+}
+
+uint64_t RangeQueryCursor::Filter(const NodeView& n, uint32_t base) const
+{
+	const uint32_t count = std::min(MBRFilter::BATCH, n.GetChildrenCount() - base);
+	const bool contained = n.IsLeaf() && m_type == ContainmentQuery;
+
+	uint64_t mask = contained
+		? n.FilterContainedIn(base, count, m_query_mbr.GetLow(), m_query_mbr.GetHigh())
+		: n.FilterIntersects(base, count, m_query_mbr.GetLow(), m_query_mbr.GetHigh());
+
+	if (m_exact) {
+		return mask;
+	}
+
+	Region mbr;
+	for (uint64_t m = mask; m != 0; )
+	{
+		const uint32_t bit = MBRFilter::NextBit(m);
+		n.GetChildMBR(base + bit, mbr);
+		if (!(contained ? m_query.ContainsShape(mbr) : m_query.IntersectsShape(mbr))) {
+			mask &= ~(uint64_t(1) << bit);
+		}
+	}
+	return mask;
+}
+
+}
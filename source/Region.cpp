@@ -1,7 +1,9 @@
 #include "spatialdb/Region.h"
 #include "spatialdb/Point.h"
 #include "spatialdb/Edge.h"
+#include "spatialdb/Face.h"
 #include "spatialdb/ShapeType.h"
+#include "spatialdb/Math.h"
 
 #include <cmath>
 #include <cstring>
@@ -106,6 +108,12 @@ bool Region::IntersectsShape(const IShape& s) const
 		ret = IntersectsEdge(e);
 	}
 		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.IntersectsRegion(*this);
+	}
+		break;
 	case ST_REGION:
 	{
 		const Region& r = static_cast<const Region&>(s);
@@ -129,6 +137,20 @@ bool Region::ContainsShape(const IShape& s) const
 		ret = ContainsPoint(p);
 	}
 		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = ContainsPoint(Point(e.GetStart())) && ContainsPoint(Point(e.GetEnd()));
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		Region mbr;
+		f.GetMBR(mbr);
+		ret = f.GetVertexCount() > 0 && ContainsRegion(mbr);
+	}
+		break;
 	case ST_REGION:
 	{
 		const Region& r = static_cast<const Region&>(s);
@@ -152,6 +174,18 @@ bool Region::TouchesShape(const IShape& s) const
 		ret = TouchesPoint(p);
 	}
 		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = e.TouchesShape(*this);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.TouchesShape(*this);
+	}
+		break;
 	case ST_REGION:
 	{
 		const Region& r = static_cast<const Region&>(s);
@@ -198,6 +232,18 @@ double Region::GetMinimumDistance(const IShape& s) const
 		ret = GetMinimumDistance(p);
 	}
 		break;
+	case ST_EDGE:
+	{
+		const Edge& e = static_cast<const Edge&>(s);
+		ret = e.GetMinimumDistance(*this);
+	}
+		break;
+	case ST_FACE:
+	{
+		const Face& f = static_cast<const Face&>(s);
+		ret = f.GetMinimumDistance(*this);
+	}
+		break;
 	case ST_REGION:
 	{
 		const Region& r = static_cast<const Region&>(s);
@@ -264,18 +310,8 @@ double Region::GetMinimumDistance(const Region& r) const
 
 bool Region::IntersectsEdge(const Edge& e) const
 {
-	Point ll(m_low), ur(m_high);
-
-	double c_ul[2] = { m_low[0], m_high[1] };
-	double c_lr[2] = { m_high[0], m_low[1] };
-	Point ul(&c_ul[0]), lr(&c_lr[0]);
-
-	Point p1(e.GetStart()), p2(e.GetEnd());
-
-	return ContainsPoint(p1) || ContainsPoint(p2) ||
-		   e.IntersectsShape(Edge(ll, ul)) || e.IntersectsShape(Edge(ul, ur)) ||
-		   e.IntersectsShape(Edge(ur, lr)) || e.IntersectsShape(Edge(lr, ll));
-
+	const Math::Lifted p(e.GetStart()), q(e.GetEnd()), low(m_low, 1, -1.0), high(m_high, 1, 1.0);
+	return Math::SegmentIntersectsBox(p, q, low, high);
 }
 
 bool Region::ContainsPoint(const Point& p) const
@@ -310,14 +346,15 @@ double Region::GetMinimumDistance(const Point& p) const
 	auto p_pos = p.GetCoords();
 	for (int i = 0; i < DIMENSION; ++i)
 	{
-		if (p_pos[i] < m_low[i])
-		{
-			ret += std::pow(m_low[i] - p_pos[i], 2.0);
-		}
-		else if (p_pos[i] > m_high[i])
-		{
-			ret += std::pow(p_pos[i] - m_high[i], 2.0);
+		double x = 0.0;
+
+		if (p_pos[i] < m_low[i]) {
+			x = m_low[i] - p_pos[i];
+		} else if (p_pos[i] > m_high[i]) {
+			x = p_pos[i] - m_high[i];
 		}
+
+		ret += x * x;
 	}
 
 	return std::sqrt(ret);
@@ -403,6 +440,15 @@ void Region::MakeInfinite()
 	}
 }
 
+void Region::RoundOutward()
+{
+	for (int i = 0; i < DIMENSION; ++i)
+	{
+		m_low[i] = RoundDown(m_low[i]);
+		m_high[i] = RoundUp(m_high[i]);
+	}
+}
+
 void Region::Initialize(const double* low, const double* high)
 {
 	memcpy(m_low, low, DIMENSION * sizeof(double));
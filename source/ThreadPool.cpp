@@ -0,0 +1,110 @@
+#include "spatialdb/ThreadPool.h"
+
+#include <algorithm>
+
+namespace spatialdb
+{
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	if (threads == 0) {
+		threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	}
+
+	// the thread calling Run is one of the workers.
+	for (size_t i = 1; i < threads; ++i) {
+		m_workers.emplace_back(&ThreadPool::Work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& t : m_workers) {
+		t.join();
+	}
+}
+
+void ThreadPool::Run(size_t count, const std::function<void(size_t)>& task)
+{
+	if (count == 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> run_lock(m_run_lock);
+
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_task = &task;
+		m_count = count;
+		m_next = 0;
+		m_finished = 0;
+		m_error = nullptr;
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	Drain();
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_done.wait(lock, [this] { return m_finished == m_count; });
+	m_task = nullptr;
+
+	if (m_error) {
+		std::rethrow_exception(m_error);
+	}
+}
+
+void ThreadPool::Work()
+{
+	uint64_t generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_wake.wait(lock, [&] { return m_stop || m_generation != generation; });
+			if (m_stop) {
+				return;
+			}
+			generation = m_generation;
+		}
+
+		Drain();
+	}
+}
+
+void ThreadPool::Drain()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	while (m_task && m_next < m_count)
+	{
+		const size_t i = m_next++;
+		const auto& task = *m_task;
+		lock.unlock();
+
+		std::exception_ptr error = nullptr;
+		try
+		{
+			task(i);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		if (error && !m_error) {
+			m_error = error;
+		}
+		if (++m_finished == m_count) {
+			m_done.notify_all();
+		}
+	}
+}
+
+}
@@ -0,0 +1,423 @@
+#include "spatialdb/TopologyStore.h"
+#include "spatialdb/RTree.h"
+#include "spatialdb/IdSink.h"
+#include "spatialdb/Exception.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+namespace
+{
+
+const uint32_t TOPOLOGY_MAGIC = 0x474c5054; // "TPLG"
+
+using Pairs = std::vector<std::pair<spatialdb::id_type, spatialdb::id_type>>;
+
+inline bool KeyLess(const std::pair<spatialdb::id_type, spatialdb::id_type>& a, const std::pair<spatialdb::id_type, spatialdb::id_type>& b)
+{
+	return a.first < b.first;
+}
+
+void SortUnique(std::vector<spatialdb::id_type>& ids)
+{
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+}
+
+namespace spatialdb
+{
+
+//
+// class TopologyStore::Relation
+//
+
+const id_type* TopologyStore::Relation::Find(id_type key, size_t& count) const
+{
+	count = 0;
+	if (m_keys.empty()) {
+		return nullptr;
+	}
+
+	size_t i;
+	if (m_dense)
+	{
+		// keys below the first wrap around to large offsets.
+		const uint64_t offset = static_cast<uint64_t>(key) - static_cast<uint64_t>(m_keys.front());
+		if (offset >= m_keys.size()) {
+			return nullptr;
+		}
+		i = static_cast<size_t>(offset);
+	}
+	else
+	{
+		auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+		if (it == m_keys.end() || *it != key) {
+			return nullptr;
+		}
+		i = it - m_keys.begin();
+	}
+
+	count = m_offsets[i + 1] - m_offsets[i];
+	return m_targets.data() + m_offsets[i];
+}
+
+void TopologyStore::Relation::Assign(Pairs& pairs, bool unique)
+{
+	if (unique)
+	{
+		std::sort(pairs.begin(), pairs.end());
+		pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+	}
+	else
+	{
+		std::stable_sort(pairs.begin(), pairs.end(), KeyLess);
+	}
+
+	if (pairs.size() > std::numeric_limits<uint32_t>::max()) {
+		throw IllegalArgumentException("TopologyStore: Too many adjacencies.");
+	}
+
+	m_keys.clear();
+	m_offsets.clear();
+	m_targets.clear();
+	m_targets.reserve(pairs.size());
+
+	for (size_t i = 0; i < pairs.size(); ++i)
+	{
+		if (i == 0 || pairs[i].first != pairs[i - 1].first)
+		{
+			m_keys.push_back(pairs[i].first);
+			m_offsets.push_back(static_cast<uint32_t>(i));
+		}
+		m_targets.push_back(pairs[i].second);
+	}
+	m_offsets.push_back(static_cast<uint32_t>(pairs.size()));
+
+	m_dense = !m_keys.empty() &&
+		static_cast<uint64_t>(m_keys.back()) - static_cast<uint64_t>(m_keys.front()) == m_keys.size() - 1;
+}
+
+void TopologyStore::Relation::AppendPairs(Pairs& out) const
+{
+	for (size_t i = 0; i < m_keys.size(); ++i) {
+		for (uint32_t j = m_offsets[i]; j < m_offsets[i + 1]; ++j) {
+			out.emplace_back(m_keys[i], m_targets[j]);
+		}
+	}
+}
+
+void TopologyStore::Relation::AppendInverse(Pairs& out) const
+{
+	for (size_t i = 0; i < m_keys.size(); ++i) {
+		for (uint32_t j = m_offsets[i]; j < m_offsets[i + 1]; ++j) {
+			out.emplace_back(m_targets[j], m_keys[i]);
+		}
+	}
+}
+
+size_t TopologyStore::Relation::GetByteArraySize() const
+{
+	// key and target counts, keys, offsets and targets.
+	return 2 * sizeof(uint64_t) + m_keys.size() * sizeof(id_type) +
+		(m_keys.size() + 1) * sizeof(uint32_t) + m_targets.size() * sizeof(id_type);
+}
+
+uint8_t* TopologyStore::Relation::Store(uint8_t* ptr) const
+{
+	const uint64_t keys = m_keys.size();
+	const uint64_t targets = m_targets.size();
+	const uint32_t empty = 0;
+
+	memcpy(ptr, &keys, sizeof(uint64_t));
+	ptr += sizeof(uint64_t);
+	memcpy(ptr, &targets, sizeof(uint64_t));
+	ptr += sizeof(uint64_t);
+	memcpy(ptr, m_keys.data(), keys * sizeof(id_type));
+	ptr += keys * sizeof(id_type);
+	// a relation never built has no offsets yet.
+	memcpy(ptr, m_offsets.empty() ? &empty : m_offsets.data(), (keys + 1) * sizeof(uint32_t));
+	ptr += (keys + 1) * sizeof(uint32_t);
+	memcpy(ptr, m_targets.data(), targets * sizeof(id_type));
+	ptr += targets * sizeof(id_type);
+
+	return ptr;
+}
+
+const uint8_t* TopologyStore::Relation::Load(const uint8_t* ptr, const uint8_t* end)
+{
+	uint64_t keys, targets;
+	if (end - ptr < static_cast<ptrdiff_t>(2 * sizeof(uint64_t))) {
+		return nullptr;
+	}
+	memcpy(&keys, ptr, sizeof(uint64_t));
+	ptr += sizeof(uint64_t);
+	memcpy(&targets, ptr, sizeof(uint64_t));
+	ptr += sizeof(uint64_t);
+
+	const uint64_t avail = end - ptr;
+	if (keys > avail / sizeof(id_type) || targets > avail / sizeof(id_type) ||
+		keys * sizeof(id_type) + (keys + 1) * sizeof(uint32_t) + targets * sizeof(id_type) > avail) {
+		return nullptr;
+	}
+
+	m_keys.resize(keys);
+	memcpy(m_keys.data(), ptr, keys * sizeof(id_type));
+	ptr += keys * sizeof(id_type);
+	m_offsets.resize(keys + 1);
+	memcpy(m_offsets.data(), ptr, (keys + 1) * sizeof(uint32_t));
+	ptr += (keys + 1) * sizeof(uint32_t);
+	m_targets.resize(targets);
+	memcpy(m_targets.data(), ptr, targets * sizeof(id_type));
+	ptr += targets * sizeof(id_type);
+
+	// the lookups trust the keys to be sorted and the offsets to be in range.
+	if (m_offsets.front() != 0 || m_offsets.back() != targets) {
+		return nullptr;
+	}
+	for (size_t i = 0; i < keys; ++i)
+	{
+		if (m_offsets[i] > m_offsets[i + 1] || (i > 0 && m_keys[i - 1] >= m_keys[i])) {
+			return nullptr;
+		}
+	}
+
+	m_dense = !m_keys.empty() &&
+		static_cast<uint64_t>(m_keys.back()) - static_cast<uint64_t>(m_keys.front()) == m_keys.size() - 1;
+	return ptr;
+}
+
+//
+// class TopologyStore
+//
+
+void TopologyStore::AddFace(id_type face, const id_type* edges, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		m_new_face_edges.emplace_back(face, edges[i]);
+	}
+}
+
+void TopologyStore::AddEdge(id_type edge, id_type start, id_type end)
+{
+	m_new_edge_vertices.emplace_back(edge, start);
+	m_new_edge_vertices.emplace_back(edge, end);
+}
+
+void TopologyStore::Build()
+{
+	Pairs pairs;
+
+	m_face_edges.AppendPairs(pairs);
+	pairs.insert(pairs.end(), m_new_face_edges.begin(), m_new_face_edges.end());
+	m_face_edges.Assign(pairs, false);
+	m_new_face_edges.clear();
+
+	pairs.clear();
+	m_edge_vertices.AppendPairs(pairs);
+	pairs.insert(pairs.end(), m_new_edge_vertices.begin(), m_new_edge_vertices.end());
+	m_edge_vertices.Assign(pairs, false);
+	m_new_edge_vertices.clear();
+
+	// seam edges bound a face twice, closed edges start and end at one vertex.
+	pairs.clear();
+	m_face_edges.AppendInverse(pairs);
+	m_edge_faces.Assign(pairs, true);
+
+	pairs.clear();
+	m_edge_vertices.AppendInverse(pairs);
+	m_vertex_edges.Assign(pairs, true);
+}
+
+const id_type* TopologyStore::GetFaceEdges(id_type face, size_t& count) const
+{
+	return m_face_edges.Find(face, count);
+}
+
+const id_type* TopologyStore::GetEdgeVertices(id_type edge, size_t& count) const
+{
+	return m_edge_vertices.Find(edge, count);
+}
+
+const id_type* TopologyStore::GetEdgeFaces(id_type edge, size_t& count) const
+{
+	return m_edge_faces.Find(edge, count);
+}
+
+const id_type* TopologyStore::GetVertexEdges(id_type vertex, size_t& count) const
+{
+	return m_vertex_edges.Find(vertex, count);
+}
+
+void TopologyStore::GetAdjacentFaces(id_type face, std::vector<id_type>& out) const
+{
+	out.clear();
+
+	size_t edges;
+	const id_type* edge = m_face_edges.Find(face, edges);
+	for (size_t i = 0; i < edges; ++i)
+	{
+		size_t faces;
+		const id_type* f = m_edge_faces.Find(edge[i], faces);
+		for (size_t j = 0; j < faces; ++j)
+		{
+			if (f[j] != face) {
+				out.push_back(f[j]);
+			}
+		}
+	}
+	SortUnique(out);
+}
+
+void TopologyStore::Expand(const id_type* hits, size_t count, uint32_t rings, Neighborhood& out) const
+{
+	out.faces.clear();
+	out.edges.clear();
+	out.vertices.clear();
+
+	std::vector<id_type> frontier;
+	for (size_t i = 0; i < count; ++i)
+	{
+		// every key has targets, a known id is never found empty.
+		const id_type id = hits[i];
+		size_t n;
+		if (m_face_edges.Find(id, n) != nullptr)
+		{
+			frontier.push_back(id);
+		}
+		else if (m_edge_vertices.Find(id, n) != nullptr || m_edge_faces.Find(id, n) != nullptr)
+		{
+			out.edges.push_back(id);
+			const id_type* face = m_edge_faces.Find(id, n);
+			frontier.insert(frontier.end(), face, face + n);
+		}
+		else if (const id_type* edge = m_vertex_edges.Find(id, n))
+		{
+			out.vertices.push_back(id);
+			for (size_t j = 0; j < n; ++j)
+			{
+				size_t faces;
+				const id_type* face = m_edge_faces.Find(edge[j], faces);
+				frontier.insert(frontier.end(), face, face + faces);
+			}
+		}
+	}
+	SortUnique(frontier);
+	out.faces = frontier;
+
+	// ring by ring, the faces across the edges of the last ring not seen yet.
+	std::vector<id_type> next, merged;
+	for (uint32_t r = 0; r < rings && !frontier.empty(); ++r)
+	{
+		next.clear();
+		for (id_type face : frontier)
+		{
+			size_t edges;
+			const id_type* edge = m_face_edges.Find(face, edges);
+			for (size_t i = 0; i < edges; ++i)
+			{
+				size_t faces;
+				const id_type* f = m_edge_faces.Find(edge[i], faces);
+				next.insert(next.end(), f, f + faces);
+			}
+		}
+		SortUnique(next);
+
+		frontier.clear();
+		std::set_difference(next.begin(), next.end(), out.faces.begin(), out.faces.end(), std::back_inserter(frontier));
+		merged.clear();
+		std::merge(out.faces.begin(), out.faces.end(), frontier.begin(), frontier.end(), std::back_inserter(merged));
+		out.faces.swap(merged);
+	}
+
+	for (id_type face : out.faces)
+	{
+		size_t edges;
+		const id_type* edge = m_face_edges.Find(face, edges);
+		out.edges.insert(out.edges.end(), edge, edge + edges);
+	}
+	SortUnique(out.edges);
+
+	for (id_type edge : out.edges)
+	{
+		size_t vertices;
+		const id_type* vertex = m_edge_vertices.Find(edge, vertices);
+		out.vertices.insert(out.vertices.end(), vertex, vertex + vertices);
+	}
+	SortUnique(out.vertices);
+}
+
+void TopologyStore::IntersectsWithQuery(RTree& tree, const IShape& query, uint32_t rings, Neighborhood& out) const
+{
+	IdSink sink;
+	tree.IntersectsWithQuery(query, sink);
+	Expand(sink.GetResults().data(), sink.GetResults().size(), rings, out);
+}
+
+void TopologyStore::Store(RTree& tree, const std::string& key) const
+{
+	const Relation* relations[] = { &m_face_edges, &m_edge_vertices, &m_edge_faces, &m_vertex_edges };
+
+	size_t len = sizeof(uint32_t);
+	for (const Relation* r : relations) {
+		len += r->GetByteArraySize();
+	}
+	if (len > std::numeric_limits<uint32_t>::max()) {
+		throw IllegalArgumentException("TopologyStore: The topology is too large to be stored.");
+	}
+
+	std::unique_ptr<uint8_t[]> data(new uint8_t[len]);
+	uint8_t* ptr = data.get();
+	memcpy(ptr, &TOPOLOGY_MAGIC, sizeof(uint32_t));
+	ptr += sizeof(uint32_t);
+	for (const Relation* r : relations) {
+		ptr = r->Store(ptr);
+	}
+
+	tree.StoreMetaData(key, static_cast<uint32_t>(len), data.get());
+}
+
+void TopologyStore::Load(RTree& tree, const std::string& key)
+{
+	uint32_t len;
+	uint8_t* buffer;
+	tree.LoadMetaData(key, len, &buffer);
+	std::unique_ptr<uint8_t[]> data(buffer);
+
+	const uint8_t* ptr = data.get();
+	const uint8_t* end = ptr + len;
+
+	uint32_t magic = 0;
+	bool valid = len >= sizeof(uint32_t);
+	if (valid)
+	{
+		memcpy(&magic, ptr, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		valid = magic == TOPOLOGY_MAGIC;
+	}
+
+	Relation relations[4];
+	for (Relation& r : relations)
+	{
+		if (!valid) {
+			break;
+		}
+		ptr = r.Load(ptr, end);
+		valid = ptr != nullptr;
+	}
+	if (!valid || ptr != end) {
+		throw IllegalArgumentException("TopologyStore: Invalid topology page.");
+	}
+
+	m_face_edges = std::move(relations[0]);
+	m_edge_vertices = std::move(relations[1]);
+	m_edge_faces = std::move(relations[2]);
+	m_vertex_edges = std::move(relations[3]);
+	m_new_face_edges.clear();
+	m_new_edge_vertices.clear();
+}
+
+}
@@ -0,0 +1,192 @@
+#include "spatialdb/WriteAheadLog.h"
+#include "spatialdb/LogRecord.h"
+#include "spatialdb/Exception.h"
+
+#include <filesystem>
+#include <cstring>
+
+namespace
+{
+
+const uint64_t WAL_MAGIC = 0x314C415742445053ull; // "SPDBWAL1"
+
+enum WalRecordType : uint32_t
+{
+	WR_STORE = 1,
+	WR_DELETE,
+	WR_COMMIT
+};
+
+}
+
+namespace spatialdb
+{
+
+WriteAheadLog::WriteAheadLog(const std::string& filename, bool overwrite)
+	: m_filename(filename)
+{
+	if (overwrite || !std::filesystem::exists(filename))
+	{
+		Truncate();
+		return;
+	}
+
+	m_file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (m_file.fail()) {
+		throw IllegalStateException("WriteAheadLog: Could not open the log file.");
+	}
+
+	m_file.seekg(0, m_file.end);
+	m_size = static_cast<uint64_t>(m_file.tellg());
+}
+
+size_t WriteAheadLog::Replay(const StoreCallback& store, const DeleteCallback& del) const
+{
+	if (m_size <= sizeof(uint64_t)) {
+		return 0;
+	}
+
+	std::ifstream fin(m_filename.c_str(), std::ios::binary);
+	std::vector<uint8_t> buf(static_cast<size_t>(m_size));
+	fin.read(reinterpret_cast<char*>(buf.data()), buf.size());
+	if (fin.fail()) {
+		throw IllegalStateException("WriteAheadLog: Could not read the log file.");
+	}
+
+	uint64_t magic;
+	memcpy(&magic, buf.data(), sizeof(uint64_t));
+	if (magic != WAL_MAGIC) {
+		throw IllegalStateException("WriteAheadLog: Corrupted log file.");
+	}
+
+	struct Op
+	{
+		id_type id;
+		bool deleted;
+		PageTable::Entry entry;
+		const uint8_t* data;
+	};
+
+	// the records of a group are applied once its commit record is read,
+	// a group cut short by the crash is dropped.
+	std::vector<Op> group;
+	size_t groups = 0;
+
+	LogReader reader(buf.data() + sizeof(uint64_t), buf.size() - sizeof(uint64_t));
+	uint32_t type;
+	while (reader.Next(type))
+	{
+		switch (type)
+		{
+		case WR_STORE:
+		{
+			Op op;
+			op.id = reader.Read<id_type>();
+			op.deleted = false;
+			op.entry.length = reader.Read<uint32_t>();
+			op.entry.pages.resize(reader.Read<uint32_t>());
+			reader.Read(op.entry.pages.data(), op.entry.pages.size() * sizeof(id_type));
+			op.data = reader.GetPayload() + (reader.GetPayloadSize() - op.entry.length);
+			group.push_back(std::move(op));
+		}
+			break;
+		case WR_DELETE:
+			group.push_back({ reader.Read<id_type>(), true, PageTable::Entry(), nullptr });
+			break;
+		case WR_COMMIT:
+			for (auto& op : group)
+			{
+				if (op.deleted) {
+					del(op.id);
+				} else {
+					store(op.id, op.entry, op.data);
+				}
+			}
+			group.clear();
+			++groups;
+			break;
+		default:
+			throw IllegalStateException("WriteAheadLog: Corrupted log file.");
+		}
+	}
+
+	return groups;
+}
+
+void WriteAheadLog::AppendStore(id_type id, const PageTable::Entry& e, const uint8_t* data)
+{
+	LogWriter writer(m_buffer);
+	writer.Begin(WR_STORE);
+	writer.Append(id);
+	writer.Append(e.length);
+	writer.Append(static_cast<uint32_t>(e.pages.size()));
+	writer.Append(e.pages.data(), e.pages.size() * sizeof(id_type));
+	writer.Append(data, e.length);
+	writer.End();
+}
+
+void WriteAheadLog::AppendDelete(id_type id)
+{
+	LogWriter writer(m_buffer);
+	writer.Begin(WR_DELETE);
+	writer.Append(id);
+	writer.End();
+}
+
+bool WriteAheadLog::Commit(size_t group_commit_bytes)
+{
+	LogWriter writer(m_buffer);
+	writer.Begin(WR_COMMIT);
+	writer.Append(++m_commits);
+	writer.End();
+
+	m_committed = m_buffer.size();
+
+	if (m_committed < group_commit_bytes) {
+		return false;
+	}
+
+	Sync();
+	return true;
+}
+
+void WriteAheadLog::Sync()
+{
+	if (m_committed == 0) {
+		return;
+	}
+
+	m_file.seekp(m_size, std::ios_base::beg);
+	m_file.write(reinterpret_cast<const char*>(m_buffer.data()), m_committed);
+	m_file.flush();
+	if (m_file.fail()) {
+		throw IllegalStateException("WriteAheadLog: Could not write the log file.");
+	}
+	LogWriter::SyncFile(m_filename);
+
+	m_size += m_committed;
+
+	// the records of an unfinished group stay buffered.
+	m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_committed);
+	m_committed = 0;
+}
+
+void WriteAheadLog::Truncate()
+{
+	m_file.close();
+	m_file.open(m_filename.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (m_file.fail()) {
+		throw IllegalStateException("WriteAheadLog: Could not open the log file.");
+	}
+
+	m_file.write(reinterpret_cast<const char*>(&WAL_MAGIC), sizeof(uint64_t));
+	m_file.flush();
+	if (m_file.fail()) {
+		throw IllegalStateException("WriteAheadLog: Could not write the log file.");
+	}
+	LogWriter::SyncFile(m_filename);
+
+	m_size = sizeof(uint64_t);
+}
+
+}
@@ -0,0 +1,140 @@
+// The exact Face predicates and the fan triangle distances: triangles
+// against the faces of a box and against each other, points on the
+// boundary and in the interior of a face.
+
+#include "Check.h"
+
+#include "spatialdb/Face.h"
+#include "spatialdb/Edge.h"
+#include "spatialdb/Point.h"
+#include "spatialdb/Region.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace spatialdb;
+
+namespace
+{
+
+#if DIMENSION == 3
+
+bool Near(double a, double b)
+{
+	return std::fabs(a - b) <= 1e-12 * std::max(1.0, std::fabs(b));
+}
+
+// triangles inside the box [0, 4]^3, lying in its top face and a quarter
+// above it, and one crossing the top face.
+void TestTriangleBox()
+{
+	const double low[3] = { 0, 0, 0 }, high[3] = { 4, 4, 4 };
+	const Region box(low, high);
+
+	const double in[9] = { 1, 1, 1, 3, 1, 2, 1, 3, 3 };
+	const Face inside(in, 3);
+	CHECK(inside.IntersectsShape(box) && !inside.TouchesShape(box));
+	CHECK(box.ContainsShape(inside));
+	CHECK(inside.GetMinimumDistance(box) == 0.0);
+
+	const double on[9] = { 1, 1, 4, 3, 1, 4, 1, 3, 4 };
+	const Face on_face(on, 3);
+	CHECK(on_face.IntersectsShape(box) && on_face.TouchesShape(box));
+	CHECK(box.IntersectsShape(on_face) && box.TouchesShape(on_face));
+	CHECK(box.ContainsShape(on_face));
+	CHECK(on_face.GetMinimumDistance(box) == 0.0);
+
+	const double off[9] = { 1, 1, 4.25, 3, 1, 4.25, 1, 3, 4.25 };
+	const Face off_face(off, 3);
+	CHECK(!off_face.IntersectsShape(box) && !off_face.TouchesShape(box));
+	CHECK(!box.IntersectsShape(off_face));
+	CHECK(off_face.GetMinimumDistance(box) == 0.25);
+
+	const double crossing[9] = { 1, 1, 3, 3, 1, 5, 1, 3, 5 };
+	const Face cross(crossing, 3);
+	CHECK(cross.IntersectsShape(box) && !cross.TouchesShape(box));
+	CHECK(!box.ContainsShape(cross));
+}
+
+// triangles against the triangle (0, 0, 0), (4, 0, 0), (0, 4, 0), both
+// ways round.
+void TestTriangleTriangle()
+{
+	const double base[9] = { 0, 0, 0, 4, 0, 0, 0, 4, 0 };
+	const Face f(base, 3);
+
+	auto touches = [&f](const Face& g) {
+		return f.IntersectsShape(g) && f.TouchesShape(g) && g.IntersectsShape(f) && g.TouchesShape(f);
+	};
+	auto crosses = [&f](const Face& g) {
+		return f.IntersectsShape(g) && !f.TouchesShape(g) && g.IntersectsShape(f) && !g.TouchesShape(f);
+	};
+
+	// coplanar, sharing the edge from (4, 0, 0) to (0, 4, 0).
+	const double shared[9] = { 4, 0, 0, 0, 4, 0, 4, 4, 0 };
+	CHECK(touches(Face(shared, 3)));
+
+	const double overlapping[9] = { 1, 1, 0, 5, 1, 0, 1, 5, 0 };
+	CHECK(crosses(Face(overlapping, 3)));
+
+	const double piercing[9] = { 1, 1, -1, 1, 1, 1, 1, 3, 1 };
+	CHECK(crosses(Face(piercing, 3)));
+
+	// upright in the plane y = 1, standing on f, and lifted off it.
+	const double standing[9] = { 1, 1, 0, 2, 1, 0, 1.5, 1, 2 };
+	CHECK(touches(Face(standing, 3)));
+	CHECK(f.GetMinimumDistance(Face(standing, 3)) == 0.0);
+
+	const double lifted[9] = { 1, 1, 0.5, 2, 1, 0.5, 1.5, 1, 2 };
+	CHECK(!f.IntersectsShape(Face(lifted, 3)) && !f.TouchesShape(Face(lifted, 3)));
+	CHECK(f.GetMinimumDistance(Face(lifted, 3)) == 0.5);
+}
+
+// the square [0, 4]^2 at z = 0, the fan of (0, 1, 2) and (0, 2, 3).
+void TestSquare()
+{
+	const double square[12] = { 0, 0, 0, 4, 0, 0, 4, 4, 0, 0, 4, 0 };
+	const Face f(square, 4);
+
+	const double edge[3] = { 2, 0, 0 }, corner[3] = { 4, 4, 0 }, diagonal[3] = { 2, 2, 0 }, interior[3] = { 3, 1, 0 };
+	CHECK(f.ContainsShape(Point(edge)) && f.TouchesShape(Point(edge)));
+	CHECK(f.ContainsShape(Point(corner)) && f.TouchesShape(Point(corner)));
+	// the diagonal is shared by the fan triangles, not the boundary.
+	CHECK(f.ContainsShape(Point(diagonal)) && !f.TouchesShape(Point(diagonal)));
+	CHECK(f.ContainsShape(Point(interior)) && !f.TouchesShape(Point(interior)));
+	CHECK(Point(edge).TouchesShape(f) && !Point(interior).TouchesShape(f));
+
+	const double above_first[3] = { 3, 1, 2 }, above_second[3] = { 1, 3, 5 }, below_diagonal[3] = { 2, 2, -3 };
+	CHECK(f.GetMinimumDistance(Point(above_first)) == 2.0);
+	CHECK(f.GetMinimumDistance(Point(above_second)) == 5.0);
+	CHECK(f.GetMinimumDistance(Point(below_diagonal)) == 3.0);
+	CHECK(!f.ContainsShape(Point(above_first)));
+
+	const double beside[3] = { 6, 2, 0 }, beyond[3] = { 6, 6, 0 };
+	CHECK(f.GetMinimumDistance(Point(beside)) == 2.0);
+	CHECK(Near(f.GetMinimumDistance(Point(beyond)), std::sqrt(8.0)));
+
+	const double e1[3] = { 5, 0, 1 }, e2[3] = { 5, 4, 1 };
+	CHECK(Near(f.GetMinimumDistance(Edge(e1, e2)), std::sqrt(2.0)));
+
+	const double parallel[12] = { 0, 0, 7, 4, 0, 7, 4, 4, 7, 0, 4, 7 };
+	CHECK(f.GetMinimumDistance(Face(parallel, 4)) == 7.0);
+
+	const double low[3] = { 5, 1, -1 }, high[3] = { 6, 2, 1 };
+	CHECK(f.GetMinimumDistance(Region(low, high)) == 1.0);
+}
+
+#endif
+
+}
+
+int main()
+{
+#if DIMENSION == 3
+	TestTriangleBox();
+	TestTriangleTriangle();
+	TestSquare();
+#endif
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+// The exact fallback of the orientation predicates and the coplanar case of
+// SegmentsIntersect, on near-degenerate inputs where the floating point
+// determinant gets the sign wrong.
+
+#include "Check.h"
+
+#include "spatialdb/Math.h"
+
+#include <cmath>
+
+using namespace spatialdb;
+
+namespace
+{
+
+// the unit in the last place of 0.5.
+const double ULP = std::ldexp(1.0, -53);
+
+int Sign(double x)
+{
+	return (x > 0.0) - (x < 0.0);
+}
+
+double NaiveOrient2D(const double* a, const double* b, const double* c)
+{
+	return (a[0] - c[0]) * (b[1] - c[1]) - (a[1] - c[1]) * (b[0] - c[0]);
+}
+
+double NaiveOrient3D(const double* a, const double* b, const double* c, const double* d)
+{
+	const double ad[3] = { a[0] - d[0], a[1] - d[1], a[2] - d[2] };
+	const double bd[3] = { b[0] - d[0], b[1] - d[1], b[2] - d[2] };
+	const double cd[3] = { c[0] - d[0], c[1] - d[1], c[2] - d[2] };
+	return ad[0] * (bd[1] * cd[2] - bd[2] * cd[1]) +
+		bd[0] * (cd[1] * ad[2] - cd[2] * ad[1]) +
+		cd[0] * (ad[1] * bd[2] - ad[2] * bd[1]);
+}
+
+// a near (0.5, 0.5) against the line y = x through b and c. The exact
+// determinant is 12 (a[1] - a[0]), and a[1] - a[0] is exact.
+void TestOrient2D()
+{
+	const double b[2] = { 12.0, 12.0 };
+	const double c[2] = { 24.0, 24.0 };
+
+	int wrong = 0;
+	for (int i = 0; i < 64; ++i)
+	{
+		for (int j = 0; j < 64; ++j)
+		{
+			const double a[2] = { 0.5 + i * ULP, 0.5 + j * ULP };
+			const int expected = Sign(a[1] - a[0]);
+			CHECK(Sign(Math::Orient2D(a, b, c)) == expected);
+			wrong += Sign(NaiveOrient2D(a, b, c)) != expected;
+		}
+	}
+	CHECK(wrong > 0);
+}
+
+// d near (0.5, 0.5, 0.5) against the plane x = z through a, b and c. The
+// side is the sign of d[0] - d[2], which is exact.
+void TestOrient3D()
+{
+	const double a[3] = { 12.0, 0.0, 12.0 };
+	const double b[3] = { 24.0, 0.0, 24.0 };
+	const double c[3] = { 12.0, 1.0, 12.0 };
+	const double off[3] = { 1.0, 0.0, 0.0 };
+	const int side = Sign(Math::Orient3D(a, b, c, off));
+	CHECK(side != 0);
+
+	int wrong = 0;
+	for (int i = 0; i < 64; ++i)
+	{
+		for (int j = 0; j < 64; ++j)
+		{
+			const double d[3] = { 0.5 + i * ULP, 0.5 + (i + j) * ULP, 0.5 + j * ULP };
+			const int expected = side * Sign(d[0] - d[2]);
+			CHECK(Sign(Math::Orient3D(a, b, c, d)) == expected);
+			wrong += Sign(NaiveOrient3D(a, b, c, d)) != expected;
+		}
+	}
+	CHECK(wrong > 0);
+}
+
+// segments in the plane x = z with coordinates the floating point
+// determinant rounds off the plane. The first runs along x = y = z, the
+// second rises from below that line and ends short of it, on it, or across
+// it, k units in the last place of 12 away.
+void TestCoplanarSegments()
+{
+	const double q1[3] = { 24.0, 24.0, 24.0 };
+	const double ulp12 = std::ldexp(1.0, -49);
+
+	int off_plane = 0;
+	for (int i = 0; i < 32; ++i)
+	{
+		const double p1[3] = { 0.5 + i * ULP, 0.5 + i * ULP, 0.5 + i * ULP };
+		for (int j = 1; j < 32; ++j)
+		{
+			const double p2[3] = { 12.0 - j * 8.0 * ulp12, 0.5 + j * ULP, 12.0 - j * 8.0 * ulp12 };
+			for (int k = -2; k <= 2; ++k)
+			{
+				const double q2[3] = { 12.0, 12.0 + k * ulp12, 12.0 };
+				CHECK(Math::SegmentsIntersect(p1, q1, p2, q2) == (k >= 0));
+				CHECK(Math::SegmentsIntersect(p2, q2, p1, q1) == (k >= 0));
+				CHECK(Math::SegmentsTouch(p1, q1, p2, q2) == (k == 0));
+				off_plane += NaiveOrient3D(p1, q1, p2, q2) != 0.0;
+			}
+		}
+	}
+	CHECK(off_plane > 0);
+}
+
+}
+
+int main()
+{
+	TestOrient2D();
+	TestOrient3D();
+	TestCoplanarSegments();
+
+	return 0;
+}
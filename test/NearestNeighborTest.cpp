@@ -0,0 +1,95 @@
+// The results a visitor clones from a nearest neighbor query stay valid
+// after the pages they were read from are rewritten.
+
+#include "Check.h"
+
+#include "spatialdb/RTree.h"
+#include "spatialdb/MemoryStorageManager.h"
+#include "spatialdb/ObjVisitor.h"
+#include "spatialdb/Point.h"
+#include "spatialdb/Region.h"
+#ifdef __unix__
+#include "spatialdb/MappedStorageManager.h"
+#endif
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+using namespace spatialdb;
+
+namespace
+{
+
+Region Box(double x)
+{
+	double low[DIMENSION], high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		low[d] = x;
+		high[d] = x + 0.5;
+	}
+	return Region(low, high);
+}
+
+void Insert(RTree& tree, id_type id)
+{
+	const uint64_t payload = 1000 + id;
+	tree.InsertData(sizeof(payload), reinterpret_cast<const uint8_t*>(&payload), Box(static_cast<double>(id)), id);
+}
+
+void TestClonedResults(const std::shared_ptr<IStorageManager>& sm)
+{
+	RTree tree(sm, true);
+	for (id_type id = 0; id < 5; ++id) {
+		Insert(tree, id);
+	}
+
+	double origin[DIMENSION] = {};
+	ObjVisitor v;
+	tree.NearestNeighborQuery(3, Point(origin), v);
+	CHECK(v.GetResultCount() == 3);
+
+	// rewrites the leaf the results were read from.
+	Insert(tree, 5);
+
+	for (id_type i = 0; i < 3; ++i)
+	{
+		IData* d = v.GetResults()[i];
+		CHECK(d->GetIdentifier() == i);
+
+		IShape* s;
+		d->GetShape(&s);
+		Region mbr;
+		s->GetMBR(mbr);
+		delete s;
+		CHECK(mbr == Box(static_cast<double>(i)));
+
+		uint32_t len;
+		uint8_t* data;
+		d->GetData(len, &data);
+		uint64_t payload = 0;
+		CHECK(len == sizeof(payload));
+		memcpy(&payload, data, len);
+		delete[] data;
+		CHECK(payload == 1000 + static_cast<uint64_t>(i));
+	}
+}
+
+}
+
+int main()
+{
+	TestClonedResults(std::make_shared<MemoryStorageManager>());
+
+#ifdef __unix__
+	const std::string filename = (std::filesystem::temp_directory_path() / "spatialdb_nn_test").string();
+	TestClonedResults(std::make_shared<MappedStorageManager>(filename, true));
+	for (const char* ext : { ".dat", ".idx" }) {
+		std::filesystem::remove(filename + ext);
+	}
+#endif
+
+	return 0;
+}
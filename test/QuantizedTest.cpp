@@ -0,0 +1,231 @@
+// Trees with quantized index nodes answer range queries like a scan of
+// their entries, after inserts, deletes and a reopen. A header with an
+// unknown encoding or a node size that does not fit is rejected on open.
+
+#include "Check.h"
+
+#include "spatialdb/RTree.h"
+#include "spatialdb/DiskStorageManager.h"
+#include "spatialdb/MemoryStorageManager.h"
+#include "spatialdb/IdVisitor.h"
+#include "spatialdb/Region.h"
+#include "spatialdb/Exception.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace spatialdb;
+
+namespace
+{
+
+struct Box
+{
+	double low[DIMENSION];
+	double high[DIMENSION];
+	bool live = true;
+};
+
+// boxes in [0, 100)^DIMENSION with extents up to extent.
+std::vector<Box> RandomBoxes(size_t n, uint32_t seed, double extent)
+{
+	std::mt19937_64 rng(seed);
+	std::uniform_real_distribution<double> pos(0.0, 100.0), ext(0.0, extent);
+
+	std::vector<Box> boxes(n);
+	for (auto& b : boxes)
+	{
+		for (int d = 0; d < DIMENSION; ++d)
+		{
+			b.low[d] = pos(rng);
+			b.high[d] = b.low[d] + ext(rng);
+		}
+	}
+	return boxes;
+}
+
+void Insert(RTree& tree, const std::vector<Box>& boxes, size_t first)
+{
+	for (size_t i = first; i < boxes.size(); ++i)
+	{
+		const uint64_t payload = i;
+		tree.InsertData(sizeof(payload), reinterpret_cast<const uint8_t*>(&payload), Region(boxes[i].low, boxes[i].high), static_cast<id_type>(i));
+	}
+}
+
+bool Intersects(const Box& b, const Box& q)
+{
+	for (int d = 0; d < DIMENSION; ++d) {
+		if (b.low[d] > q.high[d] || b.high[d] < q.low[d]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Contains(const Box& q, const Box& b)
+{
+	for (int d = 0; d < DIMENSION; ++d) {
+		if (b.low[d] < q.low[d] || b.high[d] > q.high[d]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// intersection and containment queries against a scan of the live boxes.
+void CheckQueries(RTree& tree, const std::vector<Box>& boxes)
+{
+	CHECK(tree.IsIndexValid());
+
+	for (const Box& q : RandomBoxes(50, 2, 30.0))
+	{
+		std::vector<uint64_t> intersecting, contained;
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			if (boxes[i].live && Intersects(boxes[i], q)) {
+				intersecting.push_back(i);
+			}
+			if (boxes[i].live && Contains(q, boxes[i])) {
+				contained.push_back(i);
+			}
+		}
+
+		IdVisitor iv;
+		tree.IntersectsWithQuery(Region(q.low, q.high), iv);
+		std::sort(iv.GetResults().begin(), iv.GetResults().end());
+		CHECK(iv.GetResults() == intersecting);
+
+		IdVisitor cv;
+		tree.ContainsWhatQuery(Region(q.low, q.high), cv);
+		std::sort(cv.GetResults().begin(), cv.GetResults().end());
+		CHECK(cv.GetResults() == contained);
+	}
+}
+
+void TestQueries(NodeEncoding encoding, const std::string& filename)
+{
+	std::vector<Box> boxes = RandomBoxes(3000, 1, 5.0);
+
+	{
+		RTreeOptions options;
+		options.index_encoding = encoding;
+		RTree tree(std::make_shared<DiskStorageManager>(filename, true), options);
+
+		Insert(tree, boxes, 0);
+		CheckQueries(tree, boxes);
+
+		for (size_t i = 0; i < boxes.size(); i += 3)
+		{
+			CHECK(tree.DeleteData(Region(boxes[i].low, boxes[i].high), static_cast<id_type>(i)));
+			boxes[i].live = false;
+		}
+		CheckQueries(tree, boxes);
+	}
+
+	RTree tree(std::make_shared<DiskStorageManager>(filename, false), false);
+	CheckQueries(tree, boxes);
+
+	const size_t first = boxes.size();
+	const std::vector<Box> more = RandomBoxes(1000, 3, 5.0);
+	boxes.insert(boxes.end(), more.begin(), more.end());
+	Insert(tree, boxes, first);
+	CheckQueries(tree, boxes);
+}
+
+bool OpenThrows(const std::shared_ptr<IStorageManager>& sm)
+{
+	try
+	{
+		RTree tree(sm, false);
+	}
+	catch (IllegalStateException&)
+	{
+		return true;
+	}
+	return false;
+}
+
+std::vector<uint8_t> Header(IStorageManager& sm)
+{
+	// the header is the first page a tree writes.
+	uint32_t len;
+	uint8_t* data;
+	sm.LoadByteArray(0, len, &data);
+	std::vector<uint8_t> header(data, data + len);
+	delete[] data;
+	return header;
+}
+
+void StoreHeader(IStorageManager& sm, const std::vector<uint8_t>& header)
+{
+	id_type page = 0;
+	sm.StoreByteArray(page, static_cast<uint32_t>(header.size()), header.data());
+}
+
+void TestHeader()
+{
+	// with the capacities given, the headers of the two encodings differ
+	// first in the encoding, the node size is stored right after it.
+	auto q8 = std::make_shared<MemoryStorageManager>();
+	auto q16 = std::make_shared<MemoryStorageManager>();
+	for (auto& sm : { q8, q16 })
+	{
+		RTreeOptions options;
+		options.index_capacity = 20;
+		options.leaf_capacity = 20;
+		options.index_encoding = sm == q8 ? NodeEncoding::Quantized8 : NodeEncoding::Quantized16;
+		RTree tree(sm, options);
+	}
+
+	const std::vector<uint8_t> header = Header(*q8);
+	const std::vector<uint8_t> other = Header(*q16);
+	CHECK(header.size() == other.size());
+	const size_t encoding = std::mismatch(header.begin(), header.end(), other.begin()).first - header.begin();
+	CHECK(encoding + 2 * sizeof(uint32_t) <= header.size());
+
+	uint32_t value;
+	memcpy(&value, header.data() + encoding, sizeof(value));
+	CHECK(value == static_cast<uint32_t>(NodeEncoding::Quantized8));
+
+	auto patched = [&header](size_t offset, uint32_t v)
+	{
+		std::vector<uint8_t> h = header;
+		memcpy(h.data() + offset, &v, sizeof(v));
+		return h;
+	};
+
+	StoreHeader(*q8, patched(encoding, 7));
+	CHECK(OpenThrows(q8));
+
+	const size_t node_size = encoding + sizeof(uint32_t);
+	StoreHeader(*q8, patched(node_size, 0));
+	CHECK(OpenThrows(q8));
+	StoreHeader(*q8, patched(node_size, 64));
+	CHECK(OpenThrows(q8));
+
+	StoreHeader(*q8, header);
+	RTree tree(q8, false);
+	CHECK(tree.IsIndexValid());
+}
+
+}
+
+int main()
+{
+	const std::string filename = (std::filesystem::temp_directory_path() / "spatialdb_quantized_test").string();
+	TestQueries(NodeEncoding::Quantized8, filename);
+	TestQueries(NodeEncoding::Quantized16, filename);
+	for (const char* ext : { ".dat", ".idx" }) {
+		std::filesystem::remove(filename + ext);
+	}
+
+	TestHeader();
+
+	return 0;
+}
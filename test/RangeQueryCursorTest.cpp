@@ -0,0 +1,170 @@
+// A range query paged through continuations returns the results of a
+// single query, each once. Continuations that are malformed, or made
+// before the tree was modified, are rejected.
+
+#include "Check.h"
+
+#include "spatialdb/RTree.h"
+#include "spatialdb/RangeQueryCursor.h"
+#include "spatialdb/MemoryStorageManager.h"
+#include "spatialdb/IdSink.h"
+#include "spatialdb/Region.h"
+#include "spatialdb/Exception.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace spatialdb;
+
+namespace
+{
+
+Region RandomBox(std::mt19937_64& rng, double extent)
+{
+	std::uniform_real_distribution<double> pos(0.0, 100.0), ext(0.0, extent);
+
+	double low[DIMENSION], high[DIMENSION];
+	for (int d = 0; d < DIMENSION; ++d)
+	{
+		low[d] = pos(rng);
+		high[d] = low[d] + ext(rng);
+	}
+	return Region(low, high);
+}
+
+std::vector<id_type> SingleQuery(RTree& tree, RangeQueryType type, const Region& query)
+{
+	IdSink sink;
+	if (type == ContainmentQuery) {
+		tree.ContainsWhatQuery(query, sink);
+	} else {
+		tree.IntersectsWithQuery(query, sink);
+	}
+	return sink.GetResults();
+}
+
+// the first page holds 7 results, the later ones 13, each fetched by a
+// fresh cursor from the continuation of the previous one.
+std::vector<id_type> Paged(RTree& tree, RangeQueryType type, const Region& query)
+{
+	IdSink sink;
+	std::vector<uint8_t> continuation;
+	{
+		RangeQueryCursor cursor(tree, type, query);
+		const size_t n = cursor.Fetch(sink, 7);
+		CHECK(n == 7 || cursor.IsDone());
+		cursor.GetContinuation(continuation);
+	}
+
+	while (true)
+	{
+		RangeQueryCursor cursor(tree, type, query, continuation);
+		if (cursor.IsDone()) {
+			break;
+		}
+		const size_t n = cursor.Fetch(sink, 13);
+		CHECK(n == 13 || cursor.IsDone());
+		cursor.GetContinuation(continuation);
+	}
+	return sink.GetResults();
+}
+
+void TestPaging(RTree& tree)
+{
+	std::mt19937_64 rng(2);
+	for (int q = 0; q < 20; ++q)
+	{
+		const Region query = RandomBox(rng, 40.0);
+		for (RangeQueryType type : { IntersectionQuery, ContainmentQuery })
+		{
+			std::vector<id_type> expected = SingleQuery(tree, type, query);
+			std::vector<id_type> paged = Paged(tree, type, query);
+
+			std::sort(expected.begin(), expected.end());
+			std::sort(paged.begin(), paged.end());
+			CHECK(std::adjacent_find(paged.begin(), paged.end()) == paged.end());
+			CHECK(paged == expected);
+		}
+	}
+}
+
+bool ResumeThrows(RTree& tree, const Region& query, const std::vector<uint8_t>& continuation)
+{
+	try
+	{
+		RangeQueryCursor cursor(tree, IntersectionQuery, query, continuation);
+	}
+	catch (IllegalArgumentException&)
+	{
+		return true;
+	}
+	return false;
+}
+
+void TestRejected(RTree& tree)
+{
+	double low[DIMENSION], high[DIMENSION];
+	std::fill(low, low + DIMENSION, 0.0);
+	std::fill(high, high + DIMENSION, 100.0);
+	const Region query(low, high);
+
+	std::vector<uint8_t> continuation;
+	IdSink sink;
+	RangeQueryCursor cursor(tree, IntersectionQuery, query);
+	CHECK(cursor.Fetch(sink, 7) == 7);
+	cursor.GetContinuation(continuation);
+
+	// truncated, extended and garbage continuations.
+	std::vector<uint8_t> malformed(continuation.begin(), continuation.end() - 1);
+	CHECK(ResumeThrows(tree, query, malformed));
+	malformed = continuation;
+	malformed.push_back(0);
+	CHECK(ResumeThrows(tree, query, malformed));
+	CHECK(ResumeThrows(tree, query, std::vector<uint8_t>(5, 0xff)));
+
+	// a modification makes both the open cursor and the continuation stale.
+	std::mt19937_64 rng(3);
+	tree.InsertData(0, nullptr, RandomBox(rng, 1.0), 100000);
+
+	bool threw = false;
+	try
+	{
+		cursor.Fetch(sink, 7);
+	}
+	catch (IllegalStateException&)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+
+	RangeQueryCursor stale(tree, IntersectionQuery, query, continuation);
+	threw = false;
+	try
+	{
+		stale.Fetch(sink, 7);
+	}
+	catch (IllegalStateException&)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+}
+
+int main()
+{
+	RTree tree(std::make_shared<MemoryStorageManager>(), true);
+
+	std::mt19937_64 rng(1);
+	for (id_type id = 0; id < 3000; ++id) {
+		tree.InsertData(0, nullptr, RandomBox(rng, 3.0), id);
+	}
+
+	TestPaging(tree);
+	TestRejected(tree);
+
+	return 0;
+}
@@ -0,0 +1,139 @@
+// Recovery of a write-ahead log that was cut short by a crash: only the
+// groups that reached their commit record are applied on open.
+
+#include "Check.h"
+
+#include "spatialdb/DiskStorageManager.h"
+#include "spatialdb/WriteAheadLog.h"
+#include "spatialdb/Exception.h"
+#ifdef __unix__
+#include "spatialdb/MappedStorageManager.h"
+#endif
+
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+
+using namespace spatialdb;
+
+namespace
+{
+
+using OpenFunction = std::function<std::shared_ptr<IStorageManager>(const std::string& filename)>;
+
+const uint8_t FIRST[] = { 1, 2, 3 };
+const uint8_t SECOND[] = { 4, 5, 6, 7 };
+const uint8_t THIRD[] = { 8, 9 };
+
+bool Has(IStorageManager& sm, id_type page, const uint8_t* expected, uint32_t expected_len)
+{
+	uint32_t len;
+	uint8_t* data;
+	try
+	{
+		sm.LoadByteArray(page, len, &data);
+	}
+	catch (InvalidPageException&)
+	{
+		return false;
+	}
+
+	const bool same = len == expected_len && memcmp(data, expected, len) == 0;
+	delete[] data;
+	CHECK(same);
+	return true;
+}
+
+// a clean data file with page 0 and a log of two groups. A positive cut
+// keeps that many bytes of the second group, otherwise the log is cut
+// that many bytes before its end.
+void Prepare(const std::string& filename, int64_t cut, bool& second_complete)
+{
+	{
+		DiskStorageManager dm(filename, true);
+		id_type page = NewPage;
+		dm.StoreByteArray(page, sizeof(FIRST), FIRST);
+		CHECK(page == 0);
+	}
+
+	uint64_t first_group, second_group;
+	{
+		WriteAheadLog wal(filename + ".wal", true);
+
+		// stores page 4 past the end of the data file.
+		PageTable::Entry e;
+		e.length = sizeof(SECOND);
+		e.pages = { 4 };
+		wal.AppendStore(4, e, SECOND);
+		wal.Commit(0);
+		first_group = wal.GetSize();
+
+		// stores page 6 and deletes page 0.
+		e.length = sizeof(THIRD);
+		e.pages = { 6 };
+		wal.AppendStore(6, e, THIRD);
+		wal.AppendDelete(0);
+		wal.Commit(0);
+		second_group = wal.GetSize();
+	}
+
+	const uint64_t size = cut <= 0 ? second_group + cut : first_group + cut;
+	second_complete = size >= second_group;
+	std::filesystem::resize_file(filename + ".wal", size);
+}
+
+void TestRecovery(const std::string& filename, const OpenFunction& open)
+{
+	// inside the first record, the middle and the last byte of the
+	// commit record of the second group, and the whole log.
+	for (int64_t cut : { 1, 20, -1, 0 })
+	{
+		bool second_complete = false;
+		Prepare(filename, cut, second_complete);
+
+		{
+			std::shared_ptr<IStorageManager> sm = open(filename);
+			CHECK(!std::filesystem::exists(filename + ".wal"));
+
+			CHECK(Has(*sm, 4, SECOND, sizeof(SECOND)));
+			CHECK(Has(*sm, 6, THIRD, sizeof(THIRD)) == second_complete);
+			CHECK(Has(*sm, 0, FIRST, sizeof(FIRST)) == !second_complete);
+
+			// the free pages are rebuilt from the recovered entries, the
+			// lowest free page is reused first.
+			id_type page = NewPage;
+			sm->StoreByteArray(page, sizeof(FIRST), FIRST);
+			CHECK(page == (second_complete ? 0 : 1));
+		}
+
+		// the recovered state is durable, reopening changes nothing.
+		std::shared_ptr<IStorageManager> sm = open(filename);
+		CHECK(Has(*sm, 4, SECOND, sizeof(SECOND)));
+		CHECK(Has(*sm, 6, THIRD, sizeof(THIRD)) == second_complete);
+	}
+}
+
+}
+
+int main()
+{
+	const std::string filename = (std::filesystem::temp_directory_path() / "spatialdb_wal_test").string();
+
+	TestRecovery(filename, [](const std::string& f) {
+		return std::make_shared<DiskStorageManager>(f, false);
+	});
+
+#ifdef __unix__
+	TestRecovery(filename, [](const std::string& f) {
+		return std::make_shared<MappedStorageManager>(f, false);
+	});
+#endif
+
+	for (const char* ext : { ".dat", ".idx", ".wal" }) {
+		std::filesystem::remove(filename + ext);
+	}
+
+	return 0;
+}